@@ -0,0 +1,983 @@
+#pragma once
+#include "compression.hpp"
+#include "expression.hpp"
+#include "volume.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+// Class describing the partitioning of a volume into cubic bricks (bricks at the upper borders of the volume might be smaller)
+class BrickLayout
+{
+public:
+	BrickLayout() noexcept = default;
+	BrickLayout( vec3i dimensions, int32_t brickSize ) : _dimensions( dimensions ), _brickSize( brickSize ), _brickCounts( ( dimensions + brickSize - 1 ) / brickSize )
+	{
+		// Compute the offset of every brick when storing all bricks one after another (brick-major order)
+		_offsets = std::vector<int64_t>( static_cast<size_t>( _brickCounts.product() ) + 1, 0 );
+		for( int32_t i = 0; i < this->brickCount(); ++i )
+			_offsets[i + 1] = _offsets[i] + this->extent( i ).product();
+	}
+
+	// Getters for basic statistics
+	vec3i dimensions() const noexcept
+	{
+		return _dimensions;
+	}
+	int32_t voxelCount() const noexcept
+	{
+		return _dimensions.product();
+	}
+	int32_t brickSize() const noexcept
+	{
+		return _brickSize;
+	}
+	vec3i brickCounts() const noexcept
+	{
+		return _brickCounts;
+	}
+	int32_t brickCount() const noexcept
+	{
+		return _brickCounts.product();
+	}
+
+	// Getters for the first voxel, the size and number of voxels of a brick
+	vec3i origin( int32_t brick ) const noexcept
+	{
+		const auto z = brick % _brickCounts.z;
+		brick /= _brickCounts.z;
+		const auto y = brick % _brickCounts.y;
+		const auto x = brick / _brickCounts.y;
+		return vec3i( x, y, z ) * _brickSize;
+	}
+	vec3i extent( int32_t brick ) const noexcept
+	{
+		const auto origin = this->origin( brick );
+		return vec3i( std::min( _brickSize, _dimensions.x - origin.x ), std::min( _brickSize, _dimensions.y - origin.y ), std::min( _brickSize, _dimensions.z - origin.z ) );
+	}
+	int32_t voxelCount( int32_t brick ) const noexcept
+	{
+		return static_cast<int32_t>( _offsets[brick + 1] - _offsets[brick] );
+	}
+
+	// Getter for the number of voxels stored in front of a brick (brick-major order)
+	int64_t offset( int32_t brick ) const noexcept
+	{
+		return _offsets[brick];
+	}
+
+	// Write the volume indices of all voxels of a brick (brick-local order, like in Volume the z-coordinate changes fastest)
+	int32_t voxels( int32_t brick, int32_t* indices ) const noexcept
+	{
+		const auto origin = this->origin( brick );
+		const auto extent = this->extent( brick );
+
+		auto count = 0;
+		for( int32_t x = 0; x < extent.x; ++x )
+		{
+			for( int32_t y = 0; y < extent.y; ++y )
+			{
+				const auto row = _dimensions.z * ( origin.y + y + _dimensions.y * ( origin.x + x ) ) + origin.z;
+				for( int32_t z = 0; z < extent.z; ++z ) indices[count++] = row + z;
+			}
+		}
+		return count;
+	}
+
+	// Return the brick and brick-local index of a voxel
+	std::pair<int32_t, int32_t> locate( int32_t index ) const noexcept
+	{
+		const auto voxel = vec3i( index / ( _dimensions.z * _dimensions.y ), ( index / _dimensions.z ) % _dimensions.y, index % _dimensions.z );
+		const auto brickVoxel = voxel / _brickSize;
+		const auto brick = brickVoxel.z + _brickCounts.z * ( brickVoxel.y + _brickCounts.y * brickVoxel.x );
+
+		const auto local = voxel - brickVoxel * _brickSize;
+		const auto extent = this->extent( brick );
+		return { brick, local.z + extent.z * ( local.y + extent.y * local.x ) };
+	}
+
+	bool operator==( const BrickLayout& other ) const noexcept
+	{
+		return _dimensions == other._dimensions && _brickSize == other._brickSize;
+	}
+
+private:
+	vec3i _dimensions;
+	int32_t _brickSize = 0;
+	vec3i _brickCounts;
+	std::vector<int64_t> _offsets;
+};
+
+// Interface for brick-wise access to all members of a field. The values of a brick are interleaved by member ([voxel][member]), so that
+// per-voxel kernels read contiguous memory. Per-member kernels can request the bricks in member-major order ([member][voxel]) instead.
+class MemberBricks
+{
+public:
+	// Struct that is passed to brick kernels
+	struct Brick
+	{
+		int32_t index = 0;
+		int32_t voxelCount = 0;
+		int32_t memberCount = 0;
+		const float* values = nullptr;
+		const int32_t* voxels = nullptr;
+
+		// Values of all members at a brick-local voxel (interleaved order)
+		const float* voxel( int32_t local ) const noexcept
+		{
+			return values + static_cast<size_t>( local ) * memberCount;
+		}
+
+		// Values of a member at all voxels of the brick (member-major order)
+		const float* member( int32_t index ) const noexcept
+		{
+			return values + static_cast<size_t>( index ) * voxelCount;
+		}
+	};
+
+	MemberBricks( BrickLayout layout, int32_t memberCount ) : _layout( std::move( layout ) ), _memberCount( memberCount )
+	{}
+	virtual ~MemberBricks() = default;
+
+	// Getters for basic statistics
+	const BrickLayout& layout() const noexcept
+	{
+		return _layout;
+	}
+	int32_t memberCount() const noexcept
+	{
+		return _memberCount;
+	}
+	int32_t voxelCount() const noexcept
+	{
+		return _layout.voxelCount();
+	}
+	vec3i dimensions() const noexcept
+	{
+		return _layout.dimensions();
+	}
+
+	// Return the interleaved values of a brick. Resident implementations return a pointer to their storage, all others decode the brick into the scratch buffer.
+	virtual const float* brick( int32_t index, std::vector<float>& scratch ) const = 0;
+
+	// Read the values of all members at a single voxel (e.g. for probing)
+	virtual void voxel( int32_t index, float* values ) const
+	{
+		auto scratch = std::vector<float>();
+		const auto [brick, local] = _layout.locate( index );
+		const auto source = this->brick( brick, scratch ) + static_cast<size_t>( local ) * _memberCount;
+		std::copy( source, source + _memberCount, values );
+	}
+
+	// Return the main memory that is owned by the representation in bytes (data that is mapped from a file or shared with other members isn't counted)
+	virtual size_t residentBytes() const
+	{
+		return 0;
+	}
+
+	// Extract a single member as a volume
+	virtual Volume<float> member( int32_t index ) const
+	{
+		auto volume = Volume<float>( this->dimensions() );
+		this->forEachBrick( [&] ( const Brick& brick )
+		{
+			for( int32_t i = 0; i < brick.voxelCount; ++i )
+				volume.at( brick.voxels[i] ) = brick.voxel( i )[index];
+		} );
+		return volume;
+	}
+
+	// Order of the values that are passed to brick kernels (interleaved [voxel][member] or member-major [member][voxel])
+	enum class Order : int32_t { eInterleaved, eByMember };
+
+	// Run a kernel on all bricks in parallel, the values are passed in interleaved order ([voxel][member]). If a mask is specified, only voxels where the mask is not zero are passed.
+	void forEachBrick( const std::function<void( const Brick& )>& kernel, const Volume<float>* mask = nullptr ) const
+	{
+		util::compute_multi_threaded( 0, _layout.brickCount(), [&] ( int32_t begin, int32_t end ) { this->visit( begin, end, Order::eInterleaved, kernel, mask ); } );
+	}
+
+	// Run a kernel on all bricks in parallel, the values are passed in member-major order ([member][voxel]). If a mask is specified, only voxels where the mask is not zero are passed.
+	void forEachBrickByMember( const std::function<void( const Brick& )>& kernel, const Volume<float>* mask = nullptr ) const
+	{
+		util::compute_multi_threaded( 0, _layout.brickCount(), [&] ( int32_t begin, int32_t end ) { this->visit( begin, end, Order::eByMember, kernel, mask ); } );
+	}
+
+	// Run a kernel on all bricks in parallel that accumulates into a partial result per task (a copy of 'initial'), so no brick allocates or locks anything.
+	// The partial results are merged once per task (serialized), e.g. to accumulate sums over all member pairs without merging a matrix per brick.
+	template<typename T> void reduceBricks( const T& initial, const std::function<void( const Brick&, T& )>& kernel, const std::function<void( T& )>& merge, Order order, const Volume<float>* mask = nullptr ) const
+	{
+		auto mutex = std::mutex();
+		util::compute_multi_threaded( 0, _layout.brickCount(), [&] ( int32_t begin, int32_t end )
+		{
+			auto partial = initial;
+			this->visit( begin, end, order, [&] ( const Brick& brick ) { kernel( brick, partial ); }, mask );
+
+			const auto lock = std::scoped_lock( mutex );
+			merge( partial );
+		} );
+	}
+
+	// Compute the fingerprint of the values of all members (see fingerprint.hpp), the bricks are hashed in parallel, so it doesn't depend on the storage
+	uint64_t fingerprint() const
+	{
+		auto hashes = std::vector<uint64_t>( _layout.brickCount() );
+		this->forEachBrick( [&hashes] ( const Brick& brick )
+		{
+			hashes[brick.index] = fingerprint::xxh64( brick.values, static_cast<size_t>( brick.voxelCount ) * brick.memberCount * sizeof( float ) );
+		} );
+		const auto seed = fingerprint::combine( fingerprint::combine( fingerprint::combine( 0, _layout.dimensions() ), _layout.brickSize() ), _memberCount );
+		return fingerprint::xxh64( hashes.data(), hashes.size() * sizeof( uint64_t ), seed );
+	}
+
+	// Return a suitable brick size, such that the values of all members within a brick fit into the (L2) cache
+	static int32_t brickSize( int32_t memberCount ) noexcept
+	{
+		for( const auto size : { 16, 8 } ) if( size * size * size * memberCount * sizeof( float ) <= ( 512 << 10 ) ) return size;
+		return 4;
+	}
+
+private:
+	// Pass the bricks [begin, end) to the kernel one after another in the requested order (bricks are compacted to the voxels of the mask if specified)
+	void visit( int32_t begin, int32_t end, Order order, const std::function<void( const Brick& )>& kernel, const Volume<float>* mask ) const
+	{
+		auto scratch = std::vector<float>();
+		auto reordered = std::vector<float>();
+		auto voxels = std::vector<int32_t>( static_cast<size_t>( _layout.brickSize() ) * _layout.brickSize() * _layout.brickSize() );
+		auto selected = std::vector<int32_t>( voxels.size() );
+
+		for( int32_t i = begin; i < end; ++i )
+		{
+			// Select the voxels of the brick (bricks without selected voxels are not decoded)
+			const auto voxelCount = _layout.voxels( i, voxels.data() );
+			auto selectedCount = 0;
+			for( int32_t j = 0; j < voxelCount; ++j ) if( !mask || mask->at( voxels[j] ) != 0.0f )
+			{
+				selected[selectedCount] = j;
+				voxels[selectedCount++] = voxels[j];
+			}
+			if( selectedCount == 0 ) continue;
+
+			auto brick = Brick();
+			brick.index = i;
+			brick.memberCount = _memberCount;
+			brick.voxelCount = selectedCount;
+			brick.voxels = voxels.data();
+			brick.values = this->brick( i, scratch );
+
+			// Compact the brick to the selected voxels or transpose them to member-major order
+			if( order == Order::eByMember )
+			{
+				reordered.resize( static_cast<size_t>( selectedCount ) * _memberCount );
+				for( int32_t j = 0; j < selectedCount; ++j )
+				{
+					const auto source = brick.values + static_cast<size_t>( selected[j] ) * _memberCount;
+					for( int32_t k = 0; k < _memberCount; ++k ) reordered[static_cast<size_t>( k ) * selectedCount + j] = source[k];
+				}
+				brick.values = reordered.data();
+			}
+			else if( selectedCount != voxelCount )
+			{
+				reordered.resize( static_cast<size_t>( selectedCount ) * _memberCount );
+				for( int32_t j = 0; j < selectedCount; ++j )
+				{
+					const auto source = brick.values + static_cast<size_t>( selected[j] ) * _memberCount;
+					std::copy( source, source + _memberCount, reordered.data() + static_cast<size_t>( j ) * _memberCount );
+				}
+				brick.values = reordered.data();
+			}
+			kernel( brick );
+		}
+	}
+
+	BrickLayout _layout;
+	int32_t _memberCount = 0;
+};
+
+// Member bricks that are gathered from separate member volumes on access (does not require additional memory)
+class VolumeMembers : public MemberBricks
+{
+public:
+	VolumeMembers( std::vector<std::shared_ptr<Volume<float>>> volumes ) : MemberBricks( BrickLayout( volumes.front()->dimensions(), MemberBricks::brickSize( volumes.size() ) ), volumes.size() ), _volumes( std::move( volumes ) )
+	{}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		const auto& layout = this->layout();
+		const auto origin = layout.origin( index );
+		const auto extent = layout.extent( index );
+		const auto memberCount = this->memberCount();
+		scratch.resize( static_cast<size_t>( layout.voxelCount( index ) ) * memberCount );
+
+		// Copy rows (along z) of every member into the interleaved brick
+		auto local = 0;
+		for( int32_t x = 0; x < extent.x; ++x )
+		{
+			for( int32_t y = 0; y < extent.y; ++y, local += extent.z )
+			{
+				const auto row = _volumes.front()->voxelToIndex( origin + vec3i( x, y, 0 ) );
+				for( int32_t i = 0; i < memberCount; ++i )
+				{
+					const auto source = _volumes[i]->data() + row;
+					auto destination = scratch.data() + static_cast<size_t>( local ) * memberCount + i;
+					for( int32_t z = 0; z < extent.z; ++z, destination += memberCount ) *destination = source[z];
+				}
+			}
+		}
+		return scratch.data();
+	}
+	void voxel( int32_t index, float* values ) const override
+	{
+		for( int32_t i = 0; i < this->memberCount(); ++i ) values[i] = _volumes[i]->at( index );
+	}
+	Volume<float> member( int32_t index ) const override
+	{
+		return *_volumes[index];
+	}
+	size_t residentBytes() const override
+	{
+		auto bytes = size_t( 0 );
+		for( const auto& volume : _volumes ) if( !volume->wrapped() ) bytes += static_cast<size_t>( volume->voxelCount() ) * sizeof( float );
+		return bytes;
+	}
+
+private:
+	std::vector<std::shared_ptr<Volume<float>>> _volumes;
+};
+
+// Member bricks that are stored contiguously in brick-major order with interleaved members (tile-major, member-minor)
+class InterleavedMembers : public MemberBricks
+{
+public:
+	InterleavedMembers( vec3i dimensions, int32_t memberCount ) : MemberBricks( BrickLayout( dimensions, MemberBricks::brickSize( memberCount ) ), memberCount ),
+		_values( static_cast<size_t>( dimensions.product() ) * memberCount ), _data( _values.data() )
+	{}
+	InterleavedMembers( BrickLayout layout, int32_t memberCount ) : MemberBricks( std::move( layout ), memberCount ),
+		_values( static_cast<size_t>( this->voxelCount() ) * memberCount ), _data( _values.data() )
+	{}
+
+	// Wrap interleaved bricks that are not owned (e.g. in a mapped file), 'owner' keeps the values alive
+	InterleavedMembers( BrickLayout layout, int32_t memberCount, float* values, std::shared_ptr<const void> owner ) : MemberBricks( std::move( layout ), memberCount ),
+		_data( values ), _owner( std::move( owner ) )
+	{}
+
+	// Scatter the values of a member volume into the interleaved storage
+	void setMember( int32_t index, const Volume<float>& volume )
+	{
+		if( volume.dimensions() != this->dimensions() ) throw std::runtime_error( "InterleavedMembers::setMember -> Dimensions of volume don't match." );
+
+		const auto& layout = this->layout();
+		const auto memberCount = this->memberCount();
+		util::compute_multi_threaded( 0, layout.brickCount(), [&] ( int32_t begin, int32_t end )
+		{
+			auto voxels = std::vector<int32_t>( static_cast<size_t>( layout.brickSize() ) * layout.brickSize() * layout.brickSize() );
+			for( int32_t i = begin; i < end; ++i )
+			{
+				const auto voxelCount = layout.voxels( i, voxels.data() );
+				auto destination = _data + layout.offset( i ) * memberCount + index;
+				for( int32_t j = 0; j < voxelCount; ++j ) destination[static_cast<size_t>( j ) * memberCount] = volume.at( voxels[j] );
+			}
+		} );
+	}
+
+	// Scatter a slab of a member into the interleaved storage, the slab contains the layers of one row of bricks along x (e.g. streamed from a file).
+	// Slabs of different members or different rows can be written concurrently.
+	void setSlab( int32_t index, int32_t row, const float* values )
+	{
+		const auto& layout = this->layout();
+		const auto dimensions = this->dimensions();
+		const auto memberCount = this->memberCount();
+		const auto bricksPerRow = layout.brickCounts().y * layout.brickCounts().z;
+		for( int32_t i = row * bricksPerRow; i < ( row + 1 ) * bricksPerRow; ++i )
+		{
+			const auto origin = layout.origin( i );
+			const auto extent = layout.extent( i );
+			auto destination = _data + layout.offset( i ) * memberCount + index;
+			for( int32_t x = 0; x < extent.x; ++x )
+			{
+				for( int32_t y = 0; y < extent.y; ++y )
+				{
+					const auto source = values + static_cast<size_t>( dimensions.z ) * ( origin.y + y + static_cast<size_t>( dimensions.y ) * x ) + origin.z;
+					for( int32_t z = 0; z < extent.z; ++z, destination += memberCount ) *destination = source[z];
+				}
+			}
+		}
+	}
+
+	// Getter for the writable values of a brick (e.g. to decompress bricks into the storage)
+	float* values( int32_t brick ) noexcept
+	{
+		return _data + this->layout().offset( brick ) * this->memberCount();
+	}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		return _data + this->layout().offset( index ) * this->memberCount();
+	}
+	void voxel( int32_t index, float* values ) const override
+	{
+		const auto [brick, local] = this->layout().locate( index );
+		const auto source = _data + ( this->layout().offset( brick ) + local ) * this->memberCount();
+		std::copy( source, source + this->memberCount(), values );
+	}
+	size_t residentBytes() const override
+	{
+		return _values.size() * sizeof( float );
+	}
+
+private:
+	std::vector<float> _values;
+	float* _data = nullptr;
+	std::shared_ptr<const void> _owner;
+};
+
+// Member bricks that are compressed individually (see compression.hpp) and decompressed on access. The brick index contains the offset of every
+// compressed brick (and the end of the last brick), so bricks can be decompressed independently and in parallel.
+class CompressedMembers : public MemberBricks
+{
+public:
+	// Wrap compressed bricks that are not owned (e.g. in a mapped file), 'owner' keeps the data alive
+	CompressedMembers( BrickLayout layout, int32_t memberCount, std::vector<uint64_t> index, const uint8_t* data, std::shared_ptr<const void> owner ) : MemberBricks( std::move( layout ), memberCount ),
+		_index( std::move( index ) ), _data( data ), _owner( std::move( owner ) )
+	{
+		if( _index.size() != static_cast<size_t>( this->layout().brickCount() ) + 1 ) throw std::invalid_argument( "CompressedMembers::CompressedMembers -> Size of the brick index doesn't match the layout." );
+	}
+
+	// Compress all bricks of other member bricks in parallel, optionally encoding the values of every brick (quantized or as residuals, see compression::Encoding)
+	static std::shared_ptr<CompressedMembers> compress( const MemberBricks& members, const compression::Encoding& encoding = compression::Encoding() )
+	{
+		const auto& layout = members.layout();
+		auto blocks = std::vector<std::vector<uint8_t>>( layout.brickCount() );
+		util::compute_multi_threaded( 0, layout.brickCount(), [&] ( int32_t begin, int32_t end )
+		{
+			auto scratch = std::vector<float>();
+			for( int32_t i = begin; i < end; ++i )
+				blocks[i] = compression::compress( members.brick( i, scratch ), layout.voxelCount( i ), members.memberCount(), encoding );
+		} );
+
+		auto index = std::vector<uint64_t>( blocks.size() + 1, 0 );
+		for( size_t i = 0; i < blocks.size(); ++i ) index[i + 1] = index[i] + blocks[i].size();
+
+		auto data = std::make_shared<std::vector<uint8_t>>( index.back() );
+		util::compute_multi_threaded( 0, layout.brickCount(), [&] ( int32_t begin, int32_t end )
+		{
+			for( int32_t i = begin; i < end; ++i ) std::copy( blocks[i].begin(), blocks[i].end(), data->data() + index[i] );
+		} );
+		auto compressed = std::make_shared<CompressedMembers>( layout, members.memberCount(), std::move( index ), data->data(), data );
+		compressed->_owned = true;
+		return compressed;
+	}
+
+	// Return the compressed members that back other members (compressed, lazily decompressed or paged members), or nullptr
+	static std::shared_ptr<const CompressedMembers> source( const std::shared_ptr<const MemberBricks>& members );
+
+	// Decompress all bricks in parallel
+	std::shared_ptr<InterleavedMembers> decompress() const
+	{
+		auto members = std::make_shared<InterleavedMembers>( this->layout(), this->memberCount() );
+		util::compute_multi_threaded( 0, this->layout().brickCount(), [&] ( int32_t begin, int32_t end )
+		{
+			for( int32_t i = begin; i < end; ++i ) this->decompress( i, members->values( i ) );
+		} );
+		return members;
+	}
+
+	// Copy the compressed bricks into memory (e.g. to release a mapped file)
+	std::shared_ptr<CompressedMembers> copy() const
+	{
+		auto data = std::make_shared<std::vector<uint8_t>>( _data, _data + this->bytes() );
+		auto copy = std::make_shared<CompressedMembers>( this->layout(), this->memberCount(), _index, data->data(), data );
+		copy->_owned = true;
+		return copy;
+	}
+
+	// Decompress a single brick into preallocated values
+	void decompress( int32_t brick, float* values ) const
+	{
+		compression::decompress( _data + _index[brick], _index[brick + 1] - _index[brick], values, static_cast<size_t>( this->layout().voxelCount( brick ) ) * this->memberCount() );
+	}
+
+	// Whether any brick is encoded lossily (quantized or bounded residuals), decoding and encoding such values again adds to their error
+	bool lossy() const noexcept
+	{
+		for( int32_t i = 0; i < this->layout().brickCount(); ++i )
+		{
+			if( _index[i + 1] == _index[i] ) continue;
+			const auto block = _data + _index[i];
+			const auto method = static_cast<compression::Method>( block[0] );
+			if( method == compression::Method::eHalf || method == compression::Method::eScaled16 || method == compression::Method::eScaled8 ) return true;
+			if( method == compression::Method::eResiduals && _index[i + 1] - _index[i] >= 1 + sizeof( uint32_t ) + sizeof( float ) )
+			{
+				auto step = 0.0f;
+				std::memcpy( &step, block + 1 + sizeof( uint32_t ), sizeof( float ) );
+				if( step > 0.0f ) return true;
+			}
+		}
+		return false;
+	}
+
+	// Getters for the brick index and the compressed data
+	const std::vector<uint64_t>& index() const noexcept
+	{
+		return _index;
+	}
+	const uint8_t* data() const noexcept
+	{
+		return _data;
+	}
+	uint64_t bytes() const noexcept
+	{
+		return _index.back();
+	}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		scratch.resize( static_cast<size_t>( this->layout().voxelCount( index ) ) * this->memberCount() );
+		this->decompress( index, scratch.data() );
+		return scratch.data();
+	}
+	size_t residentBytes() const override
+	{
+		return _index.size() * sizeof( uint64_t ) + ( _owned ? this->bytes() : 0 );
+	}
+
+private:
+	std::vector<uint64_t> _index;
+	const uint8_t* _data = nullptr;
+	std::shared_ptr<const void> _owner;
+	bool _owned = false;
+};
+
+// Member bricks that are decompressed as a whole on first access (e.g. members of a file, which are only decompressed when the field is used)
+class LazyMembers : public MemberBricks
+{
+public:
+	LazyMembers( std::shared_ptr<const CompressedMembers> compressed ) : MemberBricks( compressed->layout(), compressed->memberCount() ), _compressed( std::move( compressed ) )
+	{}
+
+	// Getter for the compressed members (e.g. to save them without compressing them again)
+	const std::shared_ptr<const CompressedMembers>& compressed() const noexcept
+	{
+		return _compressed;
+	}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		return this->resident().brick( index, scratch );
+	}
+	void voxel( int32_t index, float* values ) const override
+	{
+		this->resident().voxel( index, values );
+	}
+	size_t residentBytes() const override
+	{
+		const auto resident = std::atomic_load( &_resident );
+		return _compressed->residentBytes() + ( resident ? resident->residentBytes() : 0 );
+	}
+
+private:
+	// Decompress the members once. The first request decompresses the bricks in parallel, concurrent requests (e.g. from tasks of the thread pool) take
+	// bricks that are not decompressed yet instead of waiting, so they only wait for bricks that are being decompressed by running threads.
+	const MemberBricks& resident() const
+	{
+		if( const auto resident = std::atomic_load( &_resident ) ) return *resident;
+
+		auto members = std::shared_ptr<InterleavedMembers>();
+		auto first = false;
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			if( !_decompressing && !_exception )
+			{
+				_decompressing = std::make_shared<InterleavedMembers>( this->layout(), this->memberCount() );
+				first = true;
+			}
+			members = _decompressing;
+		}
+		if( first ) util::compute_multi_threaded( [&] ( int32_t, int32_t ) { this->decompress( *members ); } );
+		else if( members ) this->decompress( *members );
+
+		auto lock = std::unique_lock( _mutex );
+		_condition.wait( lock, [this] { return std::atomic_load( &_resident ) || _exception; } );
+		if( _exception ) std::rethrow_exception( _exception );
+		return *_resident;
+	}
+	void decompress( InterleavedMembers& members ) const
+	{
+		const auto brickCount = this->layout().brickCount();
+		auto count = int32_t( 0 );
+		auto exception = std::exception_ptr();
+		try
+		{
+			for( auto i = _next++; i < brickCount; i = _next++, ++count ) _compressed->decompress( i, members.values( i ) );
+		}
+		catch( ... ) { exception = std::current_exception(); }
+
+		// The last finished brick publishes the members
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			if( exception && !_exception ) _exception = exception;
+			if( ( _finished += count ) == brickCount ) std::atomic_store( &_resident, std::shared_ptr<const InterleavedMembers>( std::exchange( _decompressing, nullptr ) ) );
+			else if( !exception ) return;
+		}
+		_condition.notify_all();
+	}
+
+	std::shared_ptr<const CompressedMembers> _compressed;
+	mutable std::shared_ptr<const InterleavedMembers> _resident;
+	mutable std::shared_ptr<InterleavedMembers> _decompressing;
+	mutable std::atomic<int32_t> _next { 0 };
+	mutable int32_t _finished = 0;
+	mutable std::exception_ptr _exception;
+	mutable std::mutex _mutex;
+	mutable std::condition_variable _condition;
+};
+
+// Member bricks that are decompressed on access and kept in a bounded cache (the least recently used bricks are dropped), so fields can be larger than
+// the main memory if the compressed bricks are mapped from a file. The bricks following a requested brick are decompressed ahead by a background thread.
+class PagedMembers : public MemberBricks
+{
+public:
+	PagedMembers( std::shared_ptr<const CompressedMembers> compressed, size_t cacheSize ) : MemberBricks( compressed->layout(), compressed->memberCount() ),
+		_compressed( std::move( compressed ) ), _cacheSize( cacheSize ), _prefetcher( [this] { this->prefetch(); } )
+	{}
+	PagedMembers( const PagedMembers& ) = delete;
+	~PagedMembers()
+	{
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			_stopping = true;
+		}
+		_condition.notify_all();
+		_prefetcher.join();
+	}
+
+	// Getters for the compressed members and the size of the brick cache (in bytes)
+	const std::shared_ptr<const CompressedMembers>& compressed() const noexcept
+	{
+		return _compressed;
+	}
+	size_t cacheSize() const noexcept
+	{
+		return _cacheSize;
+	}
+	size_t residentBytes() const override
+	{
+		const auto lock = std::scoped_lock( _mutex );
+		return _compressed->residentBytes() + _cachedBytes;
+	}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		// Wait for bricks that are being prefetched and queue the following bricks
+		auto values = std::shared_ptr<const std::vector<float>>();
+		{
+			auto lock = std::unique_lock( _mutex );
+			_condition.wait( lock, [&] { return !_loading.count( index ); } );
+			values = this->find( index );
+
+			const auto last = std::min( index + PrefetchDistance, this->layout().brickCount() - 1 );
+			for( int32_t i = index + 1; i <= last && _queue.size() < MaxQueued; ++i )
+				if( !_entries.count( i ) && !_loading.count( i ) && std::find( _queue.begin(), _queue.end(), i ) == _queue.end() ) _queue.push_back( i );
+		}
+		_condition.notify_all();
+
+		// Cached bricks are copied, as they may be dropped while the caller uses them
+		if( values ) scratch.assign( values->begin(), values->end() );
+		else
+		{
+			_compressed->brick( index, scratch );
+			const auto lock = std::scoped_lock( _mutex );
+			this->insert( index, std::make_shared<const std::vector<float>>( scratch ) );
+		}
+		return scratch.data();
+	}
+
+private:
+	// Number of bricks that are decompressed ahead and maximum number of queued bricks
+	static constexpr int32_t PrefetchDistance = 2;
+	static constexpr size_t MaxQueued = 256;
+
+	struct Entry
+	{
+		std::shared_ptr<const std::vector<float>> values;
+		std::list<int32_t>::iterator position;
+	};
+
+	// Return a cached brick and mark it as most recently used, or insert a brick and drop the least recently used bricks (the mutex has to be locked)
+	std::shared_ptr<const std::vector<float>> find( int32_t index ) const
+	{
+		const auto it = _entries.find( index );
+		if( it == _entries.end() ) return nullptr;
+		_order.splice( _order.begin(), _order, it->second.position );
+		return it->second.values;
+	}
+	void insert( int32_t index, std::shared_ptr<const std::vector<float>> values ) const
+	{
+		if( _entries.count( index ) ) return;
+		_cachedBytes += values->size() * sizeof( float );
+		_order.push_front( index );
+		_entries[index] = Entry { std::move( values ), _order.begin() };
+
+		while( _cachedBytes > _cacheSize && !_order.empty() )
+		{
+			const auto it = _entries.find( _order.back() );
+			_cachedBytes -= it->second.values->size() * sizeof( float );
+			_entries.erase( it );
+			_order.pop_back();
+		}
+	}
+
+	// Decompress queued bricks until the members are destroyed (failures are ignored, they are reported when the brick is requested)
+	void prefetch() const
+	{
+		auto lock = std::unique_lock( _mutex );
+		while( true )
+		{
+			_condition.wait( lock, [this] { return _stopping || !_queue.empty(); } );
+			if( _stopping ) return;
+
+			const auto index = _queue.front();
+			_queue.pop_front();
+			if( _entries.count( index ) ) continue;
+			_loading.insert( index );
+			lock.unlock();
+
+			auto values = std::make_shared<std::vector<float>>();
+			try
+			{
+				_compressed->brick( index, *values );
+			}
+			catch( const std::exception& )
+			{
+				values.reset();
+			}
+
+			lock.lock();
+			_loading.erase( index );
+			if( values ) this->insert( index, std::move( values ) );
+			_condition.notify_all();
+		}
+	}
+
+	std::shared_ptr<const CompressedMembers> _compressed;
+	size_t _cacheSize = 0;
+
+	mutable std::unordered_map<int32_t, Entry> _entries;
+	mutable std::list<int32_t> _order;
+	mutable size_t _cachedBytes = 0;
+	mutable std::set<int32_t> _loading;
+	mutable std::deque<int32_t> _queue;
+	mutable std::mutex _mutex;
+	mutable std::condition_variable _condition;
+	bool _stopping = false;
+	std::thread _prefetcher;
+};
+
+inline std::shared_ptr<const CompressedMembers> CompressedMembers::source( const std::shared_ptr<const MemberBricks>& members )
+{
+	if( auto compressed = std::dynamic_pointer_cast<const CompressedMembers>( members ) ) return compressed;
+	if( const auto lazy = std::dynamic_pointer_cast<const LazyMembers>( members ) ) return lazy->compressed();
+	if( const auto paged = std::dynamic_pointer_cast<const PagedMembers>( members ) ) return paged->compressed();
+	return nullptr;
+}
+
+// Member bricks that are represented by a low-rank approximation: the mean of every member, the leading principal components of the members (per-member
+// coefficients) and the projections of all voxels onto the components (basis volumes, stored as interleaved bricks [voxel][component]). The values are
+// reconstructed per brick as mean[member] + sum( basis[voxel][c] * coefficients[c][member] ), so the memory grows with voxels * rank instead of voxels * members.
+// The variances of the components (eigenvalues) and the domains of the members are kept to approximate similarities without reconstructing the members.
+class LowRankMembers : public MemberBricks
+{
+public:
+	// The coefficients are stored component by component ([component][member])
+	LowRankMembers( BrickLayout layout, int32_t memberCount, std::vector<float> means, std::vector<float> coefficients, std::vector<float> variances ) : MemberBricks( std::move( layout ), memberCount ),
+		_rank( static_cast<int32_t>( variances.size() ) ), _means( std::move( means ) ), _coefficients( std::move( coefficients ) ), _variances( std::move( variances ) ),
+		_basis( static_cast<size_t>( this->voxelCount() ) * _rank ), _minima( memberCount ), _maxima( memberCount )
+	{
+		if( _means.size() != static_cast<size_t>( memberCount ) || _coefficients.size() != static_cast<size_t>( _rank ) * memberCount )
+			throw std::invalid_argument( "LowRankMembers::LowRankMembers -> Sizes of the means and coefficients don't match." );
+	}
+
+	// Getters for the rank, the means, coefficients and variances of the components
+	int32_t rank() const noexcept
+	{
+		return _rank;
+	}
+	const std::vector<float>& means() const noexcept
+	{
+		return _means;
+	}
+	const float* coefficients( int32_t component ) const noexcept
+	{
+		return _coefficients.data() + static_cast<size_t>( component ) * this->memberCount();
+	}
+	const std::vector<float>& variances() const noexcept
+	{
+		return _variances;
+	}
+
+	// Getters for the basis values of a brick, the bricks are stored one after another (writable to store the projections of the voxels)
+	float* basis( int32_t brick ) noexcept
+	{
+		return _basis.data() + this->layout().offset( brick ) * _rank;
+	}
+	const float* basis( int32_t brick ) const noexcept
+	{
+		return _basis.data() + this->layout().offset( brick ) * _rank;
+	}
+
+	// Setter and getter for the domain (minimum and maximum) of the original values of the members
+	void setDomain( int32_t member, vec2f domain ) noexcept
+	{
+		_minima[member] = domain.x;
+		_maxima[member] = domain.y;
+	}
+	vec2f domain( int32_t member ) const noexcept
+	{
+		return vec2f( _minima[member], _maxima[member] );
+	}
+
+	size_t residentBytes() const override
+	{
+		return ( _basis.size() + _means.size() + _coefficients.size() ) * sizeof( float );
+	}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		const auto voxelCount = this->layout().voxelCount( index );
+		scratch.resize( static_cast<size_t>( voxelCount ) * this->memberCount() );
+		this->reconstruct( _basis.data() + this->layout().offset( index ) * _rank, voxelCount, scratch.data() );
+		return scratch.data();
+	}
+	void voxel( int32_t index, float* values ) const override
+	{
+		const auto [brick, local] = this->layout().locate( index );
+		this->reconstruct( _basis.data() + ( this->layout().offset( brick ) + local ) * _rank, 1, values );
+	}
+
+private:
+	// Reconstruct the values of consecutive voxels, the loops over the members are simple enough to be vectorized by the compiler
+	void reconstruct( const float* basis, int32_t voxelCount, float* values ) const noexcept
+	{
+		const auto memberCount = this->memberCount();
+		for( int32_t i = 0; i < voxelCount; ++i, basis += _rank, values += memberCount )
+		{
+			std::copy( _means.begin(), _means.end(), values );
+			for( int32_t c = 0; c < _rank; ++c )
+			{
+				const auto weight = basis[c];
+				const auto coefficients = this->coefficients( c );
+				for( int32_t j = 0; j < memberCount; ++j ) values[j] += weight * coefficients[j];
+			}
+		}
+	}
+
+	int32_t _rank = 0;
+	std::vector<float> _means;
+	std::vector<float> _coefficients;
+	std::vector<float> _variances;
+	std::vector<float> _basis;
+	std::vector<float> _minima;
+	std::vector<float> _maxima;
+};
+
+// View on a subset of the members of other member bricks (e.g. for sub-ensembles)
+class SubsetMembers : public MemberBricks
+{
+public:
+	SubsetMembers( std::shared_ptr<const MemberBricks> members, std::vector<int32_t> indices ) : MemberBricks( members->layout(), indices.size() ), _members( std::move( members ) ), _indices( std::move( indices ) )
+	{}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		thread_local auto source = std::vector<float>();
+		const auto values = _members->brick( index, source );
+
+		const auto voxelCount = this->layout().voxelCount( index );
+		const auto memberCount = this->memberCount();
+		const auto sourceMemberCount = _members->memberCount();
+		scratch.resize( static_cast<size_t>( voxelCount ) * memberCount );
+
+		for( int32_t i = 0; i < voxelCount; ++i )
+		{
+			const auto voxel = values + static_cast<size_t>( i ) * sourceMemberCount;
+			for( int32_t j = 0; j < memberCount; ++j ) scratch[static_cast<size_t>( i ) * memberCount + j] = voxel[_indices[j]];
+		}
+		return scratch.data();
+	}
+	void voxel( int32_t index, float* values ) const override
+	{
+		auto source = std::vector<float>( _members->memberCount() );
+		_members->voxel( index, source.data() );
+		for( int32_t i = 0; i < this->memberCount(); ++i ) values[i] = source[_indices[i]];
+	}
+	Volume<float> member( int32_t index ) const override
+	{
+		return _members->member( _indices[index] );
+	}
+
+private:
+	std::shared_ptr<const MemberBricks> _members;
+	std::vector<int32_t> _indices;
+};
+
+// Member bricks that are evaluated from the member bricks of other fields on access (virtual fields, e.g. the magnitude of a vector field)
+class ExpressionMembers : public MemberBricks
+{
+public:
+	ExpressionMembers( std::vector<std::shared_ptr<const MemberBricks>> inputs, Expression expression ) : MemberBricks( inputs.front()->layout(), inputs.front()->memberCount() ), _inputs( std::move( inputs ) ), _expression( std::move( expression ) )
+	{
+		for( const auto& input : _inputs )
+			if( !( input->layout() == this->layout() ) || input->memberCount() != this->memberCount() ) throw std::invalid_argument( "ExpressionMembers::ExpressionMembers -> Layouts of the inputs don't match." );
+	}
+
+	const float* brick( int32_t index, std::vector<float>& scratch ) const override
+	{
+		// Inputs may be virtual themselves, so every nesting level uses its own buffers (a deque keeps the buffers of outer levels in place)
+		thread_local auto levels = std::deque<std::vector<std::vector<float>>>();
+		thread_local auto depth = size_t( 0 );
+		if( levels.size() == depth ) levels.emplace_back();
+		auto& buffers = levels[depth++];
+		struct Level { size_t& depth; ~Level() { --depth; } };
+		const auto level = Level { depth }; // Leaves the nesting level again, also if an input throws
+		buffers.resize( _inputs.size() );
+
+		auto values = std::vector<const float*>( _inputs.size(), nullptr );
+		for( size_t i = 0; i < _inputs.size(); ++i ) if( _expression.uses( i ) ) values[i] = _inputs[i]->brick( index, buffers[i] );
+
+		const auto count = static_cast<int64_t>( this->layout().voxelCount( index ) ) * this->memberCount();
+		scratch.resize( count );
+		_expression.evaluate( values.data(), scratch.data(), count );
+		return scratch.data();
+	}
+	void voxel( int32_t index, float* values ) const override
+	{
+		auto buffers = std::vector<std::vector<float>>( _inputs.size() );
+		auto inputs = std::vector<const float*>( _inputs.size(), nullptr );
+		for( size_t i = 0; i < _inputs.size(); ++i ) if( _expression.uses( i ) )
+		{
+			buffers[i].resize( this->memberCount() );
+			_inputs[i]->voxel( index, buffers[i].data() );
+			inputs[i] = buffers[i].data();
+		}
+		_expression.evaluate( inputs.data(), values, this->memberCount() );
+	}
+
+	// Getters for the inputs and the expression
+	const std::vector<std::shared_ptr<const MemberBricks>>& inputs() const noexcept
+	{
+		return _inputs;
+	}
+	const Expression& expression() const noexcept
+	{
+		return _expression;
+	}
+
+private:
+	std::vector<std::shared_ptr<const MemberBricks>> _inputs;
+	Expression _expression;
+};
\ No newline at end of file
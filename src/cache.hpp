@@ -0,0 +1,138 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Thread-safe cache of lazily initialized values. Entries are created once per key and never move, so references to values stay valid.
+// Lookups are lock-free: the entries are published as an immutable map (copy-on-write) using std::atomic_load and std::atomic_store.
+// Every value is initialized exactly once, concurrent requests for the same key wait for the initialization while other keys are not blocked.
+template<typename Key, typename Value, typename Compare = std::less<Key>> class LazyCache
+{
+public:
+	LazyCache() : _entries( std::make_shared<const Map>() )
+	{}
+
+	// Moving is not thread-safe (the entries and thereby references to values are kept, the other cache is left empty)
+	LazyCache( LazyCache&& other ) noexcept : _entries( std::atomic_exchange( &other._entries, std::make_shared<const Map>() ) )
+	{}
+	LazyCache& operator=( LazyCache&& other ) noexcept
+	{
+		std::atomic_store( &_entries, std::atomic_exchange( &other._entries, std::make_shared<const Map>() ) );
+		return *this;
+	}
+
+	// Return the value of the key, 'initialize' (Value()) is only called for the first request
+	template<typename Initializer> const Value& get( const Key& key, Initializer initialize ) const
+	{
+		auto& entry = this->entry( key );
+		if( !entry.ready.load( std::memory_order_acquire ) ) std::call_once( entry.once, [&]
+		{
+			entry.value = initialize();
+			entry.ready.store( true, std::memory_order_release );
+		} );
+		return entry.value;
+	}
+
+	// Return the value of the key, or nullptr if it is not initialized (yet)
+	const Value* find( const Key& key ) const noexcept
+	{
+		const auto entries = std::atomic_load( &_entries );
+		const auto it = entries->find( key );
+		return ( it != entries->end() && it->second->ready.load( std::memory_order_acquire ) ) ? &it->second->value : nullptr;
+	}
+
+	// Initialize or replace the value of the key. Replacing assigns the value in place, so references stay valid (but must not be used concurrently).
+	Value& set( const Key& key, Value value ) const
+	{
+		auto& entry = this->entry( key );
+		auto initialized = false;
+		std::call_once( entry.once, [&]
+		{
+			entry.value = std::move( value );
+			entry.ready.store( true, std::memory_order_release );
+			initialized = true;
+		} );
+		if( !initialized ) entry.value = std::move( value );
+		return entry.value;
+	}
+
+	// Call the function for all initialized entries in the order of their keys
+	template<typename Function> void forEach( Function function ) const
+	{
+		const auto entries = std::atomic_load( &_entries );
+		for( const auto& [key, entry] : *entries ) if( entry->ready.load( std::memory_order_acquire ) ) function( key, entry->value );
+	}
+
+	// Return the number of initialized entries
+	size_t size() const noexcept
+	{
+		auto size = size_t( 0 );
+		this->forEach( [&size] ( const Key&, const Value& ) { ++size; } );
+		return size;
+	}
+
+	// Remove the entry of the key (not thread-safe, invalidates references to its value)
+	void erase( const Key& key )
+	{
+		const auto lock = std::scoped_lock( _mutex );
+		auto copy = std::make_shared<Map>( *std::atomic_load( &_entries ) );
+		copy->erase( key );
+		std::atomic_store( &_entries, std::shared_ptr<const Map>( std::move( copy ) ) );
+	}
+
+	// Remove all entries (not thread-safe, invalidates all references to values)
+	void clear()
+	{
+		std::atomic_store( &_entries, std::make_shared<const Map>() );
+	}
+
+	// Compare the initialized entries of two caches
+	bool operator==( const LazyCache& other ) const
+	{
+		auto values = std::map<Key, const Value*, Compare>();
+		this->forEach( [&values] ( const Key& key, const Value& value ) { values[key] = &value; } );
+
+		auto equal = true;
+		auto count = size_t( 0 );
+		other.forEach( [&] ( const Key& key, const Value& value )
+		{
+			const auto it = values.find( key );
+			equal = equal && it != values.end() && *it->second == value;
+			++count;
+		} );
+		return equal && count == values.size();
+	}
+	bool operator!=( const LazyCache& other ) const
+	{
+		return !( *this == other );
+	}
+
+private:
+	struct Entry
+	{
+		Value value;
+		std::once_flag once;
+		std::atomic<bool> ready { false };
+	};
+	using Map = std::map<Key, std::shared_ptr<Entry>, Compare>;
+
+	// Return the entry of the key, creating and publishing a new map if the key is missing
+	Entry& entry( const Key& key ) const
+	{
+		if( const auto entries = std::atomic_load( &_entries ); entries->count( key ) ) return *entries->at( key );
+
+		const auto lock = std::scoped_lock( _mutex );
+		const auto entries = std::atomic_load( &_entries );
+		if( const auto it = entries->find( key ); it != entries->end() ) return *it->second;
+
+		auto copy = std::make_shared<Map>( *entries );
+		auto& entry = *( ( *copy )[key] = std::make_shared<Entry>() );
+		std::atomic_store( &_entries, std::shared_ptr<const Map>( std::move( copy ) ) );
+		return entry;
+	}
+
+	mutable std::shared_ptr<const Map> _entries;
+	mutable std::mutex _mutex;
+};
\ No newline at end of file
@@ -296,7 +296,7 @@ public:
 	}
 
 	// Return the input volume
-	const Volume<float>* volume() const noexcept
+	const VolumeView& volume() const noexcept
 	{
 		return _volume;
 	}
@@ -343,11 +343,12 @@ public slots:
 	}
 
 	// Setter for the input volume
-	void setVolume( const Volume<float>* volume )
+	void setVolume( VolumeView volume )
 	{
 		if( _volume != volume )
 		{
 			_volume = volume;
+			_volumePin = volume ? volume.pin() : util::MemoryBudget::Pin();
 			this->updateHistogram();
 		}
 	}
@@ -729,18 +730,20 @@ private:
 		if( _volume && _mask )
 		{
 			auto counters = std::vector<std::pair<double, double>>( 100 );
-			for( size_t i = 0; i < _volume->voxelCount(); ++i )
+			_volume.forEachChunk( [&] ( int32_t begin, int32_t count, const float* values )
 			{
-				const auto value = _volume->at( i );
-				const auto x = ( value - _colorMap->domain().x ) / ( _colorMap->domain().y - _colorMap->domain().x );
-				const auto index = std::clamp( static_cast<int32_t>( x * counters.size() ), 0, static_cast<int32_t>( counters.size() - 1 ) );
-				if( _mask->at( i ) ) ++counters[index].first;
-				++counters[index].second;
-			}
+				for( int32_t i = 0; i < count; ++i )
+				{
+					const auto x = ( values[i] - _colorMap->domain().x ) / ( _colorMap->domain().y - _colorMap->domain().x );
+					const auto index = std::clamp( static_cast<int32_t>( x * counters.size() ), 0, static_cast<int32_t>( counters.size() - 1 ) );
+					if( _mask->at( begin + i ) ) ++counters[index].first;
+					++counters[index].second;
+				}
+			} );
 
 			if( _logarithmicHistogram )
 			{
-				const auto max = std::log10( _volume->voxelCount() + 1 );
+				const auto max = std::log10( _volume.voxelCount() + 1 );
 				for( auto& [first, second] : counters )
 				{
 					first = std::log10( first + 1 ) / max;
@@ -749,11 +752,11 @@ private:
 			}
 			else
 			{
-				const auto max = std::log10( _volume->voxelCount() + 1 );
+				const auto max = std::log10( _volume.voxelCount() + 1 );
 				for( auto& [first, second] : counters )
 				{
-					first = first / _volume->voxelCount();
-					second = second / _volume->voxelCount();
+					first = first / _volume.voxelCount();
+					second = second / _volume.voxelCount();
 				}
 			}
 
@@ -801,7 +804,8 @@ private:
 	static constexpr int32_t Padding = 10;
 
 	ColorMap1D* _colorMap = nullptr;
-	const Volume<float>* _volume = nullptr;
+	VolumeView _volume;
+	util::MemoryBudget::Pin _volumePin;
 	std::shared_ptr<Volume<float>> _mask;
 	QImage _histogram;
 	bool _logarithmicHistogram = true;
@@ -871,7 +875,7 @@ public:
 	}
 
 	// Getter for the current input volume
-	const Volume<float>* volume() const noexcept
+	const VolumeView& volume() const noexcept
 	{
 		return _nodeEditor->volume();
 	}
@@ -904,9 +908,9 @@ public slots:
 	}
 
 	// Setter for the input volume
-	void setVolume( const Volume<float>* volume )
+	void setVolume( VolumeView volume )
 	{
-		_nodeEditor->setVolume( volume );
+		_nodeEditor->setVolume( std::move( volume ) );
 		this->updateDomain();
 	}
 
@@ -1158,21 +1162,26 @@ public:
 		this->update();
 	}
 
-	// Setter for the two input volumes
-	void setVolumes( const Volume<float>* first, const Volume<float>* second )
+	// Setter for the two input volumes (differences are uploaded chunk by chunk)
+	void setVolumes( VolumeView first, VolumeView second )
 	{
 		_volumes = std::make_pair( first, second );
+		_volumePins = std::make_pair( first ? first.pin() : util::MemoryBudget::Pin(), second ? second.pin() : util::MemoryBudget::Pin() );
 
 		if( first && second )
 		{
-			_voxelCount = first->voxelCount();
+			_voxelCount = first.voxelCount();
 
 			this->makeCurrent();
-			glBindBuffer( GL_SHADER_STORAGE_BUFFER, _firstVolumeBuffer );
-			glBufferData( GL_SHADER_STORAGE_BUFFER, first->voxelCount() * sizeof( float ), first->data(), GL_STATIC_DRAW );
-
-			glBindBuffer( GL_SHADER_STORAGE_BUFFER, _secondVolumeBuffer );
-			glBufferData( GL_SHADER_STORAGE_BUFFER, second->voxelCount() * sizeof( float ), second->data(), GL_STATIC_DRAW );
+			for( const auto& [volume, buffer] : { std::make_pair( first, _firstVolumeBuffer ), std::make_pair( second, _secondVolumeBuffer ) } )
+			{
+				glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffer );
+				glBufferData( GL_SHADER_STORAGE_BUFFER, volume.voxelCount() * sizeof( float ), nullptr, GL_STATIC_DRAW );
+				volume.forEachChunk( [this] ( int32_t begin, int32_t count, const float* values )
+				{
+					glBufferSubData( GL_SHADER_STORAGE_BUFFER, begin * sizeof( float ), count * sizeof( float ), values );
+				} );
+			}
 			this->update();
 		}
 	}
@@ -1518,7 +1527,7 @@ private:
 		if( _volumes.first && _volumes.second )
 		{
 			_shaderPoints.bind();
-			_shaderPoints.setUniformValue( "voxelCount", _volumes.first->voxelCount() );
+			_shaderPoints.setUniformValue( "voxelCount", _volumes.first.voxelCount() );
 			_shaderPoints.setUniformValue( "ranges[0]", _colorMap->firstDomain().x, _colorMap->firstDomain().y );
 			_shaderPoints.setUniformValue( "ranges[1]", _colorMap->secondDomain().x, _colorMap->secondDomain().y );
 			_shaderPoints.setUniformValue( "colorSelected", _colorSelected.x, _colorSelected.y, _colorSelected.z, _colorSelected.w );
@@ -1782,7 +1791,8 @@ private:
 	bool _captureFrame = false;
 
 	ColorMap2D* _colorMap = nullptr;
-	std::pair<const Volume<float>*, const Volume<float>*> _volumes;
+	std::pair<VolumeView, VolumeView> _volumes;
+	std::pair<util::MemoryBudget::Pin, util::MemoryBudget::Pin> _volumePins;
 
 	std::unique_ptr<QOpenGLFramebufferObject> _framebuffer;
 	QOpenGLShaderProgram _shaderPoints, _shaderPolygon, _shaderBlend, _shaderColorMap, _shaderSelection;
@@ -1955,14 +1965,16 @@ private slots:
 		QObject::connect( _fitFirstDomain, &QPushButton::clicked, [=]
 		{
 			auto type = _firstVolume->volumeID();
-			const auto& volume = ( type.difference && _differenceEnsemble ) ? _ensemble->differenceVolume( type, *_differenceEnsemble ) : _ensemble->volume( type );
-			_firstDomain->setValues( volume.domain().x, volume.domain().y );
+			const auto volume = ( type.difference && _differenceEnsemble ) ? _ensemble->differenceVolume( type, *_differenceEnsemble ) : VolumeView( _ensemble->volume( type ) );
+			const auto domain = volume.domain();
+			_firstDomain->setValues( domain.x, domain.y );
 		} );
 		QObject::connect( _fitSecondDomain, &QPushButton::clicked, [=]
 		{
 			auto type = _secondVolume->volumeID();
-			const auto& volume = ( type.difference && _differenceEnsemble ) ? _ensemble->differenceVolume( type, *_differenceEnsemble ) : _ensemble->volume( type );
-			_secondDomain->setValues( volume.domain().x, volume.domain().y );
+			const auto volume = ( type.difference && _differenceEnsemble ) ? _ensemble->differenceVolume( type, *_differenceEnsemble ) : VolumeView( _ensemble->volume( type ) );
+			const auto domain = volume.domain();
+			_secondDomain->setValues( domain.x, domain.y );
 		} );
 		QObject::connect( _lightness, &NumberWidget::valueChanged, [=] ( double lightness ) { _colorMap2DEditor->colorMap()->setBackgrond( lightness ); } );
 	}
@@ -2152,7 +2164,7 @@ private slots:
 			_colorMap1DEditor->setColorMap( *colorMap );
 
 			const auto volume = this->volumeFromType( first );
-			if( volume ) this->updateDomain( first, volume->domain() );
+			if( volume ) this->updateDomain( first, volume.domain() );
 			_colorMap1DEditor->setVolume( volume );
 		}
 		else
@@ -2165,8 +2177,8 @@ private slots:
 			const auto firstVolume = this->volumeFromType( first );
 			const auto secondVolume = this->volumeFromType( second );
 
-			if( firstVolume ) this->updateDomain( first, firstVolume->domain() );
-			if( secondVolume ) this->updateDomain( second, secondVolume->domain() );
+			if( firstVolume ) this->updateDomain( first, firstVolume.domain() );
+			if( secondVolume ) this->updateDomain( second, secondVolume.domain() );
 			_colorMap2DEditor->setVolumes( firstVolume, secondVolume );
 
 			// Hide 1D color map
@@ -2251,14 +2263,14 @@ private:
 	}
 
 	// Return the relevant volume for a specified type
-	const Volume<float>* volumeFromType( const Ensemble::VolumeID& type )
+	VolumeView volumeFromType( const Ensemble::VolumeID& type )
 	{
 		if( type.difference )
 		{
-			if( _differenceEnsemble ) return &_ensemble->differenceVolume( type, *_differenceEnsemble );
-			else return nullptr;
+			if( _differenceEnsemble ) return _ensemble->differenceVolume( type, *_differenceEnsemble );
+			else return VolumeView();
 		}
-		else return &_ensemble->volume( type );
+		else return _ensemble->volume( type );
 	}
 
 	const Ensemble* _ensemble = nullptr;
@@ -0,0 +1,463 @@
+#pragma once
+#include "simd.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Lossless compression of float values: the bytes of the values are shuffled into planes (all first bytes, then all second bytes, ...), which groups the
+// similar sign and exponent bytes, and the planes are compressed with a byte-oriented LZ77 codec (similar to LZ4, no entropy coding to keep decoding fast).
+// Optionally, the values are quantized first (lossy) or members are coded as residuals against their mean, see Quantization and Encoding.
+namespace compression
+{
+	// Methods of compressed blocks (the first byte of every block), quantized blocks contain the parameters of the quantization and a block of the codes
+	enum class Method : uint8_t { eStored, eShuffledLZ, eHalf, eScaled16, eScaled8, eResiduals };
+
+	// Quantization of the values of a block, which reduces the size of the values by 2x (half-precision floats or 16-bit codes) or 4x (8-bit codes) before
+	// the lossless compression. Scaled codes map the range [minimum, maximum] of the block to equidistant steps. The error of every value is bounded by
+	//   eHalf:     relative error 2^-11 (absolute error 2^-25 for magnitudes below 2^-14)
+	//   eScaled16: absolute error ( maximum - minimum ) / 131070 of the block
+	//   eScaled8:  absolute error ( maximum - minimum ) / 510 of the block
+	// plus float rounding of the decoded value. Blocks with non-finite values (or magnitudes above 65504 for eHalf) are compressed losslessly instead.
+	// For an error bound e of the values, the derived statistics change by at most
+	//   minimum, maximum, mean, quartiles: e (the quartiles are estimated by quantile sketches, whose error adds to e)
+	//   standard deviation:                e (the standard deviation is 1-Lipschitz in the root mean square of the values)
+	//   gradient of the mean:              sqrt(3) * e per unit of distance (2 * sqrt(3) * e at the borders, which use one-sided differences)
+	//   z-scores (histograms, Anderson-Darling): about 2 * e / stddev, so histogram counts only change for values within this distance of a bin edge
+	//   Pearson correlation, field similarity and PCA: about 2 * e / stddev, amplified by the inverse eigengap of the covariance matrix for the PCA
+	// Statistics of voxels with a standard deviation that is not well above e are therefore unreliable with quantized members.
+	enum class Quantization : int32_t { eNone, eHalf, eScaled16, eScaled8 };
+
+	// Encoding of member-interleaved values ([voxel][member]): either quantized values or residuals against the mean of every voxel over the members. Members
+	// of ensembles are highly correlated, so the residuals are much smaller than the values. Lossless residuals are the differences of the values and the mean
+	// in units in the last place (the bits of floats ordered like integers), bounded residuals are multiples of a step below 2 * tolerance, which bounds the
+	// absolute error of every decoded value by the tolerance (the derived statistics change as for quantized values). Residuals can't be quantized.
+	struct Encoding
+	{
+		Quantization quantization = Quantization::eNone;
+		bool residuals = false;
+		float tolerance = 0.0f;
+
+		// Whether the values are encoded other than by the default lossless compression and whether the encoding is exact
+		bool encoded() const noexcept
+		{
+			return quantization != Quantization::eNone || residuals;
+		}
+		bool lossless() const noexcept
+		{
+			return residuals ? tolerance <= 0.0f : quantization == Quantization::eNone;
+		}
+
+		// Whether the encoding is valid (residuals aren't quantized, the tolerance is finite and not negative)
+		bool valid() const noexcept
+		{
+			return !( residuals && quantization != Quantization::eNone ) && std::isfinite( tolerance ) && tolerance >= 0.0f;
+		}
+
+		bool operator==( const Encoding& other ) const noexcept
+		{
+			return quantization == other.quantization && residuals == other.residuals && tolerance == other.tolerance;
+		}
+	};
+
+	// Parameters of the codec (minimum match length, maximum match distance and the size of the hash table)
+	constexpr size_t MinMatch = 4;
+	constexpr size_t MaxDistance = 65535;
+	constexpr int32_t HashBits = 12;
+
+	// Shuffle the bytes of 'count' elements of 'size' bytes into planes, or restore the elements from the planes
+	inline void shuffle( const uint8_t* source, uint8_t* destination, size_t count, size_t size ) noexcept
+	{
+		for( size_t i = 0; i < count; ++i )
+			for( size_t j = 0; j < size; ++j ) destination[j * count + i] = source[i * size + j];
+	}
+	inline void unshuffle( const uint8_t* source, uint8_t* destination, size_t count, size_t size ) noexcept
+	{
+		for( size_t j = 0; j < size; ++j )
+			for( size_t i = 0; i < count; ++i ) destination[i * size + j] = source[j * count + i];
+	}
+
+	// Compress bytes and append them to the destination. Every sequence consists of a token (literal length and match length in 4 bits each, longer
+	// lengths are continued in bytes of 255), the literals and the distance of the match (2 bytes). The last sequence only contains literals.
+	inline void lz_compress( const uint8_t* source, size_t size, std::vector<uint8_t>& destination )
+	{
+		const auto writeLength = [&destination] ( size_t length )
+		{
+			for( ; length >= 255; length -= 255 ) destination.push_back( 255 );
+			destination.push_back( static_cast<uint8_t>( length ) );
+		};
+		const auto writeSequence = [&] ( size_t literalBegin, size_t literalEnd, size_t distance, size_t matchLength )
+		{
+			const auto literalLength = literalEnd - literalBegin;
+			const auto matchCode = matchLength ? matchLength - MinMatch : 0;
+			destination.push_back( static_cast<uint8_t>( ( std::min<size_t>( literalLength, 15 ) << 4 ) | std::min<size_t>( matchCode, 15 ) ) );
+			if( literalLength >= 15 ) writeLength( literalLength - 15 );
+			destination.insert( destination.end(), source + literalBegin, source + literalEnd );
+			if( !matchLength ) return;
+
+			destination.push_back( static_cast<uint8_t>( distance ) );
+			destination.push_back( static_cast<uint8_t>( distance >> 8 ) );
+			if( matchCode >= 15 ) writeLength( matchCode - 15 );
+		};
+		const auto read = [source] ( size_t position )
+		{
+			auto value = uint32_t( 0 );
+			std::memcpy( &value, source + position, sizeof( value ) );
+			return value;
+		};
+
+		// Find matches using a hash table of the last positions of 4-byte sequences, incompressible regions are skipped with increasing steps
+		auto table = std::vector<int64_t>( size_t( 1 ) << HashBits, -1 );
+		auto anchor = size_t( 0 );
+		for( size_t position = 0; position + MinMatch <= size; )
+		{
+			const auto value = read( position );
+			auto& entry = table[( value * 2654435761u ) >> ( 32 - HashBits )];
+			const auto candidate = static_cast<size_t>( entry );
+			const auto valid = entry >= 0;
+			entry = static_cast<int64_t>( position );
+
+			if( valid && position - candidate <= MaxDistance && read( candidate ) == value )
+			{
+				auto length = MinMatch;
+				while( position + length < size && source[candidate + length] == source[position + length] ) ++length;
+				writeSequence( anchor, position, position - candidate, length );
+				anchor = position += length;
+			}
+			else position += 1 + ( ( position - anchor ) >> 6 );
+		}
+		writeSequence( anchor, size, 0, 0 );
+	}
+
+	// Decompress bytes that were compressed with lz_compress, 'size' has to be the exact decompressed size
+	inline void lz_decompress( const uint8_t* source, size_t bytes, uint8_t* destination, size_t size )
+	{
+		const auto end = source + bytes;
+		const auto readLength = [&source, end] ( size_t length )
+		{
+			if( length == 15 ) for( uint8_t byte = 255; byte == 255; length += byte )
+			{
+				if( source == end ) throw std::runtime_error( "compression::lz_decompress -> Data is corrupt." );
+				byte = *source++;
+			}
+			return length;
+		};
+
+		auto position = size_t( 0 );
+		while( source < end )
+		{
+			const auto token = *source++;
+			const auto literalLength = readLength( token >> 4 );
+			if( literalLength > static_cast<size_t>( end - source ) || literalLength > size - position ) throw std::runtime_error( "compression::lz_decompress -> Data is corrupt." );
+			std::memcpy( destination + position, source, literalLength );
+			source += literalLength;
+			position += literalLength;
+			if( source == end ) break;
+
+			// Matches may overlap with the bytes they produce, so they are copied byte by byte
+			if( end - source < 2 ) throw std::runtime_error( "compression::lz_decompress -> Data is corrupt." );
+			const auto distance = static_cast<size_t>( source[0] ) | ( static_cast<size_t>( source[1] ) << 8 );
+			source += 2;
+			const auto matchLength = readLength( token & 15 ) + MinMatch;
+			if( distance == 0 || distance > position || matchLength > size - position ) throw std::runtime_error( "compression::lz_decompress -> Data is corrupt." );
+			for( size_t i = 0; i < matchLength; ++i, ++position ) destination[position] = destination[position - distance];
+		}
+		if( position != size ) throw std::runtime_error( "compression::lz_decompress -> Data is corrupt." );
+	}
+
+	// Compress elements of 'size' bytes and append them to the block, elements that do not compress are stored instead
+	inline void compress_elements( const uint8_t* elements, size_t count, size_t size, std::vector<uint8_t>& block )
+	{
+		const auto bytes = count * size;
+		auto shuffled = std::vector<uint8_t>( bytes );
+		shuffle( elements, shuffled.data(), count, size );
+
+		const auto begin = block.size();
+		block.reserve( begin + bytes + 1 );
+		block.push_back( static_cast<uint8_t>( Method::eShuffledLZ ) );
+		lz_compress( shuffled.data(), bytes, block );
+		if( block.size() - begin - 1 <= bytes ) return;
+
+		block.resize( begin );
+		block.push_back( static_cast<uint8_t>( Method::eStored ) );
+		block.insert( block.end(), elements, elements + bytes );
+	}
+
+	// Decompress a block of 'count' elements of 'size' bytes
+	inline void decompress_elements( const uint8_t* block, size_t bytes, uint8_t* elements, size_t count, size_t size )
+	{
+		if( bytes == 0 ) throw std::runtime_error( "compression::decompress -> Block is empty." );
+
+		const auto method = static_cast<Method>( block[0] );
+		if( method == Method::eStored )
+		{
+			if( bytes - 1 != count * size ) throw std::runtime_error( "compression::decompress -> Size of the stored block doesn't match." );
+			std::memcpy( elements, block + 1, count * size );
+		}
+		else if( method == Method::eShuffledLZ )
+		{
+			thread_local auto shuffled = std::vector<uint8_t>();
+			shuffled.resize( count * size );
+			lz_decompress( block + 1, bytes - 1, shuffled.data(), count * size );
+			unshuffle( shuffled.data(), elements, count, size );
+		}
+		else throw std::runtime_error( "compression::decompress -> Unknown compression method." );
+	}
+
+	// Decode quantized values with SIMD, 'decode' converts vectors of codes (the remaining codes are decoded from a padded copy, so all values are decoded alike)
+	template<typename Code, typename Decode> void decode( const Code* codes, float* values, size_t count, Decode decode ) noexcept
+	{
+		auto i = size_t( 0 );
+		for( ; i + simd::Width <= count; i += simd::Width ) decode( codes + i ).store( values + i );
+		if( i == count ) return;
+
+		Code padded[simd::Width] = {};
+		float decoded[simd::Width];
+		std::copy( codes + i, codes + count, padded );
+		decode( padded ).store( decoded );
+		std::copy( decoded, decoded + ( count - i ), values + i );
+	}
+	inline void decode_half( const uint16_t* codes, float* values, size_t count ) noexcept
+	{
+		// Shift exponent and mantissa into place and rebias the exponent by multiplying with 2^112 (which also normalizes subnormal numbers), then restore the sign
+		decode( codes, values, count, [] ( const uint16_t* codes )
+		{
+			const auto half = simd::load_u16( codes );
+			const auto magnitude = simd::from_bits( simd::shift_left<13>( half & simd::broadcast( 0x7FFF ) ) ) * simd::floatv( 5.192296858534828e33f );
+			return simd::from_bits( simd::bits( magnitude ) | simd::shift_left<16>( half & simd::broadcast( 0x8000 ) ) );
+		} );
+	}
+	template<typename Code> void decode_scaled( const Code* codes, float* values, size_t count, float minimum, float step ) noexcept
+	{
+		decode( codes, values, count, [minimum, step] ( const Code* codes )
+		{
+			if constexpr( sizeof( Code ) == 1 ) return simd::fma( simd::convert( simd::load_u8( codes ) ), step, minimum );
+			else return simd::fma( simd::convert( simd::load_u16( codes ) ), step, minimum );
+		} );
+	}
+
+	// Compress float values into a block, values that do not compress are stored instead
+	inline std::vector<uint8_t> compress( const float* values, size_t count )
+	{
+		auto block = std::vector<uint8_t>();
+		compress_elements( reinterpret_cast<const uint8_t*>( values ), count, sizeof( float ), block );
+		return block;
+	}
+
+	// Quantize float values and compress the codes into a block (see Quantization)
+	inline std::vector<uint8_t> compress( const float* values, size_t count, Quantization quantization )
+	{
+		auto minimum = std::numeric_limits<float>::infinity();
+		auto maximum = -std::numeric_limits<float>::infinity();
+		auto finite = true;
+		for( size_t i = 0; i < count; ++i )
+		{
+			finite &= std::isfinite( values[i] );
+			minimum = std::min( minimum, values[i] );
+			maximum = std::max( maximum, values[i] );
+		}
+		if( quantization == Quantization::eNone || !finite || !count ) return compress( values, count );
+
+		auto block = std::vector<uint8_t>();
+		if( quantization == Quantization::eHalf )
+		{
+			if( std::max( -minimum, maximum ) > 65504.0f ) return compress( values, count );
+
+			auto codes = std::vector<uint16_t>( count );
+			for( size_t i = 0; i < count; ++i ) codes[i] = util::float_to_half( values[i] );
+			block.push_back( static_cast<uint8_t>( Method::eHalf ) );
+			compress_elements( reinterpret_cast<const uint8_t*>( codes.data() ), count, sizeof( uint16_t ), block );
+			return block;
+		}
+
+		// Scaled codes store the minimum and the step as parameters (a step of zero for constant blocks)
+		const auto levels = quantization == Quantization::eScaled16 ? 65535.0 : 255.0;
+		const auto step = static_cast<float>( ( static_cast<double>( maximum ) - minimum ) / levels );
+		const auto quantize = [&] ( float value )
+		{
+			return step > 0.0f ? std::clamp( std::nearbyint( ( static_cast<double>( value ) - minimum ) / step ), 0.0, levels ) : 0.0;
+		};
+
+		block.push_back( static_cast<uint8_t>( quantization == Quantization::eScaled16 ? Method::eScaled16 : Method::eScaled8 ) );
+		block.insert( block.end(), reinterpret_cast<const uint8_t*>( &minimum ), reinterpret_cast<const uint8_t*>( &minimum ) + sizeof( float ) );
+		block.insert( block.end(), reinterpret_cast<const uint8_t*>( &step ), reinterpret_cast<const uint8_t*>( &step ) + sizeof( float ) );
+		if( quantization == Quantization::eScaled16 )
+		{
+			auto codes = std::vector<uint16_t>( count );
+			for( size_t i = 0; i < count; ++i ) codes[i] = static_cast<uint16_t>( quantize( values[i] ) );
+			compress_elements( reinterpret_cast<const uint8_t*>( codes.data() ), count, sizeof( uint16_t ), block );
+		}
+		else
+		{
+			auto codes = std::vector<uint8_t>( count );
+			for( size_t i = 0; i < count; ++i ) codes[i] = static_cast<uint8_t>( quantize( values[i] ) );
+			compress_elements( codes.data(), count, sizeof( uint8_t ), block );
+		}
+		return block;
+	}
+
+	// Map the bits of floats to integers with the same order and back (negative floats are ordered reversely by their bits), differences of the integers
+	// are distances in units in the last place. Residuals are stored in zigzag order (0, -1, 1, -2, ...), so small residuals have zero high bytes.
+	inline uint32_t ordered_bits( float value ) noexcept
+	{
+		auto bits = uint32_t( 0 );
+		std::memcpy( &bits, &value, sizeof( bits ) );
+		return bits & 0x80000000u ? bits ^ 0x7FFFFFFFu : bits;
+	}
+	inline float from_ordered_bits( uint32_t bits ) noexcept
+	{
+		bits = bits & 0x80000000u ? bits ^ 0x7FFFFFFFu : bits;
+		auto value = 0.0f;
+		std::memcpy( &value, &bits, sizeof( value ) );
+		return value;
+	}
+	inline uint32_t zigzag( uint32_t residual ) noexcept
+	{
+		return ( residual << 1 ) ^ ( 0u - ( residual >> 31 ) );
+	}
+	inline uint32_t unzigzag( uint32_t code ) noexcept
+	{
+		return ( code >> 1 ) ^ ( 0u - ( code & 1 ) );
+	}
+
+	// Compress member-interleaved values ([voxel][member]) as residuals against the mean of every voxel. The block contains the member count, the step of
+	// bounded residuals (zero for lossless residuals), the size of the compressed means, the means and the residuals (both compressed losslessly).
+	inline std::vector<uint8_t> compress_residuals( const float* values, size_t voxelCount, uint32_t memberCount, float tolerance )
+	{
+		const auto count = voxelCount * memberCount;
+		auto means = std::vector<float>( voxelCount );
+		auto finite = true;
+		for( size_t i = 0; i < voxelCount; ++i )
+		{
+			auto sum = 0.0;
+			for( size_t j = 0; j < memberCount; ++j ) sum += values[i * memberCount + j];
+			means[i] = static_cast<float>( sum / memberCount );
+			finite &= std::isfinite( means[i] );
+		}
+
+		// Values are decoded as mean + code * step in float, which rounds the product and the sum by at most an ulp of twice the magnitude (plus the
+		// tolerance). The step leaves room for this rounding, so every value stays within the tolerance, and codes are limited to 2^24 (exact in float).
+		// Bounded residuals require finite values and a tolerance above the rounding, otherwise the residuals are stored losslessly.
+		auto magnitude = 0.0f;
+		for( size_t i = 0; i < count; ++i ) magnitude = std::max( magnitude, std::abs( values[i] ) );
+		const auto limit = 2.0f * ( magnitude + tolerance );
+		const auto rounding = std::nextafter( limit, std::numeric_limits<float>::infinity() ) - limit;
+		auto step = finite && std::isfinite( limit ) && tolerance > rounding ? 2.0f * ( tolerance - rounding ) : 0.0f;
+		while( step > 0.0f && 0.5 * step + rounding > tolerance ) step = std::nextafter( step, 0.0f );
+
+		auto codes = std::vector<uint32_t>( count );
+		for( size_t i = 0; i < count && step > 0.0f; ++i )
+		{
+			const auto code = std::nearbyint( ( static_cast<double>( values[i] ) - means[i / memberCount] ) / step );
+			if( std::abs( code ) <= 16777216.0 ) codes[i] = zigzag( static_cast<uint32_t>( static_cast<int32_t>( code ) ) );
+			else step = 0.0f;
+		}
+		if( step == 0.0f ) for( size_t i = 0; i < count; ++i ) codes[i] = zigzag( ordered_bits( values[i] ) - ordered_bits( means[i / memberCount] ) );
+
+		auto block = std::vector<uint8_t>( 1, static_cast<uint8_t>( Method::eResiduals ) );
+		block.insert( block.end(), reinterpret_cast<const uint8_t*>( &memberCount ), reinterpret_cast<const uint8_t*>( &memberCount ) + sizeof( uint32_t ) );
+		block.insert( block.end(), reinterpret_cast<const uint8_t*>( &step ), reinterpret_cast<const uint8_t*>( &step ) + sizeof( float ) );
+		const auto sizeOffset = block.size();
+		block.resize( block.size() + sizeof( uint64_t ) );
+		compress_elements( reinterpret_cast<const uint8_t*>( means.data() ), voxelCount, sizeof( float ), block );
+		const auto meansBytes = static_cast<uint64_t>( block.size() - sizeOffset - sizeof( uint64_t ) );
+		std::memcpy( block.data() + sizeOffset, &meansBytes, sizeof( uint64_t ) );
+		compress_elements( reinterpret_cast<const uint8_t*>( codes.data() ), count, sizeof( uint32_t ), block );
+		return block;
+	}
+
+	// Decompress a block of residuals into 'count' member-interleaved values
+	inline void decompress_residuals( const uint8_t* block, size_t bytes, float* values, size_t count )
+	{
+		constexpr auto HeaderSize = 1 + sizeof( uint32_t ) + sizeof( float ) + sizeof( uint64_t );
+		if( bytes < HeaderSize ) throw std::runtime_error( "compression::decompress -> Block is truncated." );
+		auto memberCount = uint32_t( 0 );
+		auto step = 0.0f;
+		auto meansBytes = uint64_t( 0 );
+		std::memcpy( &memberCount, block + 1, sizeof( uint32_t ) );
+		std::memcpy( &step, block + 1 + sizeof( uint32_t ), sizeof( float ) );
+		std::memcpy( &meansBytes, block + 1 + sizeof( uint32_t ) + sizeof( float ), sizeof( uint64_t ) );
+		if( memberCount == 0 || count % memberCount || meansBytes > bytes - HeaderSize ) throw std::runtime_error( "compression::decompress -> Block is corrupt." );
+
+		const auto voxelCount = count / memberCount;
+		thread_local auto means = std::vector<float>();
+		thread_local auto codes = std::vector<uint32_t>();
+		means.resize( voxelCount );
+		codes.resize( count );
+		decompress_elements( block + HeaderSize, meansBytes, reinterpret_cast<uint8_t*>( means.data() ), voxelCount, sizeof( float ) );
+		decompress_elements( block + HeaderSize + meansBytes, bytes - HeaderSize - meansBytes, reinterpret_cast<uint8_t*>( codes.data() ), count, sizeof( uint32_t ) );
+
+		// The loops over the members of a voxel are simple enough to be vectorized by the compiler
+		for( size_t i = 0; i < voxelCount; ++i )
+		{
+			const auto mean = means[i];
+			const auto source = codes.data() + i * memberCount;
+			const auto destination = values + i * memberCount;
+			if( step > 0.0f ) for( size_t j = 0; j < memberCount; ++j ) destination[j] = mean + static_cast<float>( static_cast<int32_t>( unzigzag( source[j] ) ) ) * step;
+			else
+			{
+				const auto reference = ordered_bits( mean );
+				for( size_t j = 0; j < memberCount; ++j ) destination[j] = from_ordered_bits( reference + unzigzag( source[j] ) );
+			}
+		}
+	}
+
+	// Compress member-interleaved values with an encoding
+	inline std::vector<uint8_t> compress( const float* values, size_t voxelCount, uint32_t memberCount, const Encoding& encoding )
+	{
+		if( !encoding.valid() ) throw std::invalid_argument( "compression::compress( const float*, size_t, uint32_t, const Encoding& ) -> Invalid encoding." );
+		if( !encoding.residuals ) return compress( values, voxelCount * memberCount, encoding.quantization );
+
+		// Lossless residuals only pay off for correlated members, otherwise the values are compressed directly
+		auto block = compress_residuals( values, voxelCount, memberCount, encoding.tolerance );
+		if( encoding.tolerance <= 0.0f ) if( auto direct = compress( values, voxelCount * memberCount ); direct.size() < block.size() ) return direct;
+		return block;
+	}
+
+	// Decompress a block into 'count' float values (quantized blocks are decoded with SIMD)
+	inline void decompress( const uint8_t* block, size_t bytes, float* values, size_t count )
+	{
+		if( bytes == 0 ) throw std::runtime_error( "compression::decompress -> Block is empty." );
+
+		const auto method = static_cast<Method>( block[0] );
+		if( method == Method::eStored || method == Method::eShuffledLZ ) decompress_elements( block, bytes, reinterpret_cast<uint8_t*>( values ), count, sizeof( float ) );
+		else if( method == Method::eHalf )
+		{
+			thread_local auto codes = std::vector<uint16_t>();
+			codes.resize( count );
+			decompress_elements( block + 1, bytes - 1, reinterpret_cast<uint8_t*>( codes.data() ), count, sizeof( uint16_t ) );
+			decode_half( codes.data(), values, count );
+		}
+		else if( method == Method::eScaled16 || method == Method::eScaled8 )
+		{
+			if( bytes < 1 + 2 * sizeof( float ) ) throw std::runtime_error( "compression::decompress -> Block is truncated." );
+			auto minimum = 0.0f, step = 0.0f;
+			std::memcpy( &minimum, block + 1, sizeof( float ) );
+			std::memcpy( &step, block + 1 + sizeof( float ), sizeof( float ) );
+
+			const auto codes = block + 1 + 2 * sizeof( float );
+			const auto codesBytes = bytes - 1 - 2 * sizeof( float );
+			if( method == Method::eScaled16 )
+			{
+				thread_local auto codes16 = std::vector<uint16_t>();
+				codes16.resize( count );
+				decompress_elements( codes, codesBytes, reinterpret_cast<uint8_t*>( codes16.data() ), count, sizeof( uint16_t ) );
+				decode_scaled( codes16.data(), values, count, minimum, step );
+			}
+			else
+			{
+				thread_local auto codes8 = std::vector<uint8_t>();
+				codes8.resize( count );
+				decompress_elements( codes, codesBytes, codes8.data(), count, sizeof( uint8_t ) );
+				decode_scaled( codes8.data(), values, count, minimum, step );
+			}
+		}
+		else if( method == Method::eResiduals ) decompress_residuals( block, bytes, values, count );
+		else throw std::runtime_error( "compression::decompress -> Unknown compression method." );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+#pragma once
+#include "fingerprint.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace util
+{
+	// Persistent cache of derived data in a directory, entries are identified by 64-bit keys that hash the content of the inputs (see fingerprint.hpp), the
+	// parameters and the version of the algorithm, so entries never have to be invalidated. Every entry is a file with a header (magic, version, key and the
+	// hash of the payload) that is written to a temporary file and renamed, so concurrent processes only see complete entries. Reading an entry updates its
+	// modification time and the least recently used entries are removed when the size of the directory exceeds the limit. The cache is disabled by default,
+	// errors (e.g. a full disk) only disable single entries, since all data can be recomputed.
+	class DiskCache
+	{
+	public:
+		// Header of the cache entries
+		struct Header
+		{
+			char magic[8] = { 'R', 'H', 'V', 'C', 'A', 'C', 'H', 'E' };
+			uint32_t version = 1;
+			uint32_t reserved = 0;
+			uint64_t key = 0;
+			uint64_t hash = 0;
+		};
+
+		// Setter and getter for the directory (an empty path disables the cache)
+		void setDirectory( std::filesystem::path directory )
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			_directory = std::move( directory );
+		}
+		std::filesystem::path directory() const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			return _directory;
+		}
+		bool enabled() const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			return !_directory.empty();
+		}
+
+		// Setter and getter for the size limit of all entries in bytes (4 GiB by default)
+		void setLimit( uint64_t bytes )
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			_limit = bytes;
+		}
+		uint64_t limit() const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			return _limit;
+		}
+
+		// Read an entry, returns false if the entry doesn't exist or is invalid (invalid entries are removed, exceptions of 'read' count as invalid)
+		bool load( uint64_t key, const std::function<void( std::istream& )>& read )
+		{
+			const auto filepath = this->filepath( key );
+			if( filepath.empty() ) return false;
+
+			auto payload = std::string();
+			try
+			{
+				auto file = std::ifstream( filepath, std::ios::in | std::ios::binary );
+				if( !file ) return false;
+
+				auto header = util::read_binary<Header>( file );
+				if( !file || std::string( header.magic, 8 ) != std::string( Header().magic, 8 ) || header.version != Header().version || header.key != key )
+					throw std::runtime_error( "Invalid header" );
+				payload.assign( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+				if( fingerprint::compute( payload.data(), payload.size() ) != header.hash ) throw std::runtime_error( "Invalid payload" );
+
+				auto stream = std::istringstream( std::move( payload ) );
+				read( stream );
+				if( !stream ) throw std::runtime_error( "Truncated payload" );
+			}
+			catch( const std::exception& exception )
+			{
+				std::cout << "Removing invalid cache entry " << filepath.string() << " (" << exception.what() << ")." << std::endl;
+				auto error = std::error_code();
+				std::filesystem::remove( filepath, error );
+				return false;
+			}
+
+			// Mark the entry as recently used
+			auto error = std::error_code();
+			std::filesystem::last_write_time( filepath, std::filesystem::file_time_type::clock::now(), error );
+			return true;
+		}
+
+		// Write an entry (replacing an existing one) and remove the least recently used entries if the limit is exceeded
+		void store( uint64_t key, const std::function<void( std::ostream& )>& write )
+		{
+			const auto filepath = this->filepath( key );
+			if( filepath.empty() ) return;
+
+			auto stream = std::ostringstream( std::ios::out | std::ios::binary );
+			write( stream );
+			const auto payload = stream.str();
+			if( payload.size() + sizeof( Header ) > this->limit() ) return;
+
+			auto header = Header();
+			header.key = key;
+			header.hash = fingerprint::compute( payload.data(), payload.size() );
+
+			// Write a temporary file with a random name (unique across threads and processes), then replace the entry
+			auto error = std::error_code();
+			auto random = std::random_device();
+			const auto temporary = std::filesystem::path( filepath ).concat( "." + std::to_string( ( uint64_t( random() ) << 32 ) | random() ) + ".tmp" );
+			std::filesystem::create_directories( filepath.parent_path(), error );
+			{
+				auto file = std::ofstream( temporary, std::ios::out | std::ios::binary | std::ios::trunc );
+				util::write_binary( file, header );
+				file.write( payload.data(), payload.size() );
+				if( !file ) error = std::make_error_code( std::errc::io_error );
+			}
+			if( !error ) std::filesystem::rename( temporary, filepath, error );
+			if( error )
+			{
+				std::cout << "Failed to write cache entry " << filepath.string() << " (" << error.message() << ")." << std::endl;
+				std::filesystem::remove( temporary, error );
+				return;
+			}
+
+			this->evict();
+		}
+
+		// Return the total size of all entries in bytes
+		uint64_t size() const
+		{
+			auto size = uint64_t( 0 );
+			for( const auto& entry : this->entries() ) size += entry.bytes;
+			return size;
+		}
+
+		// Remove all entries
+		void clear()
+		{
+			auto error = std::error_code();
+			for( const auto& entry : this->entries() ) std::filesystem::remove( entry.filepath, error );
+		}
+
+	private:
+		// Entry of the cache directory
+		struct Entry
+		{
+			std::filesystem::path filepath;
+			uint64_t bytes = 0;
+			std::filesystem::file_time_type time;
+		};
+
+		// Return the file of an entry (empty if the cache is disabled)
+		std::filesystem::path filepath( uint64_t key ) const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			if( _directory.empty() ) return {};
+
+			char name[17] = {};
+			std::snprintf( name, sizeof( name ), "%016llx", static_cast<unsigned long long>( key ) );
+			return _directory / ( std::string( name ) + ".cache" );
+		}
+
+		// Return all entries of the cache directory (temporary files of unfinished entries are ignored)
+		std::vector<Entry> entries() const
+		{
+			auto entries = std::vector<Entry>();
+			const auto directory = this->directory();
+			auto error = std::error_code();
+			if( directory.empty() || !std::filesystem::is_directory( directory, error ) ) return entries;
+
+			for( auto it = std::filesystem::directory_iterator( directory, error ); !error && it != std::filesystem::directory_iterator(); it.increment( error ) )
+			{
+				if( it->path().extension() != ".cache" ) continue;
+				auto entry = Entry { it->path(), it->file_size( error ), it->last_write_time( error ) };
+				if( !error ) entries.push_back( std::move( entry ) );
+				error.clear();
+			}
+			return entries;
+		}
+
+		// Remove the least recently used entries until the size of all entries is within the limit (concurrent evictions are serialized)
+		void evict()
+		{
+			const auto lock = std::scoped_lock( _evictionMutex );
+			auto entries = this->entries();
+			auto size = uint64_t( 0 );
+			for( const auto& entry : entries ) size += entry.bytes;
+
+			const auto limit = this->limit();
+			if( size <= limit ) return;
+			std::sort( entries.begin(), entries.end(), [] ( const Entry& a, const Entry& b ) { return a.time < b.time; } );
+			for( const auto& entry : entries )
+			{
+				if( size <= limit ) break;
+				auto error = std::error_code();
+				if( std::filesystem::remove( entry.filepath, error ) ) size -= entry.bytes;
+			}
+		}
+
+		mutable std::mutex _mutex;
+		std::mutex _evictionMutex;
+		std::filesystem::path _directory;
+		uint64_t _limit = uint64_t( 4 ) << 30;
+	};
+
+	// Return the global disk cache
+	inline DiskCache& disk_cache()
+	{
+		static auto cache = DiskCache();
+		return cache;
+	}
+}
\ No newline at end of file
@@ -1,13 +1,19 @@
 #include "ensemble.hpp"
+#include "disk_cache.hpp"
 #include "region.hpp"
+#include "stencil.hpp"
+
+#ifdef REGHIEVIS_HDF5
+#include "hdf5_file.hpp"
+#endif
 
 #include <Eigen/Eigen>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <random>
-
-#include <json.hpp>
+#include <sstream>
 
 Ensemble Ensemble::createSubEnsemble( const std::vector<int32_t>& volumes ) const
 {
@@ -39,16 +45,32 @@ void Ensemble::loadRFA()
 	_fields.push_back( Field( "Value" ) );
 	_fields.back().loadRFA();
 
-	// Read labels
-	auto istream = std::ifstream( "../../../Datasets/labels.data" );
-	auto labels = std::vector<int32_t>( this->voxelCount() );
-	for( int32_t i = 0; i < this->voxelCount(); ++i ) istream >> labels[i];
-	istream.close();
-	_volumeLabels.reset( new Volume<int32_t>( this->dimensions(), std::move( labels ), "Label" ) );
+	// Read labels (the text file is converted to a binary file with a shape header once, through a temporary file like the members)
+	const auto filepath = std::filesystem::path( "../../../Datasets/labels.bin" );
+	if( !std::filesystem::exists( filepath ) )
+	{
+		const auto labels = util::read_text_values<int32_t>( "../../../Datasets/labels.data" );
+		if( labels.size() != this->voxelCount() ) throw std::runtime_error( "Ensemble::loadRFA -> Number of labels doesn't match the dimensions." );
+
+		const uint32_t dimensions[3] = { static_cast<uint32_t>( this->dimensions().x ), static_cast<uint32_t>( this->dimensions().y ), static_cast<uint32_t>( this->dimensions().z ) };
+		util::write_file( filepath, [&] ( std::ostream& stream )
+		{
+			stream.write( reinterpret_cast<const char*>( dimensions ), sizeof( dimensions ) );
+			stream.write( reinterpret_cast<const char*>( labels.data() ), labels.size() * sizeof( int32_t ) );
+		} );
+	}
+	auto istream = std::ifstream( filepath, std::ios::in | std::ios::binary );
+	uint32_t shape[3] = {};
+	istream.read( reinterpret_cast<char*>( shape ), sizeof( shape ) );
+	if( vec3i( shape[0], shape[1], shape[2] ) != this->dimensions() ) throw std::runtime_error( "Ensemble::loadRFA -> Dimensions of the labels don't match the field." );
+
+	_volumeLabels.reset( new Volume<int32_t>( this->dimensions(), "Label" ) );
+	util::read_parallel( filepath, { util::FileRange { sizeof( shape ), static_cast<uint64_t>( this->voxelCount() ) * sizeof( int32_t ), _volumeLabels->data() } } );
 
 	// Fill available volumes
-	for( const auto& [type, volume] : _fields.back().derivedVolumes() )
-		_availableVolumes.insert( VolumeID( 0, type ) );
+	_fields.back().derivedVolumes().forEach( [this] ( Derived type, const Volume<float>& ) { _availableVolumes.insert( VolumeID( 0, type ) ); } );
+	for( int32_t bin = 0; bin < _fields.back().histogramBinCount(); ++bin )
+		_availableVolumes.insert( VolumeID::histogram( 0, bin ) );
 	_availableVolumes.insert( VolumeID( -1, Ensemble::Derived::eLabel ) );
 
 	std::cout << "Finished loading 'RFA' with members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
@@ -66,8 +88,9 @@ void Ensemble::loadTeardrop()
 	_volumeLabels->expandDomain( vec2i( 0, 1 ) );
 
 	// Fill available volumes
-	for( const auto& [type, volume] : _fields.back().derivedVolumes() )
-		_availableVolumes.insert( VolumeID( 0, type ) );
+	_fields.back().derivedVolumes().forEach( [this] ( Derived type, const Volume<float>& ) { _availableVolumes.insert( VolumeID( 0, type ) ); } );
+	for( int32_t bin = 0; bin < _fields.back().histogramBinCount(); ++bin )
+		_availableVolumes.insert( VolumeID::histogram( 0, bin ) );
 	_availableVolumes.insert( VolumeID( -1, Ensemble::Derived::eLabel ) );
 
 	std::cout << "Finished loading 'teardrop' with members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
@@ -85,8 +108,9 @@ void Ensemble::loadTangle()
 	_volumeLabels->expandDomain( vec2i( 0, 1 ) );
 
 	// Fill available volumes
-	for( const auto& [type, volume] : _fields.back().derivedVolumes() )
-		_availableVolumes.insert( VolumeID( 0, type ) );
+	_fields.back().derivedVolumes().forEach( [this] ( Derived type, const Volume<float>& ) { _availableVolumes.insert( VolumeID( 0, type ) ); } );
+	for( int32_t bin = 0; bin < _fields.back().histogramBinCount(); ++bin )
+		_availableVolumes.insert( VolumeID::histogram( 0, bin ) );
 	_availableVolumes.insert( VolumeID( -1, Ensemble::Derived::eLabel ) );
 
 	std::cout << "Finished loading 'teardrop' with members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
@@ -104,12 +128,61 @@ void Ensemble::loadSpheres()
 	_volumeLabels->expandDomain( vec2i( 0, 1 ) );
 
 	// Fill available volumes
-	for( const auto& [type, volume] : _fields.back().derivedVolumes() )
-		_availableVolumes.insert( VolumeID( 0, type ) );
+	_fields.back().derivedVolumes().forEach( [this] ( Derived type, const Volume<float>& ) { _availableVolumes.insert( VolumeID( 0, type ) ); } );
+	for( int32_t bin = 0; bin < _fields.back().histogramBinCount(); ++bin )
+		_availableVolumes.insert( VolumeID::histogram( 0, bin ) );
 	_availableVolumes.insert( VolumeID( -1, Ensemble::Derived::eLabel ) );
 
 	std::cout << "Finished loading 'spheres' with members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
 }
+void Ensemble::loadHDF5( const std::filesystem::path& directory, std::vector<std::pair<QString, QString>> fields )
+{
+#ifdef REGHIEVIS_HDF5
+	auto timer = util::timer();
+
+	// --- Open the files of the members (sorted, so the order of the members is deterministic) --- //
+	auto paths = std::vector<std::filesystem::path>();
+	for( const auto& it : std::filesystem::directory_iterator( directory ) ) if( it.is_regular_file() && HDF5File::isHDF5( it.path() ) ) paths.push_back( it.path() );
+	std::sort( paths.begin(), paths.end() );
+	if( paths.empty() ) throw std::runtime_error( "Ensemble::loadHDF5 -> No HDF5 files found in directory " + directory.string() );
+
+	auto files = std::vector<std::unique_ptr<HDF5File>>( paths.size() );
+	for( size_t i = 0; i < paths.size(); ++i ) files[i] = std::make_unique<HDF5File>( paths[i] );
+
+	// --- The datasets of the first file are the variables of the expressions, without fields every dataset is imported --- //
+	auto datasets = std::vector<QString>();
+	for( const auto& name : files.front()->datasets() ) datasets.push_back( QString::fromStdString( name ) );
+	if( fields.empty() ) for( const auto& dataset : datasets ) fields.emplace_back( dataset, "\"" + dataset + "\"" );
+	if( fields.empty() ) throw std::runtime_error( "Ensemble::loadHDF5 -> File " + paths.front().string() + " doesn't contain three-dimensional datasets." );
+
+	// --- Stream the fields from the files --- //
+	_fields = std::vector<Field>( fields.size() );
+	for( size_t i = 0; i < fields.size(); ++i )
+	{
+		_fields[i].setName( fields[i].first );
+		_fields[i].loadHDF5( files, datasets, Expression( fields[i].second, datasets ) );
+		if( _fields[i].dimensions() != this->dimensions() ) throw std::runtime_error( "Ensemble::loadHDF5 -> Dimensions of field " + fields[i].first.toStdString() + " don't match the other fields." );
+	}
+
+	// --- No labels --- //
+	_volumeLabels.reset( new Volume<int32_t>( this->dimensions(), "Label" ) );
+	_volumeLabels->expandDomain( vec2i( 0, 1 ) );
+
+	// --- Add available volumes (derived volumes are computed on first access) --- //
+	for( int32_t i = 0; i < this->fieldCount(); ++i )
+	{
+		for( const auto type : { Derived::eMinimum, Derived::eMaximum, Derived::eMean, Derived::eStddev, Derived::eGradientMagnitude, Derived::ePCA1, Derived::ePCA2, Derived::eHistDeviation, Derived::eAndersonDarling } )
+			_availableVolumes.insert( VolumeID( i, type ) );
+		for( int32_t bin = 0; bin < _fields[i].histogramBinCount(); ++bin )
+			_availableVolumes.insert( VolumeID::histogram( i, bin ) );
+	}
+	_availableVolumes.insert( VolumeID( -1, Ensemble::Derived::eLabel ) );
+
+	std::cout << "Finished importing " << directory << " with fields = " << this->fieldCount() << ", members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
+#else
+	throw std::runtime_error( "Ensemble::loadHDF5 -> HDF5 files are not supported, build with REGHIEVIS_HDF5 to import them." );
+#endif
+}
 
 void Ensemble::load( std::filesystem::path filepath, bool computeDerivedVolumes )
 {
@@ -119,15 +192,35 @@ void Ensemble::load( std::filesystem::path filepath, bool computeDerivedVolumes
 	auto stream = std::ifstream( _filepath = std::move( filepath ), std::ios::in | std::ios::binary );
 	if( !stream ) throw std::runtime_error( "Ensemble::load( std::filesystem::path ) -> Failed to open ensemble " + _filepath.string() );
 
+	// --- Check the file format, files of version 2 and newer are mapped and the stream reads their directory --- //
+	auto& file = _file;
+	auto& header = _fileHeader;
+	if( stream.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) && std::equal( header.magic, header.magic + sizeof( header.magic ), FileMagic ) )
+	{
+		if( header.version > FileVersion ) throw std::runtime_error( "Ensemble::load( std::filesystem::path ) -> Unsupported file version " + std::to_string( header.version ) + " of ensemble " + _filepath.string() );
+		file = std::make_shared<MappedFile>( _filepath );
+
+		// The header is read again from the mapping, as the file might have been updated before it was locked (see MappedFile::ExclusiveLock)
+		std::memcpy( &header, file->data<const char>( 0, sizeof( header ) ), sizeof( header ) );
+		if( header.version > FileVersion ) throw std::runtime_error( "Ensemble::load( std::filesystem::path ) -> Unsupported file version " + std::to_string( header.version ) + " of ensemble " + _filepath.string() );
+		stream.seekg( header.directoryOffset );
+	}
+	else
+	{
+		header = FileHeader();
+		stream.clear();
+		stream.seekg( 0 );
+	}
+
 	// --- Read label volume --- //
-	_volumeLabels.reset( new Volume<int32_t>( stream ) );
+	_volumeLabels.reset( new Volume<int32_t>( stream, file ) );
 
 	// --- Read derived volumes (on ensemble level) --- //
 	const auto derivedVolumeCount = util::read_binary<size_t>( stream );
 	for( size_t i = 0; i < derivedVolumeCount; ++i )
 	{
 		const auto key = util::read_binary<Derived>( stream );
-		_derivedVolumes[key] = Volume<float>( stream );
+		_derivedVolumes.set( key, Volume<float>( stream, file ) );
 	}
 
 	// --- Read fields and compute derived volumes if requested --- //
@@ -136,74 +229,180 @@ void Ensemble::load( std::filesystem::path filepath, bool computeDerivedVolumes
 	for( size_t i = 0; i < fieldCount; ++i )
 	{
 		auto& field = _fields[i];
-		field.load( stream );
+		field.load( stream, _filepath, file, header.version );
 
-		if( computeDerivedVolumes )
-		{
-			field.computeMinimumMaximum();
-			field.computeMeanStddev();
-			field.computeGradient();
-			field.computePrincipalComponents();
-			field.computeFieldSimilarity();
-			field.computePearsonSimilarity();
-			field.computeHistograms();
-			field.computeAndersonDarling();
-		}
+		if( computeDerivedVolumes ) field.computeDerivedVolumes();
 
-		// --- Add available volume from field --- //
-		for( const auto& [type, volume] : field.derivedVolumes() )
+		// --- Add available volume from field (volumes of the basic stages are computed on first access if they are missing in the file) --- //
+		field.derivedVolumes().forEach( [&] ( Derived type, const Volume<float>& ) { _availableVolumes.insert( VolumeID( i, type ) ); } );
+		for( const auto type : { Derived::eMinimum, Derived::eMaximum, Derived::eMean, Derived::eStddev, Derived::eGradientMagnitude, Derived::ePCA1, Derived::ePCA2, Derived::eHistDeviation, Derived::eAndersonDarling } )
 			_availableVolumes.insert( VolumeID( i, type ) );
+		for( int32_t bin = 0; bin < field.histogramBinCount(); ++bin )
+			_availableVolumes.insert( VolumeID::histogram( i, bin ) );
 	}
 
+	// --- Read the free ranges of the file (since version 4), they can be reused when the file is updated --- //
+	_freeRanges.clear();
+	_writtenRanges.clear();
+	if( header.version >= 4 ) util::read_binary_vector( stream, _freeRanges );
+	if( !stream ) throw std::runtime_error( "Ensemble::load( std::filesystem::path ) -> Failed to read ensemble " + _filepath.string() + ", the file is probably corrupt." );
+
 	// --- Add label volume to available volumes --- //
 	_availableVolumes.insert( VolumeID( -1, Ensemble::Derived::eLabel ) );
 
 	// --- Print status message --- //
 	std::cout << "Finished loading " << _filepath.filename() << " with fields = " << this->fieldCount() << ", members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
 }
-void Ensemble::save( std::filesystem::path filepath ) const
+void Ensemble::save( std::filesystem::path filepath )
 {
 	auto timer = util::timer();
+	this->applyRecomputedStages( true );
+
+	// --- Open file stream, the file of the ensemble is updated in place if possible. Otherwise, a temporary file replaces the file at the end, as the
+	// file might be mapped by this or another ensemble (data written by previous updates is kept where it is while it is unchanged). --- //
+	const auto update = filepath == _filepath && this->updatable();
+	const auto temporary = update ? filepath : std::filesystem::path( filepath ).concat( ".tmp" );
+	auto stream = std::fstream( temporary, update ? std::ios::in | std::ios::out | std::ios::binary : std::ios::out | std::ios::binary );
+	if( !stream ) throw std::runtime_error( "Ensemble::save( std::filesystem::path ) -> Failed to open file " + temporary.string() );
+
+	// --- Free ranges are only reused while no other mapping of the file exists (mappings of older generations might refer to them), new data is appended
+	// otherwise. While the lock is held, other ensembles wait with mapping the file until the update is complete. --- //
+	auto lock = std::optional<MappedFile::ExclusiveLock>();
+	if( update ) lock.emplace( *_file );
+
+	// --- Write the header of new files (with a random identifier), it is completed when the directory was written --- //
+	auto header = _fileHeader;
+	if( !update )
+	{
+		header = FileHeader();
+		std::copy( FileMagic, FileMagic + sizeof( header.magic ), header.magic );
+		header.version = FileVersion;
+		header.pageSize = MappedFile::PageSize;
+		auto generator = std::mt19937_64( std::random_device()( ) );
+		header.identifier = std::uniform_int_distribution<uint64_t>( 1 )( generator );
+		util::write_binary( stream, header );
+	}
+	auto data = update ? MappedFileWriter( stream, _file, std::filesystem::file_size( filepath ), _freeRanges, _writtenRanges, bool( *lock ) ) : MappedFileWriter( stream );
 
-	// --- Open file stream --- //
-	auto stream = std::ofstream( filepath, std::ios::out | std::ios::binary );
-
-	// --- Save label volume --- //
-	_volumeLabels->save( stream );
+	// --- Save label volume, the directory is collected in memory while the data is written page-aligned to the file --- //
+	auto directory = std::ostringstream( std::ios::out | std::ios::binary );
+	_volumeLabels->save( directory, &data );
 
 	// --- Save derived volumes (ensemble level) --- //
-	util::write_binary( stream, _derivedVolumes.size() );
-	for( const auto& [key, volume] : _derivedVolumes )
+	util::write_binary( directory, _derivedVolumes.size() );
+	_derivedVolumes.forEach( [&] ( Derived key, const Volume<float>& volume )
 	{
-		util::write_binary( stream, key );
-		volume.save( stream );
-	}
+		util::write_binary( directory, key );
+		volume.save( directory, &data );
+	} );
 
 	// --- Save fields --- //
-	util::write_binary( stream, _fields.size() );
-	for( const auto& field : _fields ) field.save( stream );
+	util::write_binary( directory, _fields.size() );
+	for( const auto& field : _fields ) field.save( directory, data );
+
+	// --- Append the free ranges and the directory, the header is written last (after the data reached the disk), so the previous directory stays valid
+	// until the update is complete --- //
+	const auto freeRanges = data.freeRanges();
+	util::write_binary_vector( directory, freeRanges );
+	const auto contents = directory.str();
+	header.directoryOffset = data.append( contents.data(), contents.size() );
+	header.directorySize = contents.size();
+	header.freeSize = 0;
+	for( const auto& range : freeRanges ) header.freeSize += range.bytes;
+	header.fingerprint = this->fingerprint();
+	if( update ) ++header.generation;
+	if( !stream.flush() ) throw std::runtime_error( "Ensemble::save( std::filesystem::path ) -> Failed to write file " + temporary.string() );
+	MappedFile::sync( temporary );
+	stream.seekp( 0 );
+	util::write_binary( stream, header );
+
+	stream.close();
+	if( !stream ) throw std::runtime_error( "Ensemble::save( std::filesystem::path ) -> Failed to write file " + temporary.string() );
+	MappedFile::sync( temporary );
+
+	// --- Ranges that were free when the file was mapped can still be reused. A replaced file of the ensemble is mapped again from the new file, the data
+	// that wrapped the previous file wraps the equal data of the new file (other ensembles that map the previous file keep it mapped). Mapped files can't be
+	// replaced on Windows, so the data is copied out of the file first there. --- //
+	if( update )
+	{
+		_fileHeader = header;
+		_freeRanges = data.reusableRanges();
+		_writtenRanges = data.writtenRanges();
+	}
+	else
+	{
+#ifdef _WIN32
+		if( filepath == _filepath && _file ) this->releaseFile();
+#endif
+		std::filesystem::rename( temporary, filepath );
+		if( filepath == _filepath && _file )
+		{
+			auto replacement = Ensemble();
+			replacement.load( filepath, false );
+			this->releaseFile( &replacement );
+		}
+		else if( filepath == _filepath ) _fileHeader = FileHeader();
+	}
 
 	// --- Print status message --- //
-	std::cout << "Finished saving " << filepath.filename() << " with fields = " << this->fieldCount() << ", members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
+	std::cout << "Finished " << ( update ? "updating " : "saving " ) << filepath.filename() << " with fields = " << this->fieldCount() << ", members = " << this->memberCount() << " and dimensions = " << this->dimensions() << " in " << timer.get() << " ms." << std::endl;
 }
 bool Ensemble::compare( const Ensemble& other ) const
 {
-	// --- Compare label volumes --- //
+	// --- Compare label volumes and derived volumes --- //
 	if( *_volumeLabels != *other._volumeLabels ) return false;
-	std::cout << "Ensemble::compare( const Ensemble& ) -> Labels equal." << std::endl;
-
-	// --- Compare derived volumes --- //
 	if( _derivedVolumes != other._derivedVolumes ) return false;
-	std::cout << "Ensemble::compare( const Ensemble& ) -> Derived volumes equal." << std::endl;
 
 	// --- Compare fields --- //
 	if( _fields.size() != other._fields.size() ) return false;
 	for( size_t i = 0; i < _fields.size(); ++i ) if( !_fields[i].compare( other._fields[i] ) ) return false;
-	std::cout << "Ensemble::compare( const Ensemble& ) -> Fields equal." << std::endl;
-
-	std::cout << "Ensemble::compare( const Ensemble& ) -> Ensembles equal." << std::endl;
 	return true;
 }
+uint64_t Ensemble::fingerprint() const
+{
+	auto hash = _volumeLabels ? _volumeLabels->fingerprint() : 0;
+	for( const auto& field : _fields ) hash = fingerprint::combine( hash, field.fingerprint() );
+	return hash;
+}
+
+bool Ensemble::updatable() const
+{
+	// Only mapped files of the current version are updated, files with more free space than data are rewritten to compact them
+	if( !_file || _fileHeader.version != FileVersion || _fileHeader.identifier == 0 ) return false;
+	if( _fileHeader.freeSize > std::filesystem::file_size( _filepath ) / 2 ) return false;
+
+	// The header of the file must not have changed since it was loaded or updated by this ensemble
+	auto stream = std::ifstream( _filepath, std::ios::in | std::ios::binary );
+	auto header = FileHeader();
+	return stream.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) && std::memcmp( &header, &_fileHeader, sizeof( header ) ) == 0;
+}
+void Ensemble::releaseFile( const Ensemble* replacement )
+{
+	const auto mapped = [this] ( const auto& volume ) { return _file->contains( volume.data(), static_cast<uint64_t>( volume.voxelCount() ) * sizeof( *volume.data() ) ); };
+	if( mapped( *_volumeLabels ) ) _volumeLabels->wrap( replacement ? replacement->_volumeLabels.get() : nullptr );
+	_derivedVolumes.forEach( [&] ( Derived key, const Volume<float>& volume )
+	{
+		if( mapped( volume ) ) const_cast<Volume<float>&>( volume ).wrap( replacement ? replacement->_derivedVolumes.find( key ) : nullptr );
+	} );
+	for( int32_t i = 0; i < _fields.size(); ++i ) _fields[i].releaseFile( *_file, replacement && i < replacement->_fields.size() ? &replacement->_fields[i] : nullptr );
+	this->updateVirtualFields( -1 );
+
+	// The ensemble maps the file of the replacement from now on (it is updated in place again)
+	_file = replacement ? replacement->_file : nullptr;
+	_fileHeader = replacement ? replacement->_fileHeader : FileHeader();
+	_freeRanges = replacement ? replacement->_freeRanges : std::vector<MappedFile::Range>();
+	_writtenRanges.clear();
+}
+void Ensemble::updateVirtualFields( int32_t field )
+{
+	// The inputs of a virtual field are the fields before it, so the fields are updated in order (virtual fields may be inputs of later ones)
+	auto inputs = std::vector<const Field*>();
+	for( int32_t i = 0; i < _fields.size(); ++i )
+	{
+		if( i > field && _fields[i].storage() == Field::Storage::eVirtual ) _fields[i].setInputs( inputs );
+		inputs.push_back( &_fields[i] );
+	}
+}
 
 int32_t Ensemble::fieldCount() const noexcept
 {
@@ -230,48 +429,100 @@ const Ensemble::Field& Ensemble::field( int32_t index ) const noexcept
 {
 	return _fields[index];
 }
+Ensemble::Field& Ensemble::field( int32_t index ) noexcept
+{
+	return _fields[index];
+}
+
+void Ensemble::setHistogramBinCount( int32_t binCount )
+{
+	for( int32_t i = 0; i < this->fieldCount(); ++i )
+	{
+		// Replace the available histogram bins of the field
+		for( int32_t bin = 0; bin < _fields[i].histogramBinCount(); ++bin )
+			_availableVolumes.erase( VolumeID::histogram( i, bin ) );
+		_fields[i].setHistogramBinCount( binCount );
+		for( int32_t bin = 0; bin < binCount; ++bin )
+			_availableVolumes.insert( VolumeID::histogram( i, bin ) );
+	}
+}
+void Ensemble::addField( QString name, const QString& expression )
+{
+	auto timer = util::timer();
+
+	// The names of the fields are the variables of the expression
+	auto names = std::vector<QString>( _fields.size() );
+	auto inputs = std::vector<const Field*>( _fields.size() );
+	for( size_t i = 0; i < _fields.size(); ++i )
+	{
+		names[i] = _fields[i].name();
+		inputs[i] = &_fields[i];
+	}
+	auto field = Field( name, inputs, Expression( expression, names ) );
+	field.computeDerivedVolumes();
+	_fields.push_back( std::move( field ) );
+
+	// Add available volumes of the new field
+	const auto index = static_cast<int32_t>( _fields.size() ) - 1;
+	_fields.back().derivedVolumes().forEach( [&] ( Derived type, const Volume<float>& ) { _availableVolumes.insert( VolumeID( index, type ) ); } );
+	for( int32_t bin = 0; bin < _fields.back().histogramBinCount(); ++bin )
+		_availableVolumes.insert( VolumeID::histogram( index, bin ) );
+
+	std::cout << "Finished adding field \"" << name.toStdString() << "\" = " << expression.toStdString() << " in " << timer.get() << " ms." << std::endl;
+}
+void Ensemble::setStorage( int32_t field, Ensemble::Field::Storage storage, const compression::Encoding& encoding )
+{
+	_fields[field].setStorage( storage, encoding );
+	this->updateVirtualFields( field );
+}
+void Ensemble::setLowRank( int32_t field, int32_t rank )
+{
+	_fields[field].setLowRank( rank );
+	this->updateVirtualFields( field );
+}
+bool Ensemble::applyRecomputedStages( bool wait )
+{
+	// The results of all fields are applied, the first exception is rethrown afterwards
+	auto applied = true;
+	auto exception = std::exception_ptr();
+	for( auto& field : _fields )
+	{
+		try { applied &= field.applyRecomputedStages( wait ); } catch( ... ) { if( !exception ) exception = std::current_exception(); }
+	}
+	if( exception ) std::rethrow_exception( exception );
+	return applied;
+}
 
 const Volume<float>& Ensemble::volume( const Ensemble::VolumeID& id ) const
 {
 	// If the requested volume has an ensemble type, search for it in derived volumes. Otherwise, return from specified field
 	if( _EnsembleTypes.count( id.type ) )
 	{
-		if( _derivedVolumes.find( id.type ) == _derivedVolumes.end() )
+		return _derivedVolumes.get( id.type, [&]
 		{
+			auto volume = Volume<float>();
 			switch( id.type )
 			{
 			case Derived::eLabel:
-				_derivedVolumes[id.type] = _volumeLabels->cast<float>();
-				_derivedVolumes[id.type].expandDomain( vec2f( 0.0f, 1.0f ) );
+				volume = _volumeLabels->cast<float>();
+				volume.expandDomain( vec2f( 0.0f, 1.0f ) );
 				break;
 			}
-		}
-		return _derivedVolumes[id.type];
+			return volume;
+		} );
 	}
 	else
 	{
 		if( id.type == Ensemble::Derived::eNone ) return _fields[id.field].volume( id.index );
+		else if( id.type == Ensemble::Derived::eHist1 && id.index >= 0 ) return _fields[id.field].histogramVolume( id.index );
 		else return _fields[id.field].volume( id.type );
 	}
 }
-const Volume<float>& Ensemble::differenceVolume( const VolumeID& id, const Ensemble& other ) const
+VolumeView Ensemble::differenceVolume( const VolumeID& id, const Ensemble& other ) const
 {
-	// Return difference between two volumes of the same type from this and another ensemble. If it is not cached, compute it first.
-	auto& volumes = _differenceVolumes[&other];
-	if( volumes.count( id ) == 0 )
-	{
-		const auto& a = this->volume( id );
-		const auto& b = other.volume( id );
-
-		auto& result = volumes[id] = Volume<float>( a.dimensions(), a.name() + " (diff)" );
-		util::compute_multi_threaded( 0, result.voxelCount(), [&] ( int32_t begin, int32_t end )
-		{
-			for( int32_t i = begin; i < end; ++i )
-				result.at( i ) = a.at( i ) - b.at( i );
-		} );
-	}
-
-	return _differenceVolumes[&other][id];
+	// Return the difference between two volumes of the same type from this and another ensemble (nothing is materialized)
+	const auto& volume = this->volume( id );
+	return VolumeView::difference( volume, other.volume( id ), volume.name() + " (diff)" );
 }
 
 const HCNode& Ensemble::root( const SimilarityID& id ) const
@@ -289,84 +540,135 @@ const std::set<Ensemble::VolumeID>& Ensemble::availableVolumes() const noexcept
 
 Ensemble::Field::Field( QString name ) noexcept : _name( std::move( name ) )
 {}
-Ensemble::Field::Field( const Field& other, const std::vector<int32_t>& volumes ) : _name( other._name )
+Ensemble::Field::Field( const Field& other, const std::vector<int32_t>& volumes ) : _name( other._name ), _storage( other._storage ), _lossy( other._lossy ), _histogramBinCount( other._histogramBinCount ), _quantileBudget( other._quantileBudget ),
+	_gradientStorage( other._gradientStorage )
 {
-	// Copy the specified volumes from the other field
+	// Copy the specified volumes from the other field. For interleaved fields, only a view on the specified members is created.
 	_volumes = std::vector<std::shared_ptr<Volume<float>>>( volumes.size() );
-	for( int32_t i = 0; i < volumes.size(); ++i ) _volumes[i] = other._volumes[volumes[i]];
+	if( _storage == Storage::eVolumes )
+	{
+		for( int32_t i = 0; i < volumes.size(); ++i ) _volumes[i] = other._volumes[volumes[i]];
+		_members = std::make_shared<VolumeMembers>( _volumes );
+	}
+	else _members = std::make_shared<SubsetMembers>( other._members, volumes );
 }
-Ensemble::Field::Field( const Ensemble::Field& other, QString name, const std::function<float( float )>& conversion ) : _name( std::move( name ) )
+Ensemble::Field::Field( const Ensemble::Field& other, QString name, const std::function<float( float )>& conversion ) : _name( std::move( name ) ), _lossy( other._lossy ), _histogramBinCount( other._histogramBinCount ),
+	_quantileBudget( other._quantileBudget ), _gradientStorage( other._gradientStorage )
 {
 	// Copy the other field, applying a mapping to the values of all members
-	_volumes = std::vector<std::shared_ptr<Volume<float>>>( other._volumes.size() );
-	for( int32_t i = 0; i < _volumes.size(); ++i ) _volumes[i] = std::make_shared<Volume<float>>( other._volumes[i]->map( conversion ) );
+	_volumes = std::vector<std::shared_ptr<Volume<float>>>( other.memberCount() );
+	for( int32_t i = 0; i < _volumes.size(); ++i ) _volumes[i] = std::make_shared<Volume<float>>( other._members->member( i ).map( conversion ) );
+	this->setStorage( other._storage == Storage::eVirtual || other._storage == Storage::eLowRank ? Storage::eInterleaved : other._storage );
+}
+Ensemble::Field::Field( QString name, const std::vector<const Field*>& inputs, const Expression& expression ) : _name( std::move( name ) ), _storage( Storage::eVirtual ),
+	_histogramBinCount( inputs.front()->_histogramBinCount ), _quantileBudget( inputs.front()->_quantileBudget ), _gradientStorage( inputs.front()->_gradientStorage )
+{
+	// Evaluate the members from the members of the input fields on access, member volumes are extracted on demand
+	auto members = std::vector<std::shared_ptr<const MemberBricks>>( inputs.size() );
+	for( size_t i = 0; i < inputs.size(); ++i ) members[i] = inputs[i]->_members;
+	_members = std::make_shared<ExpressionMembers>( std::move( members ), expression );
+	_volumes = std::vector<std::shared_ptr<Volume<float>>>( _members->memberCount() );
+	_fingerprint = Field::fingerprint( inputs, expression );
+}
+Ensemble::Field::Field( Ensemble::Field&& other )
+{
+	*this = std::move( other );
+}
+Ensemble::Field::~Field()
+{
+	this->cancelRecomputation();
+	this->untrackMemory();
+}
+Ensemble::Field& Ensemble::Field::operator=( Ensemble::Field&& other )
+{
+	this->cancelRecomputation();
+	this->untrackMemory();
+	other.untrackMemory();
+
+	_name = std::move( other._name );
+	_storage = other._storage;
+	_members = std::move( other._members );
+	_lossy = other._lossy;
+	_volumes = std::move( other._volumes );
+	_stages = std::move( other._stages );
+	_derivedVolumes = std::move( other._derivedVolumes );
+	_similarities = std::move( other._similarities );
+	_histogramBinCount = other._histogramBinCount;
+	_quantileBudget = other._quantileBudget;
+	_histogram = std::move( other._histogram );
+	_histogramVolumes = std::move( other._histogramVolumes );
+	_gradientStorage = other._gradientStorage;
+	_fingerprint = other._fingerprint.load();
+	_volumeGradient = std::move( other._volumeGradient );
+	_mappedGradient = std::move( other._mappedGradient );
+	_gradientNormals = std::move( other._gradientNormals );
+	_evictedVolumes = std::move( other._evictedVolumes );
+	_evictable = other._evictable;
+	_recomputation = std::move( other._recomputation );
+
+	this->trackMemory();
+	return *this;
 }
 
 void Ensemble::Field::loadRFA()
 {
-	const auto directory = std::string( "../../../Datasets/ensemble" );
-
-	auto data = std::unordered_map<std::string, std::pair<std::vector<float>, std::vector<float>>>();
-	auto counter = 0;
-
-	// --- Iterate all folders in the specified directory --- //
-	for( const auto& it : std::filesystem::directory_iterator( directory ) )
+	const auto directory = std::filesystem::path( "../../../Datasets" );
+	const auto filepath = directory / "radio_frequency_ablation.bin";
+
+	// --- Convert the text files of the members once --- //
+	if( !std::filesystem::exists( filepath ) ) Field::convertRFA( directory / "ensemble", filepath );
+
+	// --- Read the shape header (member count and dimensions, like 'load_volumes_rfa' in scripts/clustering.py) --- //
+	auto stream = std::ifstream( filepath, std::ios::in | std::ios::binary );
+	uint32_t shape[4] = {};
+	if( !stream.read( reinterpret_cast<char*>( shape ), sizeof( shape ) ) ) throw std::runtime_error( "Ensemble::Field::loadRFA -> Failed to read file " + filepath.string() );
+	const auto dimensions = vec3i( shape[1], shape[2], shape[3] );
+
+	// --- Read the members with parallel positional reads straight into the member volumes --- //
+	const auto bytes = static_cast<uint64_t>( dimensions.product() ) * sizeof( float );
+	auto ranges = std::vector<util::FileRange>( shape[0] );
+	_volumes = std::vector<std::shared_ptr<Volume<float>>>( shape[0] );
+	for( uint32_t i = 0; i < shape[0]; ++i )
 	{
-		const auto path = it.path();
-		const auto extension = path.extension();
+		_volumes[i] = std::make_shared<Volume<float>>( dimensions, "Value" );
+		ranges[i] = util::FileRange { sizeof( shape ) + i * bytes, bytes, _volumes[i]->data() };
+	}
+	util::read_parallel( filepath, ranges );
+	this->setStorage( Storage::eInterleaved );
 
-		// --- Look for files with either 'ParameterConfig' or 'TemperatureImage' in their name --- //
-		auto id = path.filename().replace_extension().string();
-		for( auto str : { std::string( "ParameterConfig" ), std::string( "TemperatureImage" ) } )
-		{
-			const auto pos = id.find( str );
-			if( pos != std::string::npos ) id.replace( pos, str.length(), "" );
-		}
+	// --- Compute all derived volumes --- //
+	this->computeDerivedVolumes();
+}
+void Ensemble::Field::convertRFA( const std::filesystem::path& directory, const std::filesystem::path& filepath )
+{
+	auto timer = util::timer();
 
-		// --- For the '.bin' extension, read the temperature volume of the current member --- //
-		if( extension == ".bin" )
-		{
-			auto stream = std::ifstream( path );
-			auto values = std::vector<float>();
-			std::copy( std::istream_iterator<float>( stream ), std::istream_iterator<float>(), std::back_inserter( values ) );
-			data[id].second = std::move( values );
-			std::cout << "Reading file '" << id << "' (" << ++counter << ")" << std::endl;
-		}
-		// --- For the '.json' extension, read the parameters of the current member --- //
-		else if( extension == ".json" )
-		{
-			auto stream = std::ifstream( path );
-			auto json = nlohmann::json();
-			stream >> json;
+	// --- Collect the temperature files of all members (sorted, so the order of the members is deterministic) --- //
+	auto paths = std::vector<std::filesystem::path>();
+	for( const auto& it : std::filesystem::directory_iterator( directory ) ) if( it.path().extension() == ".bin" ) paths.push_back( it.path() );
+	std::sort( paths.begin(), paths.end() );
 
-			const auto& table = json["Material_Table"];
-			const auto liver = std::stof( table[0]["ThermalConductivity"][0]["BaseValue"].get<std::string>() );
-			const auto tumor = std::stof( table[1]["ThermalConductivity"][0]["BaseValue"].get<std::string>() );
-			const auto vessel = std::stof( table[2]["ThermalConductivity"][0]["BaseValue"].get<std::string>() );
+	// --- Parse the text files in parallel --- //
+	const auto dimensions = vec3i( 92, 92, 92 );
+	auto members = std::vector<std::vector<float>>( paths.size() );
+	util::compute_multi_threaded( 0, paths.size(), [&] ( int32_t begin, int32_t end )
+	{
+		for( int32_t i = begin; i < end; ++i ) members[i] = util::read_text_values<float>( paths[i] );
+	} );
 
-			auto values = std::vector<float> { liver, tumor, vessel };
-			data[id].first = std::move( values );
-		}
-	}
+	// --- Check all members before anything is written --- //
+	for( size_t i = 0; i < members.size(); ++i )
+		if( members[i].size() != dimensions.product() ) throw std::runtime_error( "Ensemble::Field::convertRFA -> Member " + paths[i].string() + " has the wrong number of values." );
 
-	// --- Convert the read data into volumes --- //
-	const auto dimensions = vec3i( 92, 92, 92 );
-	for( auto& [key, value] : data )
+	// --- Write the shape header and the members (through a temporary file, so no partial file is left behind) --- //
+	const uint32_t shape[4] = { static_cast<uint32_t>( members.size() ), static_cast<uint32_t>( dimensions.x ), static_cast<uint32_t>( dimensions.y ), static_cast<uint32_t>( dimensions.z ) };
+	util::write_file( filepath, [&] ( std::ostream& stream )
 	{
-		auto volume = std::make_shared<Volume<float>>( dimensions, std::move( value.second ), "Value" );
-		_volumes.push_back( volume );
-	}
-	_volumes.shrink_to_fit();
+		stream.write( reinterpret_cast<const char*>( shape ), sizeof( shape ) );
+		for( const auto& member : members ) stream.write( reinterpret_cast<const char*>( member.data() ), member.size() * sizeof( float ) );
+	} );
 
-	// --- Compute all derived volumes --- //
-	this->computeMinimumMaximum();
-	this->computeMeanStddev();
-	this->computeGradient();
-	this->computePrincipalComponents();
-	this->computeFieldSimilarity();
-	this->computePearsonSimilarity();
-	this->computeHistograms();
-	this->computeAndersonDarling();
+	std::cout << "Finished converting " << members.size() << " members to " << filepath << " in " << timer.get() << " ms." << std::endl;
 }
 void Ensemble::Field::loadTeardrop()
 {
@@ -413,16 +715,10 @@ void Ensemble::Field::loadTeardrop()
 			}
 		}
 	} );
+	this->setStorage( Storage::eInterleaved );
 
 	// Compute all derived volumes
-	this->computeMinimumMaximum();
-	this->computeMeanStddev();
-	this->computeGradient();
-	this->computePrincipalComponents();
-	this->computeFieldSimilarity();
-	this->computePearsonSimilarity();
-	this->computeHistograms();
-	this->computeAndersonDarling();
+	this->computeDerivedVolumes();
 }
 void Ensemble::Field::loadTangle()
 {
@@ -478,16 +774,10 @@ void Ensemble::Field::loadTangle()
 			}
 		}
 	} );
+	this->setStorage( Storage::eInterleaved );
 
 	// Compute all derived volumes
-	this->computeMinimumMaximum();
-	this->computeMeanStddev();
-	this->computeGradient();
-	this->computePrincipalComponents();
-	this->computeFieldSimilarity();
-	this->computePearsonSimilarity();
-	this->computeHistograms();
-	this->computeAndersonDarling();
+	this->computeDerivedVolumes();
 }
 void Ensemble::Field::loadSpheres()
 {
@@ -545,46 +835,179 @@ void Ensemble::Field::loadSpheres()
 			}
 		}
 	} );
+	this->setStorage( Storage::eInterleaved );
 
 	// Compute all derived volumes
-	this->computeMinimumMaximum();
-	this->computeMeanStddev();
-	this->computeGradient();
-	this->computePrincipalComponents();
-	this->computeFieldSimilarity();
-	this->computePearsonSimilarity();
-	this->computeHistograms();
-	this->computeAndersonDarling();
+	this->computeDerivedVolumes();
+}
+#ifdef REGHIEVIS_HDF5
+void Ensemble::Field::loadHDF5( const std::vector<std::unique_ptr<HDF5File>>& files, const std::vector<QString>& datasets, const Expression& expression )
+{
+	// --- Check the dimensions of the datasets that are used by the expression --- //
+	auto used = std::vector<int32_t>();
+	for( int32_t i = 0; i < static_cast<int32_t>( datasets.size() ); ++i ) if( expression.uses( i ) ) used.push_back( i );
+	if( used.empty() ) throw std::invalid_argument( "Ensemble::Field::loadHDF5 -> Expression of field " + _name.toStdString() + " doesn't use any dataset." );
+
+	const auto dimensions = files.front()->dimensions( datasets[used.front()].toStdString() );
+	for( const auto& file : files ) for( const auto i : used )
+		if( file->dimensions( datasets[i].toStdString() ) != dimensions ) throw std::runtime_error( "Ensemble::Field::loadHDF5 -> Dimensions of dataset " + datasets[i].toStdString() + " don't match in all files." );
+
+	// --- Read slabs (the layers of one row of bricks) of the datasets, evaluate the expression and scatter the slab into the bricks --- //
+	// Consecutive tasks read the same slab of different files, so only a few slabs per thread are in memory at any time
+	const auto memberCount = static_cast<int32_t>( files.size() );
+	auto members = std::make_shared<InterleavedMembers>( dimensions, memberCount );
+	const auto& layout = members->layout();
+	const auto layerSize = static_cast<size_t>( dimensions.y ) * dimensions.z;
+	util::compute_multi_threaded( 0, memberCount * layout.brickCounts().x, [&] ( int32_t begin, int32_t end )
+	{
+		auto inputs = std::vector<std::vector<float>>( datasets.size() );
+		auto pointers = std::vector<const float*>( datasets.size(), nullptr );
+		auto values = std::vector<float>( layerSize * layout.brickSize() );
+		for( int32_t i = begin; i < end; ++i )
+		{
+			const auto member = i % memberCount;
+			const auto row = i / memberCount;
+			const auto first = row * layout.brickSize();
+			const auto count = std::min( layout.brickSize(), dimensions.x - first );
+			for( const auto j : used )
+			{
+				inputs[j].resize( values.size() );
+				files[member]->read( datasets[j].toStdString(), first, count, inputs[j].data() );
+				pointers[j] = inputs[j].data();
+			}
+			expression.evaluate( pointers.data(), values.data(), static_cast<int64_t>( layerSize ) * count );
+			members->setSlab( member, row, values.data() );
+		}
+	} );
+
+	_members = std::move( members );
+	_volumes = std::vector<std::shared_ptr<Volume<float>>>( memberCount );
+	_storage = Storage::eInterleaved;
+	this->trackMemory();
 }
+#endif
 
-void Ensemble::Field::load( std::ifstream& stream )
+void Ensemble::Field::load( std::istream& stream, const std::filesystem::path& filepath, const std::shared_ptr<const MappedFile>& file, uint32_t version )
 {
 	// Read fild name
 	std::string name;
 	util::read_binary( stream, name );
 	_name = QString::fromStdString( name );
 
-	// Read member volumes
-	_volumes = std::vector<std::shared_ptr<Volume<float>>>( util::read_binary<size_t>( stream ) );
-	for( size_t i = 0; i < _volumes.size(); ++i ) _volumes[i].reset( new Volume<float>( stream ) );
+	_storage = Storage::eInterleaved;
+	_lossy = false;
+	if( file )
+	{
+		// Mapped files store the members as interleaved bricks, which are used without copying them (since version 7, the storage and whether the values
+		// are lossy come first, so decoded lossy values aren't encoded lossily again)
+		const auto storage = version >= 7 ? util::read_binary<Storage>( stream ) : Storage::eCompressed;
+		const auto lossy = version >= 7 ? util::read_binary<bool>( stream ) : false;
+		const auto memberCount = util::read_binary<int32_t>( stream );
+		const auto dimensions = util::read_binary<vec3i>( stream );
+		const auto layout = BrickLayout( dimensions, util::read_binary<int32_t>( stream ) );
+		const auto offset = util::read_binary<uint64_t>( stream );
+		_volumes = std::vector<std::shared_ptr<Volume<float>>>( memberCount );
+
+		// Low-rank members are read from their components, the basis bricks are copied out of the file (they are small compared to the members)
+		if( storage == Storage::eLowRank )
+		{
+			auto means = std::vector<float>(), coefficients = std::vector<float>(), variances = std::vector<float>();
+			auto domains = std::vector<vec2f>();
+			util::read_binary_vector( stream, means );
+			util::read_binary_vector( stream, coefficients );
+			util::read_binary_vector( stream, variances );
+			util::read_binary_vector( stream, domains );
+			_fingerprint = util::read_binary<uint64_t>( stream );
+			if( variances.empty() || domains.size() != static_cast<size_t>( memberCount ) ) throw std::runtime_error( "Ensemble::Field::load -> Low-rank members are invalid, the file is probably corrupt." );
+
+			const auto count = static_cast<uint64_t>( layout.voxelCount() ) * variances.size();
+			const auto basis = file->data<const float>( offset, count * sizeof( float ) );
+			auto members = std::make_shared<LowRankMembers>( layout, memberCount, std::move( means ), std::move( coefficients ), std::move( variances ) );
+			std::copy( basis, basis + count, members->basis( 0 ) );
+			for( int32_t i = 0; i < memberCount; ++i ) members->setDomain( i, domains[i] );
+			_members = std::move( members );
+			_storage = Storage::eLowRank;
+			_lossy = true;
+		}
+
+		// Since version 3, the bricks are compressed, they are decompressed in parallel using the brick index when the members are first accessed.
+		// Members that would take more than half of the memory budget are paged from the file instead.
+		else if( version >= 3 )
+		{
+			auto index = std::vector<uint64_t>();
+			util::read_binary_vector( stream, index );
+			if( index.empty() ) throw std::runtime_error( "Ensemble::Field::load -> Brick index is empty, the file is probably corrupt." );
+			const auto data = file->data<const uint8_t>( offset, index.back() );
+			auto compressed = std::make_shared<CompressedMembers>( layout, memberCount, std::move( index ), data, file );
+			if( version >= 5 ) _fingerprint = util::read_binary<uint64_t>( stream );
+			_lossy = lossy || compressed->lossy();
+
+			const auto bytes = static_cast<size_t>( layout.voxelCount() ) * memberCount * sizeof( float );
+			if( bytes > util::memory_budget().budget( util::MemoryBudget::Pool::eHost ) / 2 )
+			{
+				_members = std::make_shared<PagedMembers>( std::move( compressed ), Field::brickCacheSize() );
+				_storage = Storage::ePaged;
+			}
+			else _members = std::make_shared<LazyMembers>( std::move( compressed ) );
+		}
+		else
+		{
+			const auto values = file->data<float>( offset, static_cast<uint64_t>( layout.voxelCount() ) * memberCount * sizeof( float ) );
+			_members = std::make_shared<InterleavedMembers>( layout, memberCount, values, file );
+		}
+	}
+	else
+	{
+		// Find the offsets of the member values by skipping them in the stream
+		_volumes = std::vector<std::shared_ptr<Volume<float>>>( util::read_binary<size_t>( stream ) );
+		auto offsets = std::vector<uint64_t>( _volumes.size() );
+		auto dimensions = vec3i();
+		for( size_t i = 0; i < _volumes.size(); ++i )
+		{
+			auto name = std::string();
+			util::read_binary( stream, name );
+			util::read_binary( stream, dimensions );
+			if( util::read_binary<size_t>( stream ) != dimensions.product() ) throw std::runtime_error( "Ensemble::Field::load -> Dimensions of member volume don't match its size, the file is probably corrupt." );
+			offsets[i] = static_cast<uint64_t>( stream.tellg() );
+			stream.seekg( static_cast<uint64_t>( dimensions.product() ) * sizeof( float ) + sizeof( vec2f ), std::ios::cur );
+		}
+
+		// Read batches of members (up to 1 GiB) with parallel positional reads and scatter them into member-interleaved bricks
+		if( !_volumes.empty() )
+		{
+			auto members = std::make_shared<InterleavedMembers>( dimensions, _volumes.size() );
+			const auto bytes = static_cast<uint64_t>( dimensions.product() ) * sizeof( float );
+			const auto batchSize = std::clamp<size_t>( ( uint64_t( 1 ) << 30 ) / std::max<uint64_t>( bytes, 1 ), 1, _volumes.size() );
+			auto batch = std::vector<Volume<float>>( batchSize, Volume<float>( dimensions ) );
+			for( size_t begin = 0; begin < _volumes.size(); begin += batchSize )
+			{
+				const auto end = std::min( begin + batchSize, _volumes.size() );
+				auto ranges = std::vector<util::FileRange>();
+				for( size_t i = begin; i < end; ++i ) ranges.push_back( util::FileRange { offsets[i], bytes, batch[i - begin].data() } );
+				util::read_parallel( filepath, ranges );
+				for( size_t i = begin; i < end; ++i ) members->setMember( i, batch[i - begin] );
+			}
+			_members = std::move( members );
+		}
+	}
 
 	// Read derived volumes
 	const auto derivedVolumeCount = util::read_binary<size_t>( stream );
 	if( derivedVolumeCount ) for( size_t i = 0; i < derivedVolumeCount; ++i )
 	{
 		const auto key = util::read_binary<Derived>( stream );
-		_derivedVolumes[key] = Volume<float>( stream );
+		auto volume = Volume<float>( stream, file );
 
-		if( key == Derived::eGradientMagnitude ) _volumeGradient = Volume<vec3f>( stream );
-	}
-	else
-	{
-		this->computeMinimumMaximum();
-		this->computeMeanStddev();
-		this->computeGradient();
-		this->computePrincipalComponents();
-		this->computeHistograms();
-		this->computeAndersonDarling();
+		// Normalized histogram bins of older files are skipped, the bin counts are computed on demand
+		if( key >= Derived::eHist1 && key <= Derived::eHist5 ) continue;
+		_derivedVolumes.set( key, std::move( volume ) );
+
+		if( key == Derived::eGradientMagnitude )
+		{
+			auto gradient = Volume<vec3f>( stream, file );
+			this->storeGradient( gradient );
+			if( file ) _mappedGradient = std::move( gradient );
+		}
 	}
 
 	// Read similarity matrices and the resulting dendrogram
@@ -592,66 +1015,149 @@ void Ensemble::Field::load( std::ifstream& stream )
 	if( similaritiesCount ) for( size_t i = 0; i < similaritiesCount; ++i )
 	{
 		const auto key = util::read_binary<Similarity>( stream );
-		auto volume = Volume<float>( stream );
+		auto volume = Volume<float>( stream, file );
 		auto root = HCNode( stream );
-		_similarities[key] = std::make_pair( std::move( volume ), std::move( root ) );
-	}
-	else
-	{
-		this->computeFieldSimilarity();
-		this->computePearsonSimilarity();
+		_similarities.set( key, std::make_pair( std::move( volume ), std::move( root ) ) );
 	}
+
+	// Everything that is missing in the file is computed on first access
+	this->trackMemory();
 }
-void Ensemble::Field::save( std::ofstream& stream ) const
+void Ensemble::Field::save( std::ostream& stream, MappedFileWriter& data ) const
 {
 	// Save the fiel name
 	util::write_binary( stream, _name.toStdString() );
 
-	// Save the member volumes
-	util::write_binary( stream, _volumes.size() );
-	for( const auto volume : _volumes ) volume->save( stream );
+	// Save low-rank members as their components and the basis bricks one after another (the rank is the number of variances)
+	if( const auto lowRank = dynamic_cast<const LowRankMembers*>( _members.get() ) )
+	{
+		const auto& layout = lowRank->layout();
+		auto domains = std::vector<vec2f>( this->memberCount() );
+		for( int32_t i = 0; i < this->memberCount(); ++i ) domains[i] = lowRank->domain( i );
+
+		util::write_binary( stream, Storage::eLowRank );
+		util::write_binary( stream, _lossy );
+		util::write_binary( stream, this->memberCount() );
+		util::write_binary( stream, layout.dimensions() );
+		util::write_binary( stream, layout.brickSize() );
+		util::write_binary( stream, data.write( lowRank->basis( 0 ), static_cast<uint64_t>( layout.voxelCount() ) * lowRank->rank() * sizeof( float ) ) );
+		util::write_binary_vector( stream, lowRank->means() );
+		util::write_binary_vector( stream, std::vector<float>( lowRank->coefficients( 0 ), lowRank->coefficients( lowRank->rank() ) ) );
+		util::write_binary_vector( stream, lowRank->variances() );
+		util::write_binary_vector( stream, domains );
+		util::write_binary( stream, this->fingerprint() );
+	}
+	else
+	{
+		// Save the members as compressed bricks one after another and the brick index (compressed fields are saved without compressing them again)
+		auto compressed = CompressedMembers::source( _members );
+		if( !compressed ) compressed = CompressedMembers::compress( *_members );
+
+		const auto& layout = compressed->layout();
+		util::write_binary( stream, Storage::eCompressed );
+		util::write_binary( stream, _lossy );
+		util::write_binary( stream, this->memberCount() );
+		util::write_binary( stream, layout.dimensions() );
+		util::write_binary( stream, layout.brickSize() );
+		util::write_binary( stream, data.write( compressed->data(), compressed->bytes() ) );
+		util::write_binary_vector( stream, compressed->index() );
+		util::write_binary( stream, this->fingerprint() );
+	}
 
-	// Save the derived volumes
+	// Save the derived volumes (volumes that were evicted from memory are recomputed first)
+	auto evictedVolumes = std::set<Derived>();
+	{
+		const auto lock = std::scoped_lock( _memoryMutex );
+		evictedVolumes = _evictedVolumes;
+	}
+	for( const auto derived : evictedVolumes ) this->volume( derived );
 	util::write_binary( stream, _derivedVolumes.size() );
-	for( const auto& [key, volume] : _derivedVolumes )
+	_derivedVolumes.forEach( [&] ( Derived key, const Volume<float>& volume )
 	{
 		util::write_binary( stream, key );
-		volume.save( stream );
+		volume.save( stream, &data );
 
-		if( key == Ensemble::Derived::eGradientMagnitude ) _volumeGradient.save( stream );
-	}
+		// The gradient of a mapped file is saved without computing it again (it is kept in place when the file is updated)
+		if( key == Ensemble::Derived::eGradientMagnitude )
+		{
+			if( _mappedGradient.voxelCount() ) _mappedGradient.save( stream, &data );
+			else this->gradientVolume().save( stream, &data );
+		}
+	} );
 
 	// Save the similarity matrices and resulting dendrograms
 	util::write_binary( stream, _similarities.size() );
-	for( const auto& [key, pair] : _similarities )
+	_similarities.forEach( [&] ( Similarity key, const std::pair<Volume<float>, HCNode>& pair )
 	{
 		util::write_binary( stream, key );
-		pair.first.save( stream );
+		pair.first.save( stream, &data );
 		pair.second.save( stream );
+	} );
+}
+void Ensemble::Field::releaseFile( const MappedFile& file, const Field* replacement )
+{
+	const auto mapped = [&file] ( const auto& volume ) { return file.contains( volume.data(), static_cast<uint64_t>( volume.voxelCount() ) * sizeof( *volume.data() ) ); };
+	const auto replacementMembers = replacement ? CompressedMembers::source( replacement->_members ) : nullptr;
+
+	// Compressed bricks are copied as they are or replaced (lazily decompressed and paged members are created again), interleaved bricks of older files are
+	// copied or replaced by the compressed bricks of the replacement
+	if( const auto compressed = CompressedMembers::source( _members ); compressed && file.contains( compressed->data(), compressed->bytes() ) )
+	{
+		auto copy = replacementMembers ? replacementMembers : std::shared_ptr<const CompressedMembers>( compressed->copy() );
+		if( const auto paged = std::dynamic_pointer_cast<const PagedMembers>( _members ) ) _members = std::make_shared<PagedMembers>( std::move( copy ), paged->cacheSize() );
+		else if( std::dynamic_pointer_cast<const LazyMembers>( _members ) ) _members = std::make_shared<LazyMembers>( std::move( copy ) );
+		else _members = std::move( copy );
+	}
+	else if( const auto interleaved = std::dynamic_pointer_cast<const InterleavedMembers>( _members ) )
+	{
+		auto scratch = std::vector<float>();
+		const auto values = interleaved->brick( 0, scratch );
+		const auto count = static_cast<size_t>( interleaved->layout().voxelCount() ) * this->memberCount();
+		if( file.contains( values, count * sizeof( float ) ) && replacementMembers )
+		{
+			_members = replacement->_members;
+			_storage = replacement->_storage;
+		}
+		else if( file.contains( values, count * sizeof( float ) ) )
+		{
+			auto copy = std::make_shared<InterleavedMembers>( interleaved->layout(), this->memberCount() );
+			std::copy( values, values + count, copy->values( 0 ) );
+			_members = std::move( copy );
+		}
 	}
+
+	// Volumes are changed in place, so references to them stay valid
+	_derivedVolumes.forEach( [&] ( Derived key, const Volume<float>& volume )
+	{
+		if( mapped( volume ) ) const_cast<Volume<float>&>( volume ).wrap( replacement ? replacement->_derivedVolumes.find( key ) : nullptr );
+	} );
+	_similarities.forEach( [&] ( Similarity key, const std::pair<Volume<float>, HCNode>& pair )
+	{
+		const auto other = replacement ? replacement->_similarities.find( key ) : nullptr;
+		if( mapped( pair.first ) ) const_cast<Volume<float>&>( pair.first ).wrap( other ? &other->first : nullptr );
+	} );
+	if( mapped( _mappedGradient ) ) _mappedGradient.wrap( replacement && replacement->_mappedGradient.voxelCount() ? &replacement->_mappedGradient : nullptr );
+	this->trackMemory();
 }
 bool Ensemble::Field::compare( const Ensemble::Field& other ) const
 {
-	// Compare member volumes
-	if( _volumes.size() != other._volumes.size() ) return false;
-	for( size_t i = 0; i < _volumes.size(); ++i ) if( *_volumes[i] != *other._volumes[i] ) return false;
-	std::cout << "Ensemble::Field::compare( const Ensemble::Field& ) -> Volumes equal." << std::endl;
+	// Compare members
+	if( this->memberCount() != other.memberCount() || this->fingerprint() != other.fingerprint() ) return false;
 
-	// Compare derived volumes
+	// Compare derived volumes, similarity matrices and dendrograms. The gradient isn't reconstructed, it is computed from the members like its magnitude,
+	// which is one of the derived volumes.
 	if( _derivedVolumes != other._derivedVolumes ) return false;
-	std::cout << "Ensemble::Field::compare( const Ensemble::Field& ) -> Derived volumes equal." << std::endl;
-
-	// Compare similarity matrices and dendrograms
 	if( _similarities != other._similarities ) return false;
-	std::cout << "Ensemble::Field::compare( const Ensemble::Field& ) -> Similarities equal." << std::endl;
-
-	// Compare gradient volume
-	if( _volumeGradient != other._volumeGradient ) return false;
-	std::cout << "Ensemble::Field::compare( const Ensemble::Field& ) -> Gradient volume equal." << std::endl;
-
-	std::cout << "Ensemble::Field::compare( const Ensemble::Field& ) -> Fields equal." << std::endl;
 	return true;
 }
+uint64_t Ensemble::Field::fingerprint() const
+{
+	// Zero marks a fingerprint that wasn't computed yet (concurrent requests might compute it more than once)
+	if( const auto hash = _fingerprint.load( std::memory_order_acquire ) ) return hash;
+	const auto hash = _members ? std::max<uint64_t>( _members->fingerprint(), 1 ) : 1;
+	_fingerprint.store( hash, std::memory_order_release );
+	return hash;
+}
 
 void Ensemble::Field::setName( QString name ) noexcept
 {
@@ -664,220 +1170,1224 @@ const QString& Ensemble::Field::name() const noexcept
 
 int32_t Ensemble::Field::memberCount() const noexcept
 {
-	return _volumes.size();
+	return _members ? _members->memberCount() : 0;
 }
 int32_t Ensemble::Field::voxelCount() const noexcept
 {
-	return _volumes.empty() ? 0 : _volumes.front()->voxelCount();
+	return _members ? _members->voxelCount() : 0;
 }
 vec3i Ensemble::Field::dimensions() const noexcept
 {
-	return _volumes.empty() ? vec3i() : _volumes.front()->dimensions();
+	return _members ? _members->dimensions() : vec3i();
 }
 
-const Volume<float>& Ensemble::Field::volume( int32_t index ) const
-{
-	return *_volumes[index];
-}
-const Volume<float>& Ensemble::Field::volume( Ensemble::Derived derived ) const
+void Ensemble::Field::setStorage( Ensemble::Field::Storage storage, const compression::Encoding& encoding )
 {
-	// Return requested volume. If its not available, compute it first (lazy evaluation)
-	if( _derivedVolumes.find( derived ) == _derivedVolumes.end() )
+	if( storage == Storage::eVirtual ) throw std::invalid_argument( "Ensemble::Field::setStorage( Ensemble::Field::Storage ) -> Only fields created from an expression are virtual." );
+	if( storage == Storage::eLowRank ) throw std::invalid_argument( "Ensemble::Field::setStorage( Ensemble::Field::Storage ) -> Low-rank members are created using setLowRank." );
+	if( !encoding.valid() ) throw std::invalid_argument( "Ensemble::Field::setStorage( Ensemble::Field::Storage ) -> Invalid encoding, residuals can't be quantized and the tolerance can't be negative." );
+	if( encoding.encoded() && storage != Storage::eCompressed && storage != Storage::ePaged ) throw std::invalid_argument( "Ensemble::Field::setStorage( Ensemble::Field::Storage ) -> Only compressed and paged members can be encoded." );
+	if( !encoding.lossless() && _lossy ) throw std::invalid_argument( "Ensemble::Field::setStorage( Ensemble::Field::Storage ) -> Members are lossy already, encoding them lossily again would add to their error." );
+	if( _members && _storage == storage && !encoding.encoded() ) return;
+
+	if( _volumes.empty() ) return;
+
+	// Stages that are recomputed from the current members are cancelled and run again once the members were replaced (or if replacing them failed)
+	const auto recomputing = this->cancelRecomputation();
+	const auto previous = _storage;
+	try
 	{
-		switch( derived )
+		if( storage == Storage::eVolumes )
+		{
+			// Extract all member volumes and gather the bricks from them
+			for( int32_t i = 0; i < _volumes.size(); ++i ) this->volume( i );
+			_members = std::make_shared<VolumeMembers>( _volumes );
+		}
+		else if( storage == Storage::eCompressed || storage == Storage::ePaged )
+		{
+			// Compress the bricks of the current members (unless they are compressed already), member volumes are extracted again on demand
+			if( previous == Storage::eVolumes ) _members = std::make_shared<VolumeMembers>( _volumes );
+			auto compressed = encoding.encoded() ? nullptr : CompressedMembers::source( _members );
+			if( !compressed ) compressed = CompressedMembers::compress( *_members, encoding );
+
+			if( storage == Storage::ePaged ) _members = std::make_shared<PagedMembers>( std::move( compressed ), Field::brickCacheSize() );
+			else _members = std::move( compressed );
+			this->releaseVolumes( !encoding.lossless() );
+		}
+		else if( const auto compressed = CompressedMembers::source( _members ) ) _members = compressed->decompress();
+		else
 		{
-		case Derived::eMinimum:
-		case Derived::eMaximum:
-			this->computeMinimumMaximum();
-			break;
-		case Derived::eMean:
-		case Derived::eStddev:
-			this->computeMeanStddev();
-			break;
-		case Derived::eGradientMagnitude:
-			this->computeGradient();
-			break;
-		case Derived::ePCA1:
-		case Derived::ePCA2:
-			this->computePrincipalComponents();
-			break;
-		case Derived::eLabel:
-			throw std::invalid_argument( "Ensemble::Field::volume( Ensemble::Derived ) -> Ensemble::Derived::eLabel is an invalid argument." );
-			break;
-		case Derived::eHist1:
-		case Derived::eHist2:
-		case Derived::eHist3:
-		case Derived::eHist4:
-		case Derived::eHist5:
-		case Derived::eHistDeviation:
-			this->computeHistograms();
-			break;
-		case Derived::eAndersonDarling:
-			this->computeAndersonDarling();
-			break;
+			// Scatter the member volumes into interleaved bricks, releasing each unpinned volume afterwards (missing volumes are extracted from the previous members)
+			const auto source = previous != Storage::eVolumes ? _members : nullptr;
+			if( !source ) _members.reset();
+			auto members = std::make_shared<InterleavedMembers>( source ? source->dimensions() : _volumes.front()->dimensions(), _volumes.size() );
+			for( int32_t i = 0; i < _volumes.size(); ++i )
+			{
+				members->setMember( i, _volumes[i] ? *_volumes[i] : source->member( i ) );
+				if( !util::memory_budget().pinned( _volumes[i].get() ) ) _volumes[i].reset();
+			}
+			_members = std::move( members );
 		}
 	}
+	catch( ... )
+	{
+		// The previous members and their storage are kept
+		if( !_members && previous == Storage::eVolumes ) _members = std::make_shared<VolumeMembers>( _volumes );
+		if( recomputing ) this->recomputeStages();
+		throw;
+	}
+	_storage = storage;
 
-	return _derivedVolumes[derived];
+	// Lossy encodings change the values, so derived data that was already computed (or loaded) is recomputed
+	if( !encoding.lossless() ) _lossy = true;
+	if( !encoding.lossless() || recomputing ) this->recomputeStages();
+	this->trackMemory();
 }
-const std::map<Ensemble::Derived, Volume<float>>& Ensemble::Field::derivedVolumes() const noexcept
+Ensemble::Field::Storage Ensemble::Field::storage() const noexcept
 {
-	return _derivedVolumes;
+	return _storage;
+}
+bool Ensemble::Field::lossy() const noexcept
+{
+	return _lossy;
+}
+void Ensemble::Field::setLowRank( int32_t rank )
+{
+	if( rank < 1 ) throw std::invalid_argument( "Ensemble::Field::setLowRank( int32_t ) -> Invalid rank." );
+	if( _lossy ) throw std::invalid_argument( "Ensemble::Field::setLowRank( int32_t ) -> Members are lossy already, encoding them lossily again would add to their error." );
+	if( _volumes.empty() ) return;
+	this->cancelRecomputation();
+	if( _storage == Storage::eVolumes ) _members = std::make_shared<VolumeMembers>( _volumes );
+
+	// Compute the leading components of the current members (the rank is limited by the member count)
+	const auto memberCount = this->memberCount();
+	auto basis = this->principalBasis( nullptr, std::min( rank, memberCount ), PCAMethod::eAutomatic );
+	rank = static_cast<int32_t>( basis.variances.size() );
+	auto members = std::make_shared<LowRankMembers>( _members->layout(), memberCount, std::move( basis.means ), std::move( basis.components ), std::move( basis.variances ) );
+	const auto components = Eigen::Map<const Eigen::MatrixXf>( members->coefficients( 0 ), memberCount, rank );
+	const auto means = Eigen::Map<const Eigen::VectorXf>( members->means().data(), memberCount );
+
+	// Project the centered values of all voxels onto the components and record the domains of the original values
+	auto mutex = std::mutex();
+	auto minima = Eigen::VectorXf::Constant( memberCount, std::numeric_limits<float>::max() ).eval();
+	auto maxima = Eigen::VectorXf::Constant( memberCount, std::numeric_limits<float>::lowest() ).eval();
+	_members->forEachBrick( [&] ( const MemberBricks::Brick& brick )
+	{
+		const auto values = Eigen::Map<const Eigen::MatrixXf>( brick.values, brick.memberCount, brick.voxelCount );
+		auto projected = Eigen::Map<Eigen::MatrixXf>( members->basis( brick.index ), rank, brick.voxelCount );
+		projected.noalias() = components.transpose() * ( values.colwise() - means );
+
+		const auto brickMinima = values.rowwise().minCoeff().eval();
+		const auto brickMaxima = values.rowwise().maxCoeff().eval();
+		const auto lock = std::lock_guard( mutex );
+		minima = minima.cwiseMin( brickMinima );
+		maxima = maxima.cwiseMax( brickMaxima );
+	} );
+	for( int32_t i = 0; i < memberCount; ++i ) members->setDomain( i, vec2f( minima[i], maxima[i] ) );
+
+	// Replace the members, member volumes are reconstructed on demand
+	_storage = Storage::eLowRank;
+	_members = std::move( members );
+	_lossy = true;
+	this->releaseVolumes( true );
+	this->recomputeStages();
+	this->trackMemory();
+}
+void Ensemble::Field::setInputs( const std::vector<const Field*>& inputs )
+{
+	const auto expression = std::dynamic_pointer_cast<const ExpressionMembers>( _members );
+	if( !expression ) throw std::invalid_argument( "Ensemble::Field::setInputs( const std::vector<const Field*>& ) -> Only virtual fields have inputs." );
+	if( inputs.size() != expression->inputs().size() ) throw std::invalid_argument( "Ensemble::Field::setInputs( const std::vector<const Field*>& ) -> Invalid number of inputs." );
+
+	auto members = std::vector<std::shared_ptr<const MemberBricks>>( inputs.size() );
+	for( size_t i = 0; i < inputs.size(); ++i ) members[i] = inputs[i]->_members;
+	if( members == expression->inputs() ) return;
+
+	// Lossless storage changes keep the fingerprints of the inputs, so only the members are replaced
+	const auto fingerprint = Field::fingerprint( inputs, expression->expression() );
+	const auto changed = fingerprint != this->fingerprint();
+	const auto recomputing = this->cancelRecomputation();
+	_members = std::make_shared<ExpressionMembers>( std::move( members ), expression->expression() );
+	if( changed )
+	{
+		_fingerprint = fingerprint;
+		this->releaseVolumes( true );
+	}
+	if( changed || recomputing ) this->recomputeStages();
+	this->trackMemory();
+}
+size_t Ensemble::Field::brickCacheSize()
+{
+	// A quarter of the memory budget, but at most 1 GiB (passes read every brick once, so the cache mainly serves neighbouring requests)
+	return std::min( size_t( 1 ) << 30, util::memory_budget().budget( util::MemoryBudget::Pool::eHost ) / 4 );
 }
 
-const HCNode& Ensemble::Field::root( Ensemble::Similarity similarity ) const
+void Ensemble::Field::setGradientStorage( Ensemble::Field::GradientStorage storage )
 {
-	// Return requested dendrogram. If its not available, compute it first (lazy evaluation)
-	if( _similarities.find( similarity ) == _similarities.end() )
+	if( _gradientStorage == storage ) return;
+
+	// Re-store an already computed gradient using the new storage
+	if( _derivedVolumes.find( Derived::eGradientMagnitude ) )
 	{
-		switch( similarity )
-		{
-		case Similarity::eField:
-			this->computeFieldSimilarity(); break;
-		case Similarity::ePearson:
-			this->computePearsonSimilarity(); break;
-		}
+		const auto gradient = this->gradientVolume();
+		_gradientStorage = storage;
+		this->storeGradient( gradient );
+		this->trackMemory();
 	}
+	else _gradientStorage = storage;
+}
+Ensemble::Field::GradientStorage Ensemble::Field::gradientStorage() const noexcept
+{
+	return _gradientStorage;
+}
 
-	return _similarities[similarity].second;
+void Ensemble::Field::setHistogramBinCount( int32_t binCount )
+{
+	if( binCount < 1 ) throw std::invalid_argument( "Ensemble::Field::setHistogramBinCount( int32_t ) -> Invalid bin count." );
+	if( _histogramBinCount == binCount ) return;
+	_histogramBinCount = binCount;
+
+	// Recompute already computed histograms (the histogram deviation volume is updated in place)
+	_histogramVolumes.clear();
+	if( !_histogram.empty() ) this->computeHistograms();
+	this->trackMemory();
 }
-const std::map<Ensemble::Similarity, std::pair<Volume<float>, HCNode>>& Ensemble::Field::similarites() const
+int32_t Ensemble::Field::histogramBinCount() const noexcept
 {
-	return _similarities;
+	return _histogramBinCount;
 }
 
-HCNode Ensemble::Field::root( Ensemble::Similarity similarity, const Volume<float>& mask ) const
+void Ensemble::Field::setQuantileBudget( const statistics::QuantileBudget& budget )
 {
-	auto timer = util::timer();
+	if( budget.exactMemberCount < 0 || budget.sketchBins < 1 ) throw std::invalid_argument( "Ensemble::Field::setQuantileBudget( const statistics::QuantileBudget& ) -> Invalid budget." );
+	if( budget.exactMemberCount == _quantileBudget.exactMemberCount && budget.sketchBins == _quantileBudget.sketchBins ) return;
+	_quantileBudget = budget;
 
-	// Compute the similarity matrix and dendrogram using the specified similarity and only voxels where the mask is not zero
-	// TODO: somehow merge with functions computeFielSimilarity and computePearsonSimilarity (DON'T REPEAT YOURSELF)
+	// Recompute already computed quartiles (the quartile volumes are updated in place)
+	if( _stages.find( Stage::eQuartiles ) )
+	{
+		_stages.erase( Stage::eQuartiles );
+		this->computeStage( Stage::eQuartiles );
+	}
+}
+const statistics::QuantileBudget& Ensemble::Field::quantileBudget() const noexcept
+{
+	return _quantileBudget;
+}
 
-	auto similarityMatrix = Volume<float>( vec3i( this->memberCount(), this->memberCount(), 1 ), "Similarity" );
-	std::fill( similarityMatrix.begin(), similarityMatrix.end(), 1.0f );
+const HistogramVolume& Ensemble::Field::histogram() const
+{
+	this->computeStage( Stage::eHistograms );
+	return _histogram;
+}
+const Volume<float>& Ensemble::Field::histogramVolume( int32_t bin ) const
+{
+	if( bin < 0 || bin >= _histogramBinCount ) throw std::invalid_argument( "Ensemble::Field::histogramVolume( int32_t ) -> Invalid bin." );
 
-	auto voxels = std::vector<int32_t>();
-	for( int32_t i = 0; i < mask.voxelCount(); ++i ) if( mask.at( i ) ) voxels.push_back( i );
+	if( const auto volume = _histogramVolumes.find( bin ) )
+	{
+		util::memory_budget().touch( volume, util::MemoryBudget::Category::eHistogram );
+		return *volume;
+	}
 
-	if( similarity == Ensemble::Similarity::eField )
+	const auto& volume = _histogramVolumes.get( bin, [&]
 	{
-		util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
-		{
-			for( int32_t i = begin; i < end; ++i )
-			{
-				if( begin == 0 ) std::cout << "Calculating field similarity (" << 100.0 * i / end << " %)          \r";
-				for( int32_t j = i + 1; j < this->memberCount(); ++j )
-				{
-					const auto first = this->volume( i );
-					const auto second = this->volume( j );
+		// Name the volume after the z-score interval of the bin
+		const auto& histogram = this->histogram();
+		const auto& edges = histogram.edges();
+		const auto lower = bin == 0 ? QString( "[-inf" ) : "(" + QString::number( edges[bin - 1] );
+		const auto upper = bin == _histogramBinCount - 1 ? QString( "inf]" ) : QString::number( edges[bin] ) + "]";
 
-					const auto firstDomain = first.domain();
-					const auto secondDomain = second.domain();
+		auto volume = histogram.normalized( bin, u8"z\u2011scores\u00A0in " + lower + "," + upper );
 
-					const auto totalMin = std::min( firstDomain.x, secondDomain.x );
-					const auto totalMax = std::max( firstDomain.y, secondDomain.y );
-					const auto totalRange = totalMax - totalMin;
+		// Make sure that the domain will always use [0, 1] (e.g. on parallel coordinates axes)
+		volume.expandDomain( vec2f( 0.0f, 1.0f ) );
+		return volume;
+	} );
 
-					double numerator = 0.0, denominator = 0.0;
-					for( int32_t k : voxels )
-					{
-						const auto [min, max] = std::minmax( first.at( k ), second.at( k ) );
+	const auto lock = std::scoped_lock( _memoryMutex );
+	this->trackHistogramVolume( bin );
+	return volume;
+}
+
+vec3f Ensemble::Field::gradient( int32_t index ) const
+{
+	const auto& magnitudeVolume = this->volume( Derived::eGradientMagnitude );
+	switch( _gradientStorage )
+	{
+	case GradientStorage::eFloat:
+		return _volumeGradient.at( index );
+	case GradientStorage::eFloat16:
+	case GradientStorage::eSnorm8:
+		return _gradientNormals.get( index ) * magnitudeVolume.at( index );
+	default:
+	{
+		// Recompute the gradient from the mean volume, coordinates outside the volume are clamped (one-sided differences)
+		const auto& meanVolume = this->volume( Derived::eMean );
+		const auto dimensions = this->dimensions();
+		const auto voxel = vec3i( index / ( dimensions.y * dimensions.z ), ( index / dimensions.z ) % dimensions.y, index % dimensions.z );
+
+		auto gradient = vec3f();
+		for( int32_t i = 0; i < 3; ++i )
+		{
+			vec3i forwardVoxel = voxel, backwardVoxel = voxel;
+			forwardVoxel[i] = std::min( voxel[i] + 1, dimensions[i] - 1 );
+			backwardVoxel[i] = std::max( voxel[i] - 1, 0 );
+
+			const auto scale = ( voxel[i] == 0 || voxel[i] == dimensions[i] - 1 ) ? 1.0f : 0.5f;
+			gradient[i] = ( meanVolume.at( forwardVoxel ) - meanVolume.at( backwardVoxel ) ) * scale;
+		}
+		return gradient;
+	}
+	}
+}
+Volume<vec3f> Ensemble::Field::gradientVolume() const
+{
+	const auto& magnitudeVolume = this->volume( Derived::eGradientMagnitude );
+	if( _gradientStorage == GradientStorage::eFloat ) return _volumeGradient;
+
+	auto gradientVolume = Volume<vec3f>( this->dimensions(), "Gradient" );
+	if( _gradientStorage == GradientStorage::eOnDemand )
+	{
+		this->evaluateGradient( [&gradientVolume] ( int32_t index, int32_t count, const vec3f* gradients, const float* )
+		{
+			std::copy( gradients, gradients + count, gradientVolume.data() + index );
+		} );
+	}
+	else util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+	{
+		for( int32_t i = begin; i < end; ++i )
+			gradientVolume.at( i ) = _gradientNormals.get( i ) * magnitudeVolume.at( i );
+	} );
+	return gradientVolume;
+}
+const MemberBricks& Ensemble::Field::members() const noexcept
+{
+	return *_members;
+}
+
+const Volume<float>& Ensemble::Field::volume( int32_t index ) const
+{
+	// Member volumes of interleaved fields are extracted on demand. Concurrent requests may extract the same volume, only the first one is kept.
+	auto volume = std::atomic_load( &_volumes[index] );
+	if( !volume )
+	{
+		auto extracted = std::make_shared<Volume<float>>( _members->member( index ) );
+		extracted->setName( _name );
+		if( std::atomic_compare_exchange_strong( &_volumes[index], &volume, extracted ) )
+		{
+			volume = std::move( extracted );
+			const auto lock = std::scoped_lock( _memoryMutex );
+			this->trackVolume( index );
+		}
+	}
+	else util::memory_budget().touch( volume.get(), util::MemoryBudget::Category::eMemberVolume );
+	return *volume;
+}
+void Ensemble::Field::releaseVolumes( bool changed )
+{
+	// Pinned volumes (e.g. on screen) are kept, so references stay valid, and are updated in place if the values changed
+	const auto& budget = util::memory_budget();
+	for( int32_t i = 0; i < _volumes.size(); ++i ) if( const auto volume = std::atomic_load( &_volumes[i] ) )
+	{
+		if( !budget.pinned( volume.get() ) ) std::atomic_store( &_volumes[i], std::shared_ptr<Volume<float>>() );
+		else if( changed )
+		{
+			*volume = _members->member( i );
+			volume->setName( _name );
+		}
+	}
+}
+const Volume<float>& Ensemble::Field::volume( Ensemble::Derived derived ) const
+{
+	// Histogram bins are stored as counts and only normalized on request (the legacy identifiers refer to the first five bins)
+	if( derived >= Derived::eHist1 && derived <= Derived::eHist5 )
+	{
+		const auto bin = static_cast<int32_t>( derived ) - static_cast<int32_t>( Derived::eHist1 );
+		if( bin >= _histogramBinCount ) throw std::invalid_argument( "Ensemble::Field::volume( Ensemble::Derived ) -> The histogram has only " + std::to_string( _histogramBinCount ) + " bins." );
+		return this->histogramVolume( bin );
+	}
+
+	// Return requested volume. If its not available, compute it first (lazy evaluation)
+	if( const auto volume = _derivedVolumes.find( derived ) )
+	{
+		util::memory_budget().touch( volume, util::MemoryBudget::Category::eDerivedVolume );
+		return *volume;
+	}
+
+	this->computeStage( Field::stage( derived ) );
+	if( const auto volume = _derivedVolumes.find( derived ) ) return *volume;
+	throw std::invalid_argument( "Ensemble::Field::volume( Ensemble::Derived ) -> Invalid derived volume " + to_string( derived ).toStdString() + "." );
+}
+const LazyCache<Ensemble::Derived, Volume<float>>& Ensemble::Field::derivedVolumes() const noexcept
+{
+	return _derivedVolumes;
+}
+
+const HCNode& Ensemble::Field::root( Ensemble::Similarity similarity ) const
+{
+	// Return requested dendrogram. If its not available, compute it first (lazy evaluation)
+	if( const auto pair = _similarities.find( similarity ) ) return pair->second;
+
+	switch( similarity )
+	{
+	case Similarity::eField:
+		this->computeStage( Stage::eFieldSimilarity ); break;
+	case Similarity::ePearson:
+		this->computeStage( Stage::ePearsonSimilarity ); break;
+	}
+
+	if( const auto pair = _similarities.find( similarity ) ) return pair->second;
+	throw std::invalid_argument( "Ensemble::Field::root( Ensemble::Similarity ) -> Invalid similarity." );
+}
+const LazyCache<Ensemble::Similarity, std::pair<Volume<float>, HCNode>>& Ensemble::Field::similarites() const
+{
+	return _similarities;
+}
+
+HCNode Ensemble::Field::root( Ensemble::Similarity similarity, const Volume<float>& mask ) const
+{
+	auto timer = util::timer();
+
+	// Dendrograms of masks that were clustered before are read from the disk cache (keyed by the fingerprint of the mask)
+	const auto key = this->cacheKey( similarity == Similarity::eField ? Stage::eFieldSimilarity : Stage::ePearsonSimilarity, mask.fingerprint() );
+	auto dendrogram = HCNode();
+	if( key && util::disk_cache().load( key, [&dendrogram] ( std::istream& stream ) { dendrogram = HCNode( stream ); } ) )
+	{
+		std::cout << "Read cached dendrogram in " << timer.get() << " ms." << std::endl;
+		return dendrogram;
+	}
+
+	// Compute the similarity matrix and dendrogram using the specified similarity and only voxels where the mask is not zero
+	const auto similarityMatrix = this->similarityMatrix( similarity, &mask );
+	const auto similarityFunction = [&] ( int32_t first, int32_t second )
+	{
+		return similarityMatrix.at( vec3i( first, second, 0 ) );
+	};
+	dendrogram = HCNode( this->memberCount(), similarityFunction );
+	std::cout << "Finished clustering similarities in " << timer.get() << " ms." << std::endl;
+
+	if( key ) util::disk_cache().store( key, [&dendrogram] ( std::ostream& stream ) { dendrogram.save( stream ); } );
+	return dendrogram;
+}
+Ensemble::Field::PrincipalBasis Ensemble::Field::principalBasis( const Volume<float>* mask, int32_t componentCount, PCAMethod method ) const
+{
+	const auto memberCount = this->memberCount();
+	componentCount = std::min( memberCount, componentCount );
+	if( method == PCAMethod::eAutomatic ) method = memberCount > 64 ? PCAMethod::eRandomized : PCAMethod::eCovariance;
+
+	// Accumulate the mean and the product of the covariance matrix with 'right' (the lower triangle of the covariance matrix itself if 'right' is empty)
+	// brick by brick. Every task merges its bricks into its own moments, which are merged once per task using the parallel algorithm by Chan et al.
+	// (https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Parallel_algorithm)
+	struct Moments
+	{
+		double count = 0.0;
+		Eigen::VectorXd mean;
+		Eigen::MatrixXd product;
+	};
+	auto mean = Eigen::VectorXd();
+	auto count = 0.0;
+	const auto accumulate = [&] ( const Eigen::MatrixXd& right )
+	{
+		// Add the count and mean of values to moments (the product of the centered values is added separately)
+		const auto combine = [&right] ( Moments& moments, double count, const Eigen::VectorXd& mean )
+		{
+			const auto delta = ( mean - moments.mean ).eval();
+			const auto weight = moments.count * count / ( moments.count + count );
+			if( right.size() ) moments.product.noalias() += delta * ( delta.transpose() * right ) * weight;
+			else moments.product.selfadjointView<Eigen::Lower>().rankUpdate( delta, weight );
+			moments.mean += delta * ( count / ( moments.count + count ) );
+			moments.count += count;
+		};
+
+		const auto initial = Moments { 0.0, Eigen::VectorXd::Zero( memberCount ), Eigen::MatrixXd::Zero( memberCount, right.size() ? right.cols() : memberCount ) };
+		auto total = initial;
+		this->members().reduceBricks<Moments>( initial, [&] ( const MemberBricks::Brick& brick, Moments& partial )
+		{
+			// Interleaved brick values form a members x voxels matrix
+			const auto values = Eigen::Map<const Eigen::MatrixXf>( brick.values, brick.memberCount, brick.voxelCount ).cast<double>();
+			const auto brickMean = values.rowwise().mean().eval();
+			const auto centered = ( values.colwise() - brickMean ).eval();
+
+			if( right.size() ) partial.product.noalias() += centered * ( centered.transpose() * right );
+			else partial.product.selfadjointView<Eigen::Lower>().rankUpdate( centered );
+			combine( partial, static_cast<double>( brick.voxelCount ), brickMean );
+		}, [&] ( Moments& partial )
+		{
+			if( partial.count == 0.0 ) return;
+			total.product += partial.product;
+			combine( total, partial.count, partial.mean );
+		}, MemberBricks::Order::eInterleaved, mask );
+
+		mean = std::move( total.mean );
+		count = total.count;
+		return std::move( total.product );
+	};
+
+	// Compute the components with the largest eigenvalues (the variances are the eigenvalues of the covariance matrix divided by the voxel count)
+	auto components = Eigen::MatrixXd( memberCount, componentCount );
+	auto variances = Eigen::VectorXd( componentCount );
+	if( method == PCAMethod::eCovariance )
+	{
+		// Solve the symmetric eigenproblem of the covariance matrix (only the lower triangle is used)
+		const auto solver = Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd>( accumulate( Eigen::MatrixXd() ) );
+		components = solver.eigenvectors().rightCols( componentCount ).rowwise().reverse();
+		variances = solver.eigenvalues().tail( componentCount ).reverse();
+	}
+	else
+	{
+		// Randomized SVD (https://arxiv.org/abs/0909.4061): sample the range of the covariance matrix C using a Gaussian test matrix (first pass)
+		// and orthonormalize it to Q. The leading left singular vectors of C * Q (second pass) approximate the leading eigenvectors of C.
+		const auto sampleCount = std::min( memberCount, componentCount + 8 );
+		auto generator = std::mt19937( 0 );
+		auto distribution = std::normal_distribution<double>();
+		const auto test = Eigen::MatrixXd::NullaryExpr( memberCount, sampleCount, [&] { return distribution( generator ); } ).eval();
+
+		const auto basis = ( Eigen::HouseholderQR<Eigen::MatrixXd>( accumulate( test ) ).householderQ() * Eigen::MatrixXd::Identity( memberCount, sampleCount ) ).eval();
+		const auto svd = Eigen::JacobiSVD<Eigen::MatrixXd>( accumulate( basis ), Eigen::ComputeThinU );
+		components = svd.matrixU().leftCols( componentCount );
+		variances = svd.singularValues().head( componentCount );
+	}
+
+	// Choose the sign of every component such that its largest coefficient is positive
+	auto result = PrincipalBasis();
+	result.means = std::vector<float>( mean.data(), mean.data() + memberCount );
+	result.components = std::vector<float>( static_cast<size_t>( componentCount ) * memberCount );
+	result.variances = std::vector<float>( componentCount );
+	for( int32_t i = 0; i < componentCount; ++i )
+	{
+		auto index = Eigen::Index();
+		components.col( i ).cwiseAbs().maxCoeff( &index );
+		if( components( index, i ) < 0.0 ) components.col( i ) *= -1.0;
+
+		for( int32_t j = 0; j < memberCount; ++j ) result.components[static_cast<size_t>( i ) * memberCount + j] = static_cast<float>( components( j, i ) );
+		result.variances[i] = static_cast<float>( std::max( variances[i], 0.0 ) / std::max( count, 1.0 ) );
+	}
+	return result;
+}
+std::pair<Volume<float>, Volume<float>> Ensemble::Field::principalComponents( const Volume<float>* mask, PCAMethod method ) const
+{
+	// Compute the first two components (missing components of fields with a single member are zero)
+	const auto memberCount = this->memberCount();
+	const auto basis = this->principalBasis( mask, 2, method );
+	auto mutex = std::mutex();
+	auto projection = Eigen::MatrixXf::Zero( memberCount, 2 ).eval();
+	for( size_t i = 0; i < basis.variances.size(); ++i ) projection.col( i ) = Eigen::Map<const Eigen::VectorXf>( basis.components.data() + i * memberCount, memberCount );
+	const auto meanf = Eigen::Map<const Eigen::VectorXf>( basis.means.data(), memberCount );
+
+	auto pca1 = Volume<float>( this->dimensions(), "1st PC" );
+	auto pca2 = Volume<float>( this->dimensions(), "2nd PC" );
+
+	// Project the centered values of all voxels
+	auto minimum = Eigen::Vector2f::Constant( std::numeric_limits<float>::max() ).eval();
+	auto maximum = Eigen::Vector2f::Constant( std::numeric_limits<float>::lowest() ).eval();
+	this->members().forEachBrick( [&] ( const MemberBricks::Brick& brick )
+	{
+		const auto values = Eigen::Map<const Eigen::MatrixXf>( brick.values, brick.memberCount, brick.voxelCount );
+		const auto projected = ( projection.transpose() * ( values.colwise() - meanf ) ).eval();
+		for( int32_t i = 0; i < brick.voxelCount; ++i )
+		{
+			pca1.at( brick.voxels[i] ) = projected( 0, i );
+			pca2.at( brick.voxels[i] ) = projected( 1, i );
+		}
+
+		const auto lock = std::lock_guard( mutex );
+		minimum = minimum.cwiseMin( projected.rowwise().minCoeff() );
+		maximum = maximum.cwiseMax( projected.rowwise().maxCoeff() );
+	} );
+
+	// Normalize the values
+	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+	{
+		for( int32_t i = begin; i < end; ++i )
+		{
+			pca1.at( i ) = ( pca1.at( i ) - minimum.x() ) / ( maximum.x() - minimum.x() );
+			pca2.at( i ) = ( pca2.at( i ) - minimum.y() ) / ( maximum.y() - minimum.y() );
+		}
+	} );
 
-						numerator += 1.0 - ( max - totalMin ) / totalRange;
-						denominator += 1.0 - ( min - totalMin ) / totalRange;
+	return { std::move( pca1 ), std::move( pca2 ) };
+}
+Volume<float> Ensemble::Field::similarityMatrix( Ensemble::Similarity similarity, const Volume<float>* mask ) const
+{
+	const auto memberCount = this->memberCount();
+	const auto& members = this->members();
+	if( const auto lowRank = dynamic_cast<const LowRankMembers*>( &members ); lowRank && !mask ) return this->similarityMatrix( similarity, *lowRank );
+
+	auto similarityMatrix = Volume<float>( vec3i( memberCount, memberCount, 1 ), similarity == Similarity::eField ? "Field Similarity" : "Pearson Similarity" );
+	std::fill( similarityMatrix.begin(), similarityMatrix.end(), 1.0f );
+
+	// Both similarity measures are computed from sums over all (selected) voxels. Every brick is processed in member-major order and all member pairs
+	// are accumulated while the brick resides in the cache. Every task accumulates its bricks into its own sums, which are added to the total sums once.
+	struct Sums
+	{
+		int64_t voxelCount = 0;
+		std::vector<double> sums;
+		std::vector<float> minima, maxima;
+	};
+	const auto initial = Sums { 0, std::vector<double>( memberCount, 0.0 ), std::vector<float>( memberCount, std::numeric_limits<float>::max() ), std::vector<float>( memberCount, std::numeric_limits<float>::lowest() ) };
+	auto total = initial;
+	members.reduceBricks<Sums>( initial, [memberCount] ( const MemberBricks::Brick& brick, Sums& partial )
+	{
+		partial.voxelCount += brick.voxelCount;
+		for( int32_t i = 0; i < memberCount; ++i )
+		{
+			const auto values = brick.member( i );
+			auto sum = 0.0;
+			auto minimum = partial.minima[i], maximum = partial.maxima[i];
+			for( int32_t j = 0; j < brick.voxelCount; ++j )
+			{
+				sum += values[j];
+				minimum = std::min( minimum, values[j] );
+				maximum = std::max( maximum, values[j] );
+			}
+			partial.sums[i] += sum;
+			partial.minima[i] = minimum;
+			partial.maxima[i] = maximum;
+		}
+	}, [&total, memberCount] ( Sums& partial )
+	{
+		total.voxelCount += partial.voxelCount;
+		for( int32_t i = 0; i < memberCount; ++i )
+		{
+			total.sums[i] += partial.sums[i];
+			total.minima[i] = std::min( total.minima[i], partial.minima[i] );
+			total.maxima[i] = std::max( total.maxima[i], partial.maxima[i] );
+		}
+	}, MemberBricks::Order::eByMember, mask );
+	const auto voxelCount = total.voxelCount;
+	const auto& sums = total.sums;
+	auto& minima = total.minima;
+	auto& maxima = total.maxima;
+
+	// Sums over all member pairs (upper triangle), accumulated per task and added to the total sums once
+	const auto accumulatePairs = [&] ( const std::function<void( const MemberBricks::Brick&, std::vector<double>& )>& kernel )
+	{
+		const auto initial = std::vector<double>( static_cast<size_t>( memberCount ) * memberCount, 0.0 );
+		auto pairSums = initial;
+		members.reduceBricks<std::vector<double>>( initial, kernel, [&pairSums] ( std::vector<double>& partial )
+		{
+			for( size_t i = 0; i < partial.size(); ++i ) pairSums[i] += partial[i];
+		}, MemberBricks::Order::eByMember, mask );
+		return pairSums;
+	};
+
+	if( similarity == Ensemble::Similarity::eField )
+	{
+		// The domains of the members are always computed from all voxels
+		if( mask )
+		{
+			const auto domains = Sums { 0, {}, std::vector<float>( memberCount, std::numeric_limits<float>::max() ), std::vector<float>( memberCount, std::numeric_limits<float>::lowest() ) };
+			minima = domains.minima;
+			maxima = domains.maxima;
+			members.reduceBricks<Sums>( domains, [memberCount] ( const MemberBricks::Brick& brick, Sums& partial )
+			{
+				for( int32_t i = 0; i < brick.voxelCount; ++i )
+				{
+					const auto values = brick.voxel( i );
+					for( int32_t j = 0; j < memberCount; ++j )
+					{
+						partial.minima[j] = std::min( partial.minima[j], values[j] );
+						partial.maxima[j] = std::max( partial.maxima[j], values[j] );
 					}
-					const auto similarity = denominator ? ( numerator / denominator ) : 1.0;
-					similarityMatrix.at( vec3i( i, j, 0 ) ) = similarityMatrix.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
+				}
+			}, [&, memberCount] ( Sums& partial )
+			{
+				for( int32_t i = 0; i < memberCount; ++i )
+				{
+					minima[i] = std::min( minima[i], partial.minima[i] );
+					maxima[i] = std::max( maxima[i], partial.maxima[i] );
+				}
+			}, MemberBricks::Order::eInterleaved );
+		}
+
+		// Accumulate the sum over the voxel-wise maximum of every member pair
+		const auto maximumSums = accumulatePairs( [memberCount] ( const MemberBricks::Brick& brick, std::vector<double>& partial )
+		{
+			for( int32_t i = 0; i < memberCount; ++i )
+			{
+				const auto first = brick.member( i );
+				for( int32_t j = i + 1; j < memberCount; ++j )
+				{
+					const auto second = brick.member( j );
+
+					auto sum = 0.0;
+					for( int32_t k = 0; k < brick.voxelCount; ++k ) sum += std::max( first[k], second[k] );
+					partial[static_cast<size_t>( i ) * memberCount + j] += sum;
 				}
 			}
 		} );
+
+		// The field similarity sums 1 - (max - totalMin) / totalRange and 1 - (min - totalMin) / totalRange over all voxels. With the sums of the
+		// maxima and the sum of the minima (sum of both members minus sum of maxima), this can be evaluated without revisiting the voxels.
+		for( int32_t i = 0; i < memberCount; ++i )
+		{
+			for( int32_t j = i + 1; j < memberCount; ++j )
+			{
+				const auto totalMin = static_cast<double>( std::min( minima[i], minima[j] ) );
+				const auto totalRange = static_cast<double>( std::max( maxima[i], maxima[j] ) ) - totalMin;
+
+				const auto maximumSum = maximumSums[static_cast<size_t>( i ) * memberCount + j];
+				const auto minimumSum = sums[i] + sums[j] - maximumSum;
+
+				const auto numerator = voxelCount - ( maximumSum - voxelCount * totalMin ) / totalRange;
+				const auto denominator = voxelCount - ( minimumSum - voxelCount * totalMin ) / totalRange;
+
+				const auto similarity = ( totalRange == 0.0 || denominator == 0.0 ) ? 1.0 : ( numerator / denominator );
+				similarityMatrix.at( vec3i( i, j, 0 ) ) = similarityMatrix.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
+			}
+		}
 		std::cout << "Finished calculating field similarities!          " << std::endl;
 	}
 	else if( similarity == Ensemble::Similarity::ePearson )
 	{
+		auto means = std::vector<double>( memberCount );
+		for( int32_t i = 0; i < memberCount; ++i ) means[i] = sums[i] / voxelCount;
 
-		auto means = std::vector<double>( this->memberCount() );
-		auto stddevs = std::vector<double>( this->memberCount() );
-		util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
+		// Accumulate the products of the centered values of every member pair (the diagonal contains the squared standard deviations)
+		const auto products = accumulatePairs( [&means, memberCount] ( const MemberBricks::Brick& brick, std::vector<double>& partial )
 		{
-			for( int32_t i = begin; i < end; ++i )
+			thread_local auto centered = std::vector<double>();
+			centered.resize( static_cast<size_t>( memberCount ) * brick.voxelCount );
+			for( int32_t i = 0; i < memberCount; ++i )
 			{
-				const auto volume = this->volume( i );
-
-				auto& mean = means[i] = 0.0;
-				for( int32_t j : voxels ) mean += volume.at( j );
-				mean /= voxels.size();
+				const auto values = brick.member( i );
+				for( int32_t j = 0; j < brick.voxelCount; ++j ) centered[static_cast<size_t>( i ) * brick.voxelCount + j] = values[j] - means[i];
 			}
-		} );
-		util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
-		{
-			for( int32_t i = begin; i < end; ++i )
-			{
-				const auto volume = this->volume( i );
 
-				auto& stddev = stddevs[i] = 0.0;
-				for( int32_t j : voxels )
+			for( int32_t i = 0; i < memberCount; ++i )
+			{
+				const auto first = centered.data() + static_cast<size_t>( i ) * brick.voxelCount;
+				for( int32_t j = i; j < memberCount; ++j )
 				{
-					const auto v = ( volume.at( j ) - means[i] );
-					stddev += v * v;
+					const auto second = centered.data() + static_cast<size_t>( j ) * brick.voxelCount;
+
+					auto product = 0.0;
+					for( int32_t k = 0; k < brick.voxelCount; ++k ) product += first[k] * second[k];
+					partial[static_cast<size_t>( i ) * memberCount + j] += product;
 				}
-				stddev = std::sqrt( stddev );
 			}
 		} );
-		util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
+
+		for( int32_t i = 0; i < memberCount; ++i )
 		{
-			for( int32_t i = begin; i < end; ++i )
+			for( int32_t j = i + 1; j < memberCount; ++j )
 			{
-				if( begin == 0 ) std::cout << "Calculating pearson similarity (" << 100.0 * i / end << " %)          \r";
-				for( int32_t j = i + 1; j < this->memberCount(); ++j )
-				{
-					const auto first = this->volume( i );
-					const auto second = this->volume( j );
+				const auto firstStddev = std::sqrt( products[static_cast<size_t>( i ) * memberCount + i] );
+				const auto secondStddev = std::sqrt( products[static_cast<size_t>( j ) * memberCount + j] );
 
-					auto correlation = 0.0;
-					for( int32_t k : voxels )
-						correlation += ( first.at( k ) - means[i] ) * ( second.at( k ) - means[j] );
-					correlation = ( stddevs[i] == 0.0 && stddevs[j] == 0.0 ) ? 1.0 : ( correlation / ( stddevs[i] * stddevs[j] ) );
+				auto correlation = products[static_cast<size_t>( i ) * memberCount + j];
+				correlation = ( firstStddev == 0.0 && secondStddev == 0.0 ) ? 1.0 : ( correlation / ( firstStddev * secondStddev ) );
 
-					const auto similarity = ( correlation + 1.0 ) / 2.0;
-					similarityMatrix.at( vec3i( i, j, 0 ) ) = similarityMatrix.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
-				}
+				const auto similarity = ( correlation + 1.0 ) / 2.0;
+				similarityMatrix.at( vec3i( i, j, 0 ) ) = similarityMatrix.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
 			}
-		} );
+		}
 		std::cout << "Finished calculating pearson similarities!          " << std::endl;
 	}
 
-	const auto similarityFunction = [&] ( int32_t first, int32_t second )
+	return similarityMatrix;
+}
+Volume<float> Ensemble::Field::similarityMatrix( Ensemble::Similarity similarity, const LowRankMembers& members ) const
+{
+	const auto memberCount = members.memberCount();
+	const auto voxelCount = static_cast<double>( members.voxelCount() );
+	const auto& means = members.means();
+	const auto& variances = members.variances();
+
+	auto similarityMatrix = Volume<float>( vec3i( memberCount, memberCount, 1 ), similarity == Similarity::eField ? "Field Similarity" : "Pearson Similarity" );
+	std::fill( similarityMatrix.begin(), similarityMatrix.end(), 1.0f );
+
+	// The projections onto the components are uncorrelated with zero mean, so the (per-voxel) covariance of two members and the variance of their difference
+	// follow from the coefficients and the variances of the components
+	const auto covariance = [&] ( int32_t first, int32_t second )
 	{
-		return similarityMatrix.at( vec3i( first, second, 0 ) );
+		auto sum = 0.0;
+		for( int32_t c = 0; c < members.rank(); ++c ) sum += static_cast<double>( variances[c] ) * members.coefficients( c )[first] * members.coefficients( c )[second];
+		return sum;
+	};
+	const auto differenceVariance = [&] ( int32_t first, int32_t second )
+	{
+		auto sum = 0.0;
+		for( int32_t c = 0; c < members.rank(); ++c )
+		{
+			const auto difference = static_cast<double>( members.coefficients( c )[first] ) - members.coefficients( c )[second];
+			sum += variances[c] * difference * difference;
+		}
+		return sum;
 	};
-	auto dendrogram = HCNode( this->memberCount(), similarityFunction );
-	std::cout << "Finished clustering similarities in " << timer.get() << " ms." << std::endl;
 
-	return dendrogram;
+	if( similarity == Ensemble::Similarity::eField )
+	{
+		// The sum of the maxima is (sum of both members + sum of absolute differences) / 2. The differences are approximated by a normal distribution,
+		// so the mean absolute difference is the mean of the folded normal distribution (https://en.wikipedia.org/wiki/Folded_normal_distribution).
+		for( int32_t i = 0; i < memberCount; ++i )
+		{
+			for( int32_t j = i + 1; j < memberCount; ++j )
+			{
+				const auto delta = static_cast<double>( means[i] ) - means[j];
+				const auto deviation = std::sqrt( differenceVariance( i, j ) );
+				const auto absoluteDifference = deviation == 0.0 ? std::abs( delta ) :
+					deviation * std::sqrt( 2.0 / M_PI ) * std::exp( -delta * delta / ( 2.0 * deviation * deviation ) ) + delta * std::erf( delta / ( deviation * std::sqrt( 2.0 ) ) );
+
+				const auto first = members.domain( i ), second = members.domain( j );
+				const auto totalMin = static_cast<double>( std::min( first.x, second.x ) );
+				const auto totalRange = static_cast<double>( std::max( first.y, second.y ) ) - totalMin;
+
+				const auto maximumSum = voxelCount * ( means[i] + means[j] + absoluteDifference ) / 2.0;
+				const auto minimumSum = voxelCount * ( means[i] + means[j] ) - maximumSum;
+
+				const auto numerator = voxelCount - ( maximumSum - voxelCount * totalMin ) / totalRange;
+				const auto denominator = voxelCount - ( minimumSum - voxelCount * totalMin ) / totalRange;
+
+				const auto similarity = ( totalRange == 0.0 || denominator == 0.0 ) ? 1.0 : ( numerator / denominator );
+				similarityMatrix.at( vec3i( i, j, 0 ) ) = similarityMatrix.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
+			}
+		}
+		std::cout << "Finished approximating field similarities!          " << std::endl;
+	}
+	else if( similarity == Ensemble::Similarity::ePearson )
+	{
+		for( int32_t i = 0; i < memberCount; ++i )
+		{
+			for( int32_t j = i + 1; j < memberCount; ++j )
+			{
+				const auto firstStddev = std::sqrt( covariance( i, i ) );
+				const auto secondStddev = std::sqrt( covariance( j, j ) );
+
+				auto correlation = covariance( i, j );
+				correlation = ( firstStddev == 0.0 && secondStddev == 0.0 ) ? 1.0 : ( correlation / ( firstStddev * secondStddev ) );
+
+				const auto similarity = ( correlation + 1.0 ) / 2.0;
+				similarityMatrix.at( vec3i( i, j, 0 ) ) = similarityMatrix.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
+			}
+		}
+		std::cout << "Finished approximating pearson similarities!          " << std::endl;
+	}
+
+	return similarityMatrix;
+}
+
+void Ensemble::Field::computeDerivedVolumes( bool volumes, bool similarities ) const
+{
+	// Declare the stages and the stages they depend on
+	auto graph = std::vector<util::GraphNode>();
+	const auto stage = [&graph] ( std::function<void()> task, std::vector<int32_t> dependencies = {} )
+	{
+		graph.push_back( util::GraphNode { std::move( task ), std::move( dependencies ) } );
+		return static_cast<int32_t>( graph.size() ) - 1;
+	};
+	if( volumes )
+	{
+		stage( [this] { this->computeStage( Stage::eMinimumMaximum ); } );
+		const auto meanStddev = stage( [this] { this->computeStage( Stage::eMeanStddev ); } );
+		stage( [this] { this->computeStage( Stage::eGradient ); }, { meanStddev } );
+		stage( [this] { this->computeStage( Stage::ePrincipalComponents ); } );
+		stage( [this] { this->computeStage( Stage::eHistograms ); }, { meanStddev } );
+		stage( [this] { this->computeStage( Stage::eAndersonDarling ); }, { meanStddev } );
+	}
+	if( similarities )
+	{
+		stage( [this] { this->computeStage( Stage::eFieldSimilarity ); } );
+		stage( [this] { this->computeStage( Stage::ePearsonSimilarity ); } );
+	}
+
+	util::compute_graph( graph );
 }
+Ensemble::Field::Stage Ensemble::Field::stage( Ensemble::Derived derived )
+{
+	switch( derived )
+	{
+	case Derived::eMinimum:
+	case Derived::eMaximum:
+		return Stage::eMinimumMaximum;
+	case Derived::eMean:
+	case Derived::eStddev:
+		return Stage::eMeanStddev;
+	case Derived::eGradientMagnitude:
+		return Stage::eGradient;
+	case Derived::ePCA1:
+	case Derived::ePCA2:
+		return Stage::ePrincipalComponents;
+	case Derived::eHistDeviation:
+		return Stage::eHistograms;
+	case Derived::eAndersonDarling:
+		return Stage::eAndersonDarling;
+	case Derived::eMedian:
+	case Derived::eLowerQuartile:
+	case Derived::eUpperQuartile:
+	case Derived::eInterquartileRange:
+		return Stage::eQuartiles;
+	case Derived::eLabel:
+		throw std::invalid_argument( "Ensemble::Field::volume( Ensemble::Derived ) -> Ensemble::Derived::eLabel is an invalid argument." );
+	default:
+		throw std::invalid_argument( "Ensemble::Field::stage( Ensemble::Derived ) -> Invalid derived volume " + to_string( derived ).toStdString() + "." );
+	}
+}
+void Ensemble::Field::computeStage( Ensemble::Field::Stage stage ) const
+{
+	auto computed = false;
+	_stages.get( stage, [this, stage, &computed]
+	{
+		auto timer = util::timer();
+		computed = true;
+		if( this->loadStage( stage ) ) return timer.get();
 
+		switch( stage )
+		{
+		case Stage::eMinimumMaximum: this->computeMinimumMaximum(); break;
+		case Stage::eMeanStddev: this->computeMeanStddev(); break;
+		case Stage::eGradient: this->computeGradient(); break;
+		case Stage::ePrincipalComponents: this->computePrincipalComponents(); break;
+		case Stage::eHistograms: this->computeHistograms(); break;
+		case Stage::eAndersonDarling: this->computeAndersonDarling(); break;
+		case Stage::eQuartiles: this->computeQuartiles(); break;
+		case Stage::eFieldSimilarity: this->computeFieldSimilarity(); break;
+		case Stage::ePearsonSimilarity: this->computePearsonSimilarity(); break;
+		}
+		this->storeStage( stage );
+		return timer.get();
+	} );
+	if( computed )
+	{
+		const auto lock = std::scoped_lock( _memoryMutex );
+		this->trackMembers();
+		this->trackStage( stage );
+	}
+}
+void Ensemble::Field::recomputeStages()
+{
+	// The fingerprint is computed again (virtual fields set it from their inputs) and the stages of derived data that was already computed (or loaded) are run again
+	if( _storage != Storage::eVirtual ) _fingerprint = 0;
+	auto stages = std::set<Stage>();
+	_derivedVolumes.forEach( [&stages] ( Derived derived, const Volume<float>& ) { stages.insert( Field::stage( derived ) ); } );
+	_similarities.forEach( [&stages] ( Similarity similarity, const std::pair<Volume<float>, HCNode>& )
+	{
+		stages.insert( similarity == Similarity::eField ? Stage::eFieldSimilarity : Stage::ePearsonSimilarity );
+	} );
+	if( !_histogram.empty() ) stages.insert( Stage::eHistograms );
+	if( stages.empty() )
+	{
+		_mappedGradient = Volume<vec3f>();
+		return;
+	}
+
+	// The field of the recomputation shares the members and the parameters, it is owned by the recomputation, so this field can be moved meanwhile
+	auto field = std::make_unique<Field>( _name );
+	field->_storage = _storage;
+	field->_members = _members;
+	field->_lossy = _lossy;
+	field->_volumes = std::vector<std::shared_ptr<Volume<float>>>( _volumes.size() );
+	field->_histogramBinCount = _histogramBinCount;
+	field->_quantileBudget = _quantileBudget;
+	field->_gradientStorage = _gradientStorage;
+	field->_fingerprint = _fingerprint.load();
+	field->_evictable = false;
+
+	_recomputation = std::make_unique<Recomputation>();
+	_recomputation->field = std::move( field );
+	_recomputation->stages = std::move( stages );
+	_recomputation->finished = std::async( std::launch::async, [recomputation = _recomputation.get()]
+	{
+		for( const auto stage : recomputation->stages ) if( !recomputation->cancelled ) recomputation->field->computeStage( stage );
+	} );
+}
+bool Ensemble::Field::cancelRecomputation()
+{
+	if( !_recomputation ) return false;
+	_recomputation->cancelled = true;
+	_recomputation->finished.wait();
+	_recomputation.reset();
+	return true;
+}
+bool Ensemble::Field::applyRecomputedStages( bool wait )
+{
+	if( !_recomputation ) return true;
+	if( !wait && _recomputation->finished.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready ) return false;
+
+	const auto recomputation = std::move( _recomputation );
+	auto exception = std::exception_ptr();
+	try { recomputation->finished.get(); } catch( ... ) { exception = std::current_exception(); }
+
+	// Replace the derived data in place, so references to it stay valid. Results that are missing (evicted or failed) or were computed with parameters
+	// that changed meanwhile are dropped like evicted data and computed again on demand.
+	auto& field = *recomputation->field;
+	field.untrackMemory();
+	_mappedGradient = Volume<vec3f>();
+	for( const auto stage : recomputation->stages )
+	{
+		const auto duration = field._stages.find( stage );
+		const auto valid = duration && field.stageParameters( stage ) == this->stageParameters( stage );
+		for( const auto derived : Field::stageVolumes( stage ) )
+		{
+			const auto volume = field._derivedVolumes.find( derived );
+			if( valid && volume ) _derivedVolumes.set( derived, std::move( const_cast<Volume<float>&>( *volume ) ) );
+			else if( _derivedVolumes.find( derived ) )
+			{
+				_derivedVolumes.erase( derived );
+				const auto lock = std::scoped_lock( _memoryMutex );
+				_evictedVolumes.insert( derived );
+			}
+		}
+		if( stage == Stage::eFieldSimilarity || stage == Stage::ePearsonSimilarity )
+		{
+			const auto similarity = stage == Stage::eFieldSimilarity ? Similarity::eField : Similarity::ePearson;
+			const auto pair = field._similarities.find( similarity );
+			if( valid && pair ) _similarities.set( similarity, std::move( const_cast<std::pair<Volume<float>, HCNode>&>( *pair ) ) );
+			else _similarities.erase( similarity );
+		}
+		if( stage == Stage::eHistograms )
+		{
+			_histogram = valid ? std::move( field._histogram ) : HistogramVolume();
+			_histogramVolumes.clear();
+		}
+		if( stage == Stage::eGradient && valid )
+		{
+			if( field._gradientStorage == _gradientStorage )
+			{
+				_volumeGradient = std::move( field._volumeGradient );
+				_gradientNormals = std::move( field._gradientNormals );
+			}
+			else this->storeGradient( field.gradientVolume() );
+		}
+
+		if( valid ) _stages.set( stage, *duration );
+		else _stages.erase( stage );
+	}
+	this->trackMemory();
+
+	if( exception ) std::rethrow_exception( exception );
+	return true;
+}
+uint64_t Ensemble::Field::cacheKey( Ensemble::Field::Stage stage, uint64_t parameters ) const
+{
+	// Single passes over the members (minimum, maximum, mean, ...) are about as fast as reading their results
+	if( !util::disk_cache().enabled() || !_members ) return 0;
+	switch( stage )
+	{
+	case Stage::eMinimumMaximum:
+	case Stage::eMeanStddev:
+	case Stage::eGradient:
+		return 0;
+	default:
+		auto key = fingerprint::combine( fingerprint::combine( fingerprint::combine( this->fingerprint(), CacheVersion ), stage ), parameters );
+
+		// Similarities of low-rank members are approximated, so they are kept apart from the exact similarities of the same values
+		const auto similarity = stage == Stage::eFieldSimilarity || stage == Stage::ePearsonSimilarity;
+		if( similarity && dynamic_cast<const LowRankMembers*>( _members.get() ) ) key = fingerprint::combine( key, Storage::eLowRank );
+		return std::max<uint64_t>( key, 1 );
+	}
+}
+uint64_t Ensemble::Field::stageParameters( Ensemble::Field::Stage stage ) const
+{
+	if( stage == Stage::eHistograms ) return _histogramBinCount;
+	if( stage == Stage::eQuartiles ) return fingerprint::combine( fingerprint::combine( 0, _quantileBudget.exactMemberCount ), _quantileBudget.sketchBins );
+	return 0;
+}
+bool Ensemble::Field::loadStage( Ensemble::Field::Stage stage ) const
+{
+	const auto key = this->cacheKey( stage, this->stageParameters( stage ) );
+	if( !key ) return false;
+
+	auto timer = util::timer();
+	const auto loaded = util::disk_cache().load( key, [&] ( std::istream& stream )
+	{
+		// Read all results first, so invalid entries don't leave partial results
+		auto volumes = std::vector<std::pair<Derived, Volume<float>>>();
+		for( const auto derived : Field::stageVolumes( stage ) ) volumes.emplace_back( derived, Volume<float>( stream ) );
+		auto histogram = stage == Stage::eHistograms ? HistogramVolume( stream ) : HistogramVolume();
+		auto similarity = std::optional<std::pair<Volume<float>, HCNode>>();
+		if( stage == Stage::eFieldSimilarity || stage == Stage::ePearsonSimilarity )
+		{
+			auto matrix = Volume<float>( stream );
+			similarity.emplace( std::move( matrix ), HCNode( stream ) );
+		}
+		if( !stream ) throw std::runtime_error( "Ensemble::Field::loadStage -> Entry is truncated." );
+
+		for( auto& [derived, volume] : volumes ) _derivedVolumes.set( derived, std::move( volume ) );
+		if( stage == Stage::eHistograms ) _histogram = std::move( histogram );
+		if( similarity ) _similarities.set( stage == Stage::eFieldSimilarity ? Similarity::eField : Similarity::ePearson, std::move( *similarity ) );
+	} );
+	if( loaded ) std::cout << "Read cached results of field " << _name.toStdString() << " in " << timer.get() << " ms." << std::endl;
+	return loaded;
+}
+void Ensemble::Field::storeStage( Ensemble::Field::Stage stage ) const
+{
+	const auto key = this->cacheKey( stage, this->stageParameters( stage ) );
+	if( !key ) return;
+
+	util::disk_cache().store( key, [&] ( std::ostream& stream )
+	{
+		for( const auto derived : Field::stageVolumes( stage ) ) _derivedVolumes.find( derived )->save( stream );
+		if( stage == Stage::eHistograms ) _histogram.save( stream );
+		if( stage == Stage::eFieldSimilarity || stage == Stage::ePearsonSimilarity )
+		{
+			const auto pair = _similarities.find( stage == Stage::eFieldSimilarity ? Similarity::eField : Similarity::ePearson );
+			pair->first.save( stream );
+			pair->second.save( stream );
+		}
+	} );
+}
+uint64_t Ensemble::Field::fingerprint( const std::vector<const Ensemble::Field*>& inputs, const Expression& expression )
+{
+	// The members aren't evaluated
+	const auto source = expression.source().toStdString();
+	auto hash = fingerprint::xxh64( source.data(), source.size() );
+	for( const auto input : inputs ) hash = fingerprint::combine( hash, input->fingerprint() );
+	return std::max<uint64_t>( hash, 1 );
+}
+std::vector<Ensemble::Derived> Ensemble::Field::stageVolumes( Ensemble::Field::Stage stage )
+{
+	switch( stage )
+	{
+	case Stage::eMinimumMaximum: return { Derived::eMinimum, Derived::eMaximum };
+	case Stage::eMeanStddev: return { Derived::eMean, Derived::eStddev };
+	case Stage::eGradient: return { Derived::eGradientMagnitude };
+	case Stage::ePrincipalComponents: return { Derived::ePCA1, Derived::ePCA2 };
+	case Stage::eHistograms: return { Derived::eHistDeviation };
+	case Stage::eAndersonDarling: return { Derived::eAndersonDarling };
+	case Stage::eQuartiles: return { Derived::eLowerQuartile, Derived::eMedian, Derived::eUpperQuartile, Derived::eInterquartileRange };
+	default: return {};
+	}
+}
+void Ensemble::Field::trackMemory() const
+{
+	// Register all cached data again and remove the entries of data that no longer exists
+	const auto lock = std::scoped_lock( _memoryMutex );
+	auto previous = std::exchange( _trackedMemory, {} );
+
+	this->trackMembers();
+	for( int32_t i = 0; i < _volumes.size(); ++i ) this->trackVolume( i );
+	for( auto stage = Stage::eMinimumMaximum; stage <= Stage::ePearsonSimilarity; stage = static_cast<Stage>( static_cast<int32_t>( stage ) + 1 ) ) this->trackStage( stage );
+	_histogramVolumes.forEach( [this] ( int32_t bin, const Volume<float>& ) { this->trackHistogramVolume( bin ); } );
+
+	for( const auto& [owner, category] : previous )
+	{
+		const auto it = _trackedMemory.find( owner );
+		if( it == _trackedMemory.end() || it->second != category ) util::memory_budget().remove( owner, category );
+	}
+}
+void Ensemble::Field::untrackMemory() const
+{
+	const auto lock = std::scoped_lock( _memoryMutex );
+	for( const auto& [owner, category] : _trackedMemory ) util::memory_budget().remove( owner, category );
+	_trackedMemory.clear();
+}
+void Ensemble::Field::track( const void* owner, util::MemoryBudget::Category category, size_t bytes, double cost, std::function<void()> evict ) const
+{
+	const auto [it, inserted] = _trackedMemory.try_emplace( owner, category );
+	if( !inserted && it->second != category ) util::memory_budget().remove( owner, std::exchange( it->second, category ) );
+	util::memory_budget().add( owner, category, bytes, cost, _evictable ? std::move( evict ) : std::function<void()>() );
+}
+void Ensemble::Field::trackMembers() const
+{
+	// The storage of the members is only accounted (it is replaced explicitly, see setStorage), members of other fields are not counted
+	if( !_members ) return;
+	if( const auto bytes = _members->residentBytes() ) this->track( _members.get(), util::MemoryBudget::Category::eMembers, bytes, 0.0, {} );
+}
+void Ensemble::Field::trackVolume( int32_t index ) const
+{
+	// Member volumes of interleaved and virtual fields are extracted again on demand
+	const auto volume = std::atomic_load( &_volumes[index] );
+	if( _storage == Storage::eVolumes || !volume ) return;
+
+	const auto bytes = static_cast<size_t>( volume->voxelCount() ) * sizeof( float );
+	this->track( volume.get(), util::MemoryBudget::Category::eMemberVolume, bytes, bytes * 1e-6, [this, index, owner = volume.get()]
+	{
+		auto released = std::shared_ptr<Volume<float>>();
+		const auto lock = std::scoped_lock( _memoryMutex );
+		_trackedMemory.erase( owner );
+		if( std::atomic_load( &_volumes[index] ).get() == owner ) released = std::atomic_exchange( &_volumes[index], std::move( released ) );
+	} );
+}
+void Ensemble::Field::trackStage( Ensemble::Field::Stage stage ) const
+{
+	using Category = util::MemoryBudget::Category;
+
+	// Data that was loaded from a file has no measured cost, so estimate it from the number of values that are processed (1e8 per second)
+	const auto duration = _stages.find( stage );
+	const auto cost = duration ? *duration : static_cast<double>( this->voxelCount() ) * this->memberCount() * 1e-5;
+
+	// Derived volumes are recomputed by their stage (volumes of the same stage are replaced in place), volumes that wrap a mapped file are not tracked
+	for( const auto derived : Field::stageVolumes( stage ) ) if( const auto volume = _derivedVolumes.find( derived ) )
+	{
+		_evictedVolumes.erase( derived );
+		if( volume->wrapped() ) continue;
+		this->track( volume, Category::eDerivedVolume, static_cast<size_t>( volume->voxelCount() ) * sizeof( float ), cost, [this, volume, derived, stage]
+		{
+			{
+				const auto lock = std::scoped_lock( _memoryMutex );
+				_trackedMemory.erase( volume );
+				_evictedVolumes.insert( derived );
+			}
+			_derivedVolumes.erase( derived );
+			_stages.erase( stage );
+		} );
+	}
+
+	// Histogram counts are recomputed by their stage
+	if( stage == Stage::eHistograms && !_histogram.empty() ) this->track( &_histogram, Category::eHistogram, _histogram.bytes(), cost, [this]
+	{
+		{
+			const auto lock = std::scoped_lock( _memoryMutex );
+			_trackedMemory.erase( &_histogram );
+		}
+		_histogram = HistogramVolume();
+		_stages.erase( Stage::eHistograms );
+	} );
+
+	// Similarity matrices and stored gradients are only accounted (the dendrograms are referenced, the gradient storage is chosen explicitly)
+	if( stage == Stage::eFieldSimilarity || stage == Stage::ePearsonSimilarity )
+	{
+		const auto pair = _similarities.find( stage == Stage::eFieldSimilarity ? Similarity::eField : Similarity::ePearson );
+		if( pair && !pair->first.wrapped() ) this->track( &pair->first, Category::eSimilarity, static_cast<size_t>( pair->first.voxelCount() ) * sizeof( float ), 0.0, {} );
+	}
+	if( stage == Stage::eGradient )
+	{
+		if( _volumeGradient.voxelCount() && !_volumeGradient.wrapped() ) this->track( &_volumeGradient, Category::eGradient, static_cast<size_t>( _volumeGradient.voxelCount() ) * sizeof( vec3f ), 0.0, {} );
+		if( !_gradientNormals.empty() ) this->track( &_gradientNormals, Category::eGradient, _gradientNormals.bytes(), 0.0, {} );
+	}
+}
+void Ensemble::Field::trackHistogramVolume( int32_t bin ) const
+{
+	// Normalized histogram bins are computed again from the counts
+	const auto volume = _histogramVolumes.find( bin );
+	if( !volume ) return;
+	this->track( volume, util::MemoryBudget::Category::eHistogram, static_cast<size_t>( volume->voxelCount() ) * sizeof( float ), volume->voxelCount() * 1e-5, [this, bin, volume]
+	{
+		{
+			const auto lock = std::scoped_lock( _memoryMutex );
+			_trackedMemory.erase( volume );
+		}
+		_histogramVolumes.erase( bin );
+	} );
+}
 void Ensemble::Field::computeMinimumMaximum() const
 {
 	auto timer = util::timer();
-	auto& minVolume = _derivedVolumes[Derived::eMinimum] = Volume<float>( this->dimensions(), "Minimum" );
-	auto& maxVolume = _derivedVolumes[Derived::eMaximum] = Volume<float>( this->dimensions(), "Maximum" );
+	auto minVolume = Volume<float>( this->dimensions(), "Minimum" );
+	auto maxVolume = Volume<float>( this->dimensions(), "Maximum" );
 
-	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+	this->members().forEachBrick( [&] ( const MemberBricks::Brick& brick )
 	{
-		for( int32_t i = begin; i < end; ++i )
+		for( int32_t i = 0; i < brick.voxelCount; ++i )
 		{
-			auto& min = minVolume.at( i ) = std::numeric_limits<float>::max();
-			auto& max = maxVolume.at( i ) = std::numeric_limits<float>::lowest();
+			const auto values = brick.voxel( i );
 
-			for( int32_t j = 0; j < this->memberCount(); ++j )
+			auto min = std::numeric_limits<float>::max();
+			auto max = std::numeric_limits<float>::lowest();
+			for( int32_t j = 0; j < brick.memberCount; ++j )
 			{
-				const auto value = this->volume( j ).at( i );
-				min = std::min( min, value );
-				max = std::max( max, value );
+				min = std::min( min, values[j] );
+				max = std::max( max, values[j] );
 			}
+
+			minVolume.at( brick.voxels[i] ) = min;
+			maxVolume.at( brick.voxels[i] ) = max;
 		}
 	} );
+	_derivedVolumes.set( Derived::eMinimum, std::move( minVolume ) );
+	_derivedVolumes.set( Derived::eMaximum, std::move( maxVolume ) );
 
 	std::cout << "Finished computing minimum and maximum volumes in " << timer.get() << " ms." << std::endl;
 }
@@ -885,84 +2395,97 @@ void Ensemble::Field::computeMeanStddev() const
 {
 	auto timer = util::timer();
 
-	auto& meanVolume = _derivedVolumes[Derived::eMean] = Volume<float>( this->dimensions(), "Mean" );
-	auto& stddevVolume = _derivedVolumes[Derived::eStddev] = Volume<float>( this->dimensions(), "Stddev" );
+	auto meanVolume = Volume<float>( this->dimensions(), "Mean" );
+	auto stddevVolume = Volume<float>( this->dimensions(), "Stddev" );
 
-	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+	this->members().forEachBrick( [&] ( const MemberBricks::Brick& brick )
 	{
-		for( int32_t i = begin; i < end; ++i )
+		for( int32_t i = 0; i < brick.voxelCount; ++i )
 		{
+			const auto values = brick.voxel( i );
+
 			double mean = 0.0;
-			for( int32_t j = 0; j < this->memberCount(); ++j )
-				mean += this->volume( j ).at( i );
-			mean /= this->memberCount();
+			for( int32_t j = 0; j < brick.memberCount; ++j ) mean += values[j];
+			mean /= brick.memberCount;
 
-			meanVolume.at( i ) = static_cast<float>( mean );
-		}
-	} );
-	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
-	{
-		for( int32_t i = begin; i < end; ++i )
-		{
+			const auto meanValue = static_cast<float>( mean );
 			double stddev = 0.0;
-			for( int32_t j = 0; j < this->memberCount(); ++j )
+			for( int32_t j = 0; j < brick.memberCount; ++j )
 			{
-				const auto value = this->volume( j ).at( i ) - meanVolume.at( i );
+				const auto value = values[j] - meanValue;
 				stddev += value * value;
 			}
-			stddev = std::sqrt( stddev / this->memberCount() );
+			stddev = std::sqrt( stddev / brick.memberCount );
 
-			stddevVolume.at( i ) = static_cast<float>( stddev );
+			meanVolume.at( brick.voxels[i] ) = meanValue;
+			stddevVolume.at( brick.voxels[i] ) = static_cast<float>( stddev );
 		}
 	} );
+	_derivedVolumes.set( Derived::eMean, std::move( meanVolume ) );
+	_derivedVolumes.set( Derived::eStddev, std::move( stddevVolume ) );
 
 	std::cout << "Finished computing mean and stddev volumes in " << timer.get() << " ms." << std::endl;
 }
-void Ensemble::Field::computeGradient() const
+void Ensemble::Field::evaluateGradient( const std::function<void( int32_t index, int32_t count, const vec3f* gradients, const float* magnitudes )>& kernel ) const
 {
-	const auto timeBegin = std::chrono::high_resolution_clock::now();
 	const auto& meanVolume = this->volume( Derived::eMean );
+	const auto dimensions = this->dimensions();
 
-	_volumeGradient = Volume<vec3f>( this->dimensions(), "Gradient" );
-	auto& magnitudeVolume = _derivedVolumes[Derived::eGradientMagnitude] = Volume<float>( this->dimensions(), "Gradient Magnitude" );
+	stencil::apply<1>( meanVolume, [&] ( const stencil::Row& row )
+	{
+		// Central differences, the halo is clamped to the border so only the divisor changes for one-sided differences
+		const auto scaleX = ( row.voxel.x == 0 || row.voxel.x == dimensions.x - 1 ) ? 1.0f : 0.5f;
+		const auto scaleY = ( row.voxel.y == 0 || row.voxel.y == dimensions.y - 1 ) ? 1.0f : 0.5f;
+		const auto z = row.z();
+		const auto scaleZ = simd::select( z < 0.5f, 1.0f, simd::select( dimensions.z - 1.5f < z, 1.0f, 0.5f ) );
+
+		const auto gx = ( row.at( 1, 0, 0 ) - row.at( -1, 0, 0 ) ) * scaleX;
+		const auto gy = ( row.at( 0, 1, 0 ) - row.at( 0, -1, 0 ) ) * scaleY;
+		const auto gz = ( row.at( 0, 0, 1 ) - row.at( 0, 0, -1 ) ) * scaleZ;
+
+		float x[simd::Width], y[simd::Width], magnitudes[simd::Width];
+		vec3f gradients[simd::Width];
+		gx.store( x );
+		gy.store( y );
+		gz.store( magnitudes );
+		for( int32_t i = 0; i < row.count; ++i ) gradients[i] = vec3f( x[i], y[i], magnitudes[i] );
+		simd::sqrt( gx * gx + gy * gy + gz * gz ).store( magnitudes );
+
+		kernel( row.index, row.count, gradients, magnitudes );
+	} );
+}
+void Ensemble::Field::storeGradient( const Volume<vec3f>& gradient ) const
+{
+	_volumeGradient = Volume<vec3f>();
+	_gradientNormals = NormalVolume();
 
-	util::compute_multi_threaded( 0, this->dimensions().x, [&] ( int32_t begin, int32_t end )
+	if( _gradientStorage == GradientStorage::eFloat ) _volumeGradient = gradient;
+	else if( _gradientStorage != GradientStorage::eOnDemand )
 	{
-		for( int32_t x = begin; x < end; ++x )
+		_gradientNormals = NormalVolume( gradient.dimensions(), _gradientStorage == GradientStorage::eFloat16 ? NormalVolume::Encoding::eFloat16 : NormalVolume::Encoding::eSnorm8 );
+		util::compute_multi_threaded( 0, gradient.voxelCount(), [&] ( int32_t begin, int32_t end )
 		{
-			for( int32_t y = 0; y < this->dimensions().y; ++y )
-			{
-				for( int32_t z = 0; z < this->dimensions().z; ++z )
-				{
-					const auto voxel = vec3i( x, y, z );
-					const auto center = meanVolume.at( voxel );
-
-					auto gradient = vec3f();
-					for( int32_t i = 0; i < 3; ++i )
-					{
-						vec3i forwardVoxel = voxel, backwardVoxel = voxel;
-						forwardVoxel[i] += 1;
-						backwardVoxel[i] -= 1;
-
-						auto forward = 0.0f, backward = 0.0f, d = 2.0f;
-						if( forwardVoxel[i] < this->dimensions()[i] ) forward = meanVolume.at( forwardVoxel );
-						else forward = center, d = 1.0;
-						if( backwardVoxel[i] >= 0 ) backward = meanVolume.at( backwardVoxel );
-						else backward = center, d = 1.0;
+			for( int32_t i = begin; i < end; ++i ) _gradientNormals.set( i, gradient.at( i ) );
+		} );
+	}
+}
+void Ensemble::Field::computeGradient() const
+{
+	const auto timeBegin = std::chrono::high_resolution_clock::now();
 
-						gradient[i] = ( forward - backward ) / d;
-					}
+	auto magnitudeVolume = Volume<float>( this->dimensions(), "Gradient Magnitude" );
+	_volumeGradient = Volume<vec3f>();
+	_gradientNormals = NormalVolume();
+	if( _gradientStorage == GradientStorage::eFloat ) _volumeGradient = Volume<vec3f>( this->dimensions(), "Gradient" );
+	else if( _gradientStorage != GradientStorage::eOnDemand ) _gradientNormals = NormalVolume( this->dimensions(), _gradientStorage == GradientStorage::eFloat16 ? NormalVolume::Encoding::eFloat16 : NormalVolume::Encoding::eSnorm8 );
 
-					_volumeGradient.at( voxel ) = gradient;
-				}
-			}
-		}
-	} );
-	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+	this->evaluateGradient( [&] ( int32_t index, int32_t count, const vec3f* gradients, const float* magnitudes )
 	{
-		for( int32_t i = begin; i < end; ++i )
-			magnitudeVolume.at( i ) = _volumeGradient.at( i ).length();
+		std::copy( magnitudes, magnitudes + count, magnitudeVolume.data() + index );
+		if( _gradientStorage == GradientStorage::eFloat ) std::copy( gradients, gradients + count, _volumeGradient.data() + index );
+		else if( _gradientStorage != GradientStorage::eOnDemand ) for( int32_t i = 0; i < count; ++i ) _gradientNormals.set( index + i, gradients[i] );
 	} );
+	_derivedVolumes.set( Derived::eGradientMagnitude, std::move( magnitudeVolume ) );
 
 	const auto timeEnd = std::chrono::high_resolution_clock::now();
 	const auto time = std::chrono::duration_cast<std::chrono::microseconds>( timeEnd - timeBegin ).count() / 1000.0;
@@ -972,38 +2495,9 @@ void Ensemble::Field::computePrincipalComponents() const
 {
 	const auto timeBegin = std::chrono::high_resolution_clock::now();
 
-	// Copy data to Eigen matrix
-	using matrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>;
-	auto data = matrix( this->voxelCount(), this->memberCount() );
-	for( int32_t i = 0; i < this->memberCount(); ++i )
-	{
-		const auto& volume = this->volume( i );
-		for( int32_t j = 0; j < this->voxelCount(); ++j )
-			data( j, i ) = volume.at( j );
-	}
-
-	// Compute covariance matrix
-	auto aligned = ( data.rowwise() - data.colwise().mean() ).eval();
-	auto covariance = ( aligned.transpose() * aligned ).eval();
-
-	// Perform singular value composition, receive projection matrix
-	auto svd = Eigen::JacobiSVD<matrix>( covariance, Eigen::ComputeThinU );
-	auto p = ( svd.matrixU().leftCols( 2 ) ).eval();
-
-	// Project data points and normalize the values
-	auto projected = ( aligned * p ).eval();
-	projected = projected.rowwise() - projected.colwise().minCoeff();
-	projected = projected.array().rowwise() / projected.colwise().maxCoeff().array();
-
-	auto& pca1 = _derivedVolumes[Derived::ePCA1] = Volume<float>( this->dimensions(), "1st PC" );
-	auto& pca2 = _derivedVolumes[Derived::ePCA2] = Volume<float>( this->dimensions(), "2nd PC" );
-
-	// Copy projection from Eigen matrix to PCA volumes
-	for( int32_t i = 0; i < this->voxelCount(); ++i )
-	{
-		pca1.at( i ) = projected( i, 0 );
-		pca2.at( i ) = projected( i, 1 );
-	}
+	auto [pca1, pca2] = this->principalComponents( nullptr );
+	_derivedVolumes.set( Derived::ePCA1, std::move( pca1 ) );
+	_derivedVolumes.set( Derived::ePCA2, std::move( pca2 ) );
 
 	const auto timeEnd = std::chrono::high_resolution_clock::now();
 	const auto time = std::chrono::duration_cast<std::chrono::microseconds>( timeEnd - timeBegin ).count() / 1000.0;
@@ -1013,48 +2507,16 @@ void Ensemble::Field::computeFieldSimilarity() const
 {
 	const auto timeBegin = std::chrono::high_resolution_clock::now();
 
-	auto& fieldSimilarity = _similarities[Similarity::eField].first = Volume<float>( vec3i( this->memberCount(), this->memberCount(), 1 ), "Field Similarity" );
-	std::fill( fieldSimilarity.begin(), fieldSimilarity.end(), 1.0f );
-
 	// Compute field similarity matrix
-	util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
-	{
-		for( int32_t i = begin; i < end; ++i )
-		{
-			if( begin == 0 ) std::cout << "Calculating field similarity (" << 100.0 * i / end << " %)          \r";
-			for( int32_t j = i + 1; j < this->memberCount(); ++j )
-			{
-				const auto first = this->volume( i );
-				const auto second = this->volume( j );
-
-				const auto firstDomain = first.domain();
-				const auto secondDomain = second.domain();
-
-				const auto totalMin = std::min( firstDomain.x, secondDomain.x );
-				const auto totalMax = std::max( firstDomain.y, secondDomain.y );
-				const auto totalRange = totalMax - totalMin;
-
-				double numerator = 0.0, denominator = 0.0;
-				for( int32_t k = 0; k < this->voxelCount(); ++k )
-				{
-					const auto [min, max] = std::minmax( first.at( k ), second.at( k ) );
-
-					numerator += 1.0 - ( max - totalMin ) / totalRange;
-					denominator += 1.0 - ( min - totalMin ) / totalRange;
-				}
-				const auto similarity = denominator ? ( numerator / denominator ) : 1.0;
-				fieldSimilarity.at( vec3i( i, j, 0 ) ) = fieldSimilarity.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
-			}
-		}
-	} );
-	std::cout << "Finished calculating field similarities!          " << std::endl;
+	auto fieldSimilarity = this->similarityMatrix( Similarity::eField, nullptr );
 
 	// Create dendrogram using field similarity matrix
 	const auto similarityFunction = [&] ( int32_t first, int32_t second )
 	{
 		return fieldSimilarity.at( vec3i( first, second, 0 ) );
 	};
-	_similarities[Similarity::eField].second = HCNode( this->memberCount(), similarityFunction );
+	auto root = HCNode( this->memberCount(), similarityFunction );
+	_similarities.set( Similarity::eField, std::make_pair( std::move( fieldSimilarity ), std::move( root ) ) );
 
 	const auto timeEnd = std::chrono::high_resolution_clock::now();
 	const auto time = std::chrono::duration_cast<std::chrono::microseconds>( timeEnd - timeBegin ).count() / 1000.0;
@@ -1064,67 +2526,16 @@ void Ensemble::Field::computePearsonSimilarity() const
 {
 	const auto timeBegin = std::chrono::high_resolution_clock::now();
 
-	auto& pearsonSimilarity = _similarities[Similarity::ePearson].first
-		= Volume<float>( vec3i( this->memberCount(), this->memberCount(), 1 ), "Pearson Similarity" );
-	std::fill( pearsonSimilarity.begin(), pearsonSimilarity.end(), 1.0f );
-
 	// Compute Pearson similarity matrix
-	auto means = std::vector<double>( this->memberCount() );
-	auto stddevs = std::vector<double>( this->memberCount() );
-	util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
-	{
-		for( int32_t i = begin; i < end; ++i )
-		{
-			const auto volume = this->volume( i );
-
-			auto& mean = means[i] = 0.0;
-			for( int32_t j = 0; j < this->voxelCount(); ++j ) mean += volume.at( j );
-			mean /= this->voxelCount();
-		}
-	} );
-	util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
-	{
-		for( int32_t i = begin; i < end; ++i )
-		{
-			const auto volume = this->volume( i );
-
-			auto& stddev = stddevs[i] = 0.0;
-			for( int32_t j = 0; j < this->voxelCount(); ++j )
-			{
-				const auto v = ( volume.at( j ) - means[i] );
-				stddev += v * v;
-			}
-			stddev = std::sqrt( stddev );
-		}
-	} );
-	util::compute_multi_threaded( 0, this->memberCount(), [&] ( int32_t begin, int32_t end )
-	{
-		for( int32_t i = begin; i < end; ++i )
-		{
-			if( begin == 0 ) std::cout << "Calculating pearson similarity (" << 100.0 * i / end << " %)          \r";
-			for( int32_t j = i + 1; j < this->memberCount(); ++j )
-			{
-				const auto first = this->volume( i );
-				const auto second = this->volume( j );
-
-				auto correlation = 0.0;
-				for( int32_t k = 0; k < this->voxelCount(); ++k )
-					correlation += ( first.at( k ) - means[i] ) * ( second.at( k ) - means[j] );
-				correlation = ( stddevs[i] == 0.0 && stddevs[j] == 0.0 ) ? 1.0 : ( correlation / ( stddevs[i] * stddevs[j] ) );
-
-				const auto similarity = ( correlation + 1.0 ) / 2.0;
-				pearsonSimilarity.at( vec3i( i, j, 0 ) ) = pearsonSimilarity.at( vec3i( j, i, 0 ) ) = static_cast<float>( similarity );
-			}
-		}
-	} );
-	std::cout << "Finished calculating pearson similarities!          " << std::endl;
+	auto pearsonSimilarity = this->similarityMatrix( Similarity::ePearson, nullptr );
 
 	// Create dendrogram using Pearson similarity matrix
 	const auto similarityFunction = [&] ( int32_t first, int32_t second )
 	{
 		return pearsonSimilarity.at( vec3i( first, second, 0 ) );
 	};
-	_similarities[Similarity::ePearson].second = HCNode( this->memberCount(), similarityFunction );
+	auto root = HCNode( this->memberCount(), similarityFunction );
+	_similarities.set( Similarity::ePearson, std::make_pair( std::move( pearsonSimilarity ), std::move( root ) ) );
 
 	const auto timeEnd = std::chrono::high_resolution_clock::now();
 	const auto time = std::chrono::duration_cast<std::chrono::microseconds>( timeEnd - timeBegin ).count() / 1000.0;
@@ -1137,60 +2548,42 @@ void Ensemble::Field::computeHistograms() const
 	const auto& meanVolume = this->volume( Derived::eMean );
 	const auto& stddevVolume = this->volume( Derived::eStddev );
 
-	auto& hist1Volume = _derivedVolumes[Derived::eHist1] = Volume<float>( this->dimensions(), u8"z\u2011scores\u00A0in [-inf,-0.842]" );
-	auto& hist2Volume = _derivedVolumes[Derived::eHist2] = Volume<float>( this->dimensions(), u8"z\u2011scores\u00A0in (-0.842,-0.253]" );
-	auto& hist3Volume = _derivedVolumes[Derived::eHist3] = Volume<float>( this->dimensions(), u8"z\u2011scores\u00A0in (-0.253,0.253]" );
-	auto& hist4Volume = _derivedVolumes[Derived::eHist4] = Volume<float>( this->dimensions(), u8"z\u2011scores\u00A0in (0.253,0.842]" );
-	auto& hist5Volume = _derivedVolumes[Derived::eHist5] = Volume<float>( this->dimensions(), u8"z\u2011scores\u00A0in (0.842,inf]" );
+	_histogram = HistogramVolume( this->dimensions(), statistics::z_score_edges( _histogramBinCount ), this->memberCount() );
 
-	// Compute z-score histogram volumes
-	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+	// Compute z-score histograms
+	this->members().forEachBrick( [&] ( const MemberBricks::Brick& brick )
 	{
-		for( int32_t i = begin; i < end; ++i )
+		auto counts = std::vector<int32_t>( _histogramBinCount );
+		for( int32_t k = 0; k < brick.voxelCount; ++k )
 		{
+			const auto i = brick.voxels[k];
+			const auto values = brick.voxel( k );
 			const auto mean = meanVolume.at( i );
 			const auto stddev = stddevVolume.at( i );
 
+			// Compute z-score, increment count of bin
+			std::fill( counts.begin(), counts.end(), 0 );
 			for( int32_t j = 0; j < this->memberCount(); ++j )
-			{
-				// Compute z-score, increment value of bin
-				const auto z = stddev ? ( this->volume( j ).at( i ) - mean ) / stddev : 0.0;
-
-				if( z <= -0.842 ) ++hist1Volume.at( i );
-				else if( z <= -0.253 ) ++hist2Volume.at( i );
-				else if( z <= 0.253 ) ++hist3Volume.at( i );
-				else if( z <= 0.842 ) ++hist4Volume.at( i );
-				else ++hist5Volume.at( i );
-			}
-
-			// Normalize values to [0, 1]
-			hist1Volume.at( i ) /= this->memberCount();
-			hist2Volume.at( i ) /= this->memberCount();
-			hist3Volume.at( i ) /= this->memberCount();
-			hist4Volume.at( i ) /= this->memberCount();
-			hist5Volume.at( i ) /= this->memberCount();
+				++counts[_histogram.bin( stddev ? ( values[j] - mean ) / stddev : 0.0 )];
+			_histogram.setCounts( i, counts.data() );
 		}
 	} );
 
-	// Make sure that the domain will always use [0, 1] (e.g. on parallel coordinates axes)
-	hist1Volume.expandDomain( vec2f( 0.0f, 1.0f ) );
-	hist2Volume.expandDomain( vec2f( 0.0f, 1.0f ) );
-	hist3Volume.expandDomain( vec2f( 0.0f, 1.0f ) );
-	hist4Volume.expandDomain( vec2f( 0.0f, 1.0f ) );
-	hist5Volume.expandDomain( vec2f( 0.0f, 1.0f ) );
-
-	auto& histDeviation = _derivedVolumes[Derived::eHistDeviation] = Volume<float>( this->dimensions(), to_string( Derived::eHistDeviation ) );
+	// Compute the largest deviation from a uniform histogram (replacing an existing volume keeps references valid)
+	const auto uniform = 1.0f / _histogramBinCount;
+	auto histDeviation = Volume<float>( this->dimensions(), to_string( Derived::eHistDeviation ) );
 	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
 	{
 		for( int32_t i = begin; i < end; ++i )
 		{
 			float max = 0.0f;
-			for( const auto value : { hist1Volume.at( i ), hist2Volume.at( i ), hist3Volume.at( i ), hist4Volume.at( i ), hist5Volume.at( i ) } )
-				max = std::max( max, std::abs( value - 0.2f ) );
+			for( int32_t bin = 0; bin < _histogramBinCount; ++bin )
+				max = std::max( max, std::abs( static_cast<float>( _histogram.count( i, bin ) ) / this->memberCount() - uniform ) );
 			histDeviation.at( i ) = max;
 		}
 	} );
-	histDeviation.expandDomain( vec2f( 0.0f, 0.8f ) );
+	histDeviation.expandDomain( vec2f( 0.0f, 1.0f - uniform ) );
+	_derivedVolumes.set( Derived::eHistDeviation, std::move( histDeviation ) );
 
 	std::cout << "Finished computing histograms in " << timer.get() << " ms." << std::endl;
 }
@@ -1201,57 +2594,69 @@ void Ensemble::Field::computeAndersonDarling() const
 	const auto& meanVolume = this->volume( Derived::eMean );
 	const auto& stddevVolume = this->volume( Derived::eStddev );
 
-	auto& andersonDarlingVolume = _derivedVolumes[Derived::eAndersonDarling] = Volume<float>( this->dimensions(), "Anderson-Darling" );
-
-	// Compute the cumulative distribution function of the normal distribution using std::erfc (https://stackoverflow.com/questions/2328258/cumulative-normal-distribution-function-in-c-c)
-	const auto normalCDF = [] ( double v )
-	{
-		return 0.5 * std::erfc( -v * 0.707106781186547524401 );
-	};
+	auto andersonDarlingVolume = Volume<float>( this->dimensions(), "Anderson-Darling" );
 
 	// Calculate the Anderson-Darling test for every voxel (https://en.wikipedia.org/wiki/Anderson%E2%80%93Darling_test#Test_for_normality)
-	util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+	this->members().forEachBrick( [&] ( const MemberBricks::Brick& brick )
 	{
-		auto values = std::vector<float>( this->memberCount() );
-		for( int32_t i = begin; i < end; ++i )
+		auto means = std::vector<float>( brick.voxelCount );
+		auto stddevs = std::vector<float>( brick.voxelCount );
+		for( int32_t k = 0; k < brick.voxelCount; ++k )
 		{
-			const auto mean = meanVolume.at( i );
-			const auto stddev = stddevVolume.at( i );
+			means[k] = meanVolume.at( brick.voxels[k] );
+			stddevs[k] = stddevVolume.at( brick.voxels[k] );
+		}
 
-			// Handle edge case
-			if( stddev == 0.0 )
-			{
-				andersonDarlingVolume.at( i ) = 1.0f;
-				continue;
-			}
+		auto results = std::vector<float>( brick.voxelCount );
+		statistics::anderson_darling( brick.values, brick.voxelCount, brick.memberCount, means.data(), stddevs.data(), results.data() );
+		for( int32_t k = 0; k < brick.voxelCount; ++k )
+			andersonDarlingVolume.at( brick.voxels[k] ) = results[k];
+	} );
 
-			// Standardize and sort values
-			for( int32_t j = 0; j < this->memberCount(); ++j )
-				values[j] = ( this->volume( j ).at( i ) - mean ) / stddev;
-			std::sort( values.begin(), values.end() );
+	// Make sure that the domain will always use [0, 1] (e.g. on parallel coordinates axes)
+	andersonDarlingVolume.expandDomain( vec2f( 0.0f, 1.0f ) );
+	_derivedVolumes.set( Derived::eAndersonDarling, std::move( andersonDarlingVolume ) );
 
-			auto A = 0.0;
-			for( int32_t j = 0; j < this->memberCount(); ++j )
-			{
-				const auto o = j + 1;
-				A += ( 2 * o - 1 ) * ( std::log( normalCDF( values[j] ) ) + std::log( 1.0 - normalCDF( values[this->memberCount() - o] ) ) );
-			}
-			A = -this->memberCount() - 1.0 / this->memberCount() * A;
-			A = A * ( 1.0 + 0.75 / this->memberCount() - 2.25 / ( this->memberCount() * this->memberCount() ) );
+	std::cout << "Finished computing Anderson-Darling in " << timer.get() << " ms." << std::endl;
+}
+void Ensemble::Field::computeQuartiles() const
+{
+	auto timer = util::timer();
 
-			// Convert test statistic to p-value (https://www.spcforexcel.com/knowledge/basic-statistics/anderson-darling-test-for-normality)
-			andersonDarlingVolume.at( i ) = A >= 0.6 ? std::exp( 1.2937 - 5.709 * A + 0.0186 * A * A )
-				: A > 0.34 ? std::exp( 0.9177 - 4.279 * A - 1.38 * A * A )
-				: A > 0.2 ? 1.0 - std::exp( -8.318 + 42.796 * A - 59.938 * A * A )
-				: 1.0 - std::exp( -13.436 + 101.14 * A - 223.73 * A * A );
+	const auto& minimumVolume = this->volume( Derived::eMinimum );
+	const auto& maximumVolume = this->volume( Derived::eMaximum );
+
+	auto lowerVolume = Volume<float>( this->dimensions(), to_string( Derived::eLowerQuartile ) );
+	auto medianVolume = Volume<float>( this->dimensions(), to_string( Derived::eMedian ) );
+	auto upperVolume = Volume<float>( this->dimensions(), to_string( Derived::eUpperQuartile ) );
+	auto rangeVolume = Volume<float>( this->dimensions(), to_string( Derived::eInterquartileRange ) );
+
+	// Compute the quartiles for every voxel (the minimum and maximum are only used as range for quantile sketches)
+	this->members().forEachBrick( [&] ( const MemberBricks::Brick& brick )
+	{
+		auto minimums = std::vector<float>( brick.voxelCount );
+		auto maximums = std::vector<float>( brick.voxelCount );
+		for( int32_t k = 0; k < brick.voxelCount; ++k )
+		{
+			minimums[k] = minimumVolume.at( brick.voxels[k] );
+			maximums[k] = maximumVolume.at( brick.voxels[k] );
+		}
 
-			// Handle edge case
-			if( std::isnan( andersonDarlingVolume.at( i ) ) ) andersonDarlingVolume.at( i ) = 0.0f;
+		auto results = std::vector<float>( brick.voxelCount * statistics::Quartiles.size() );
+		statistics::quartiles( brick.values, brick.voxelCount, brick.memberCount, minimums.data(), maximums.data(), _quantileBudget, results.data() );
+		for( int32_t k = 0; k < brick.voxelCount; ++k )
+		{
+			const auto i = brick.voxels[k];
+			lowerVolume.at( i ) = results[k * 3];
+			medianVolume.at( i ) = results[k * 3 + 1];
+			upperVolume.at( i ) = results[k * 3 + 2];
+			rangeVolume.at( i ) = results[k * 3 + 2] - results[k * 3];
 		}
 	} );
+	_derivedVolumes.set( Derived::eLowerQuartile, std::move( lowerVolume ) );
+	_derivedVolumes.set( Derived::eMedian, std::move( medianVolume ) );
+	_derivedVolumes.set( Derived::eUpperQuartile, std::move( upperVolume ) );
+	_derivedVolumes.set( Derived::eInterquartileRange, std::move( rangeVolume ) );
 
-	// Make sure that the domain will always use [0, 1] (e.g. on parallel coordinates axes)
-	andersonDarlingVolume.expandDomain( vec2f( 0.0f, 1.0f ) );
-
-	std::cout << "Finished computing Anderson-Darling in " << timer.get() << " ms." << std::endl;
+	std::cout << "Finished computing quartiles in " << timer.get() << " ms." << std::endl;
 }
\ No newline at end of file
@@ -1,14 +1,23 @@
 #pragma once
 #include "qobject.h"
 
+#include "bricks.hpp"
+#include "cache.hpp"
 #include "common_widgets.hpp"
 #include "hierarchical_clustering.hpp"
+#include "histogram.hpp"
+#include "normals.hpp"
+#include "statistics.hpp"
 #include "volume.hpp"
+#include "volume_view.hpp"
 
 #include <filesystem>
+#include <future>
 #include <map>
 #include <set>
+#include <unordered_map>
 
+class HDF5File;
 class Region;
 
 // Class to manage an ensemble
@@ -19,7 +28,8 @@ public:
 	enum class Derived : int32_t
 	{
 		eNone, eMinimum, eMaximum, eMean, eStddev, eGradientMagnitude, ePCA1, ePCA2, eLabel,
-		eHist1, eHist2, eHist3, eHist4, eHist5, eHistDeviation, eAndersonDarling
+		eHist1, eHist2, eHist3, eHist4, eHist5, eHistDeviation, eAndersonDarling,
+		eMedian, eLowerQuartile, eUpperQuartile, eInterquartileRange
 	};
 	// Enum for the available similarity measures
 	enum class Similarity : int32_t { eField, ePearson };
@@ -37,6 +47,14 @@ public:
 		VolumeID( int32_t field, Ensemble::Derived type, bool difference = false ) : field( field ), index( -1 ), type( type ), difference( difference )
 		{}
 
+		// Identify a single bin of the z-score histogram of a field (Ensemble::Derived::eHist1 without a bin refers to the whole histogram)
+		static VolumeID histogram( int32_t field, int32_t bin )
+		{
+			auto id = VolumeID( field, Ensemble::Derived::eHist1 );
+			id.index = bin;
+			return id;
+		}
+
 		bool operator==( const VolumeID& other ) const noexcept
 		{
 			return field == other.field && index == other.index && type == other.type && difference == other.difference;
@@ -61,6 +79,7 @@ public:
 				uint64_t number = reinterpret_cast<const uint32_t&>( id.field );
 				if( id.type == Ensemble::Derived::eNone ) number |= static_cast<uint64_t>( reinterpret_cast<const uint32_t&>( id.index ) ) << 32;
 				else number |= static_cast<uint64_t>( reinterpret_cast<const uint32_t&>( id.type ) ) << 32;
+				if( id.type == Ensemble::Derived::eHist1 ) number ^= static_cast<uint64_t>( reinterpret_cast<const uint32_t&>( id.index ) ) << 16;
 				return util::hash_combine( std::hash<uint64_t>()( number ), id.difference );
 			}
 		};
@@ -99,6 +118,17 @@ public:
 	class Field
 	{
 	public:
+		// Enum for the storage of the members (separate volumes, member-interleaved bricks, evaluated from other fields, decompressed on access, decompressed
+		// on access with a bounded brick cache, which allows fields that are larger than the main memory if they are loaded from a file, or reconstructed from
+		// a low-rank approximation on access)
+		enum class Storage : int32_t { eVolumes, eInterleaved, eVirtual, eCompressed, ePaged, eLowRank };
+
+		// Enum for the computation of principal components (exact covariance matrix, randomized range finder or automatic choice based on the member count)
+		enum class PCAMethod : int32_t { eAutomatic, eCovariance, eRandomized };
+
+		// Enum for the storage of the gradient of the mean volume (full precision, packed directions scaled by the gradient magnitude or recomputed on demand)
+		enum class GradientStorage : int32_t { eFloat, eFloat16, eSnorm8, eOnDemand };
+
 		Field() noexcept = default;
 		Field( QString name ) noexcept;
 
@@ -108,25 +138,45 @@ public:
 		// Copy the other field, applying a conversion (mapping) to the values of all members
 		Field( const Field& other, QString name, const std::function<float( float )>& conversion );
 
+		// Create a virtual field, whose members are evaluated per brick from the members of the input fields (the variables of the expression)
+		Field( QString name, const std::vector<const Field*>& inputs, const Expression& expression );
+
+		// Fields are movable, a pending recomputation is cancelled and the cached data is registered with the memory budget again for the new address (which
+		// allocates, so moving isn't noexcept)
 		Field( const Field& ) = delete;
-		Field( Field&& ) = default;
+		Field( Field&& other );
+		~Field();
 
 		Field& operator=( const Field& ) = delete;
-		Field& operator=( Field&& ) = default;
+		Field& operator=( Field&& other );
 
 		// Load different pre-defined fields
 		void loadRFA();
+
+		// Convert the text files of the RFA members to a binary file with a shape header (member count and dimensions as uint32) followed by the values
+		static void convertRFA( const std::filesystem::path& directory, const std::filesystem::path& filepath );
 		void loadTeardrop();
 		void loadTangle();
 		void loadSpheres();
 
-		// Load or save field
-		void load( std::ifstream& stream );
-		void save( std::ofstream& stream ) const;
+		// Stream the members from HDF5 files (one file per member) in slabs of layers into interleaved bricks, evaluating the expression of the datasets per slab
+		void loadHDF5( const std::vector<std::unique_ptr<HDF5File>>& files, const std::vector<QString>& datasets, const Expression& expression );
 
-		// Compare to fields for equality
+		// Load or save field, the data of mapped files (nullptr for legacy files) is written separately from the stream (the directory of the file)
+		void load( std::istream& stream, const std::filesystem::path& filepath, const std::shared_ptr<const MappedFile>& file, uint32_t version );
+		void save( std::ostream& stream, MappedFileWriter& data ) const;
+
+		// Copy the members and volumes that lie in the mapped file into memory, so the file is unmapped once it is released (e.g. before it is replaced), or
+		// wrap the equal members and volumes of the replacement (the field loaded from the file that replaced it)
+		void releaseFile( const MappedFile& file, const Field* replacement = nullptr );
+
+		// Compare to fields for equality (values are compared by their fingerprints)
 		bool compare( const Field& other ) const;
 
+		// Getter for the fingerprint of the members (computed on first access and stored in mapped files), the fingerprint of a virtual field combines its
+		// expression and the fingerprints of its inputs
+		uint64_t fingerprint() const;
+
 		void setName( QString name ) noexcept;
 		const QString& name() const noexcept;
 
@@ -135,18 +185,71 @@ public:
 		int32_t voxelCount() const noexcept;
 		vec3i dimensions() const noexcept;
 
+		// Setter and getter for the storage of the members (member volumes of interleaved fields are extracted on demand). Compressed and paged members can be
+		// encoded as quantized values or residuals against the mean (see compression::Encoding for the error bounds), lossy encodings replace the values and
+		// recompute derived data that was computed already (see applyRecomputedStages). Values that are lossy already (encoded or low rank) can't be encoded
+		// lossily again, since the errors would add up beyond the bounds.
+		void setStorage( Storage storage, const compression::Encoding& encoding = compression::Encoding() );
+		Storage storage() const noexcept;
+		bool lossy() const noexcept;
+
+		// Replace the members by their low-rank approximation from the leading principal components (see LowRankMembers). This is lossy, derived data that
+		// was computed already is recomputed and similarities without a mask are approximated from the coefficients of the components. Like setStorage,
+		// this rejects members that are lossy already.
+		void setLowRank( int32_t rank );
+
+		// Derived data that was computed already is recomputed in the background after the values of the members changed. Until the results are applied
+		// (on the thread that uses the derived data), the previous derived data is kept. Returns whether the derived data is up to date, optionally waiting.
+		bool applyRecomputedStages( bool wait = false );
+
+		// Evaluate a virtual field from the current members of its inputs (the fields before it), e.g. after their storage was replaced. Derived data that
+		// was computed already is recomputed if the values of the inputs changed.
+		void setInputs( const std::vector<const Field*>& inputs );
+
+		// Getter for the size of the brick cache of paged fields (derived from the memory budget)
+		static size_t brickCacheSize();
+
+		// Setter and getter for the storage of the gradient (the gradient magnitude volume is always stored)
+		void setGradientStorage( GradientStorage storage );
+		GradientStorage gradientStorage() const noexcept;
+
+		// Getters for the gradient of the mean volume (central differences, one-sided differences at the borders)
+		vec3f gradient( int32_t index ) const;
+		Volume<vec3f> gradientVolume() const;
+
+		// Setter and getter for the number of bins of the z-score histogram (changing it invalidates previously returned histogram volumes)
+		void setHistogramBinCount( int32_t binCount );
+		int32_t histogramBinCount() const noexcept;
+
+		// Setter and getter for the budget of the quartile computation (changing it recomputes already computed quartiles)
+		void setQuantileBudget( const statistics::QuantileBudget& budget );
+		const statistics::QuantileBudget& quantileBudget() const noexcept;
+
+		// Getters for the bin counts of the z-score histogram and the normalized volume of a single bin (created on first access)
+		const HistogramVolume& histogram() const;
+		const Volume<float>& histogramVolume( int32_t bin ) const;
+
+		// Getter for brick-wise access to the values of all members
+		const MemberBricks& members() const noexcept;
+
 		// Getters for (derived) volumes
 		const Volume<float>& volume( int32_t index ) const;
 		const Volume<float>& volume( Derived derived ) const;
-		const std::map<Derived, Volume<float>>& derivedVolumes() const noexcept;
+		const LazyCache<Derived, Volume<float>>& derivedVolumes() const noexcept;
 
 		// Getters for similarity matrices and dendrograms
 		const HCNode& root( Similarity similarity ) const;
-		const std::map<Similarity, std::pair<Volume<float>, HCNode>>& similarites() const;
+		const LazyCache<Similarity, std::pair<Volume<float>, HCNode>>& similarites() const;
 
 		// Compute the dendrogram using the specified similarity measure and voxels from the mask
 		HCNode root( Similarity similarity, const Volume<float>& mask ) const;
 
+		// Compute the principal components of the voxels from the mask (all voxels if not specified) and return the normalized projection of all voxels onto the first two
+		std::pair<Volume<float>, Volume<float>> principalComponents( const Volume<float>* mask, PCAMethod method = PCAMethod::eAutomatic ) const;
+
+		// Compute the basic derived volumes and/or similarities, independent stages are computed concurrently (stages that were already computed on demand are skipped)
+		void computeDerivedVolumes( bool volumes = true, bool similarities = true ) const;
+
 		// Function to compute certain derived volumes
 		void computeMinimumMaximum() const;
 		void computeMeanStddev() const;
@@ -156,13 +259,113 @@ public:
 		void computePearsonSimilarity() const;
 		void computeHistograms() const;
 		void computeAndersonDarling() const;
+		void computeQuartiles() const;
 
 	private:
+		// Enum for the stages of the derived data, every stage computes one or more derived volumes or similarities
+		enum class Stage : int32_t { eMinimumMaximum, eMeanStddev, eGradient, ePrincipalComponents, eHistograms, eAndersonDarling, eQuartiles, eFieldSimilarity, ePearsonSimilarity };
+
+		// Return the stage that computes a derived volume
+		static Stage stage( Derived derived );
+
+		// Run the stage once (concurrent requests wait for the first one), the duration is kept as cost for the memory budget
+		void computeStage( Stage stage ) const;
+
+		// Recompute derived data that was computed (or loaded) already after the values of the members changed. The stages run in the background on a field
+		// that shares the members, their results replace the derived data in place when they are applied (see applyRecomputedStages).
+		void recomputeStages();
+
+		// Cancel the recomputation of the stages (the running stage is finished) before the members are replaced, returns whether one was pending
+		bool cancelRecomputation();
+
+		// Version of the algorithms of the cached stages, has to be incremented whenever their results change
+		static constexpr uint32_t CacheVersion = 1;
+
+		// Return the key of the results of a stage with the parameters in the disk cache (zero if the cache is disabled or the stage is cheaper than reading its results)
+		uint64_t cacheKey( Stage stage, uint64_t parameters = 0 ) const;
+
+		// Return the parameters of a stage that change its results (histogram bin count, quantile budget)
+		uint64_t stageParameters( Stage stage ) const;
+
+		// Read the results of a stage from the disk cache or write them to the disk cache
+		bool loadStage( Stage stage ) const;
+		void storeStage( Stage stage ) const;
+
+		// Return the derived volumes that are computed by a stage
+		static std::vector<Derived> stageVolumes( Stage stage );
+
+		// Return the fingerprint of a virtual field, which combines the expression and the fingerprints of the inputs
+		static uint64_t fingerprint( const std::vector<const Field*>& inputs, const Expression& expression );
+
+		// Register all cached data with the memory budget (evictable data is recomputed or extracted again on the next request) or remove it, e.g. after the
+		// members were replaced. Single entries are registered when the data is created and removed from the tracked entries when it is evicted.
+		void trackMemory() const;
+		void untrackMemory() const;
+
+		// Register a single entry, the storage of the members, an extracted member volume, the data of a stage or a normalized histogram bin with the memory
+		// budget (the memory mutex has to be locked). Fields that recompute stages in the background are only accounted, as the stages use their data.
+		void track( const void* owner, util::MemoryBudget::Category category, size_t bytes, double cost, std::function<void()> evict ) const;
+		void trackMembers() const;
+		void trackVolume( int32_t index ) const;
+		void trackStage( Stage stage ) const;
+		void trackHistogramVolume( int32_t bin ) const;
+
+		// Compute the similarity matrix using the specified similarity measure and only voxels where the mask is not zero (if specified)
+		Volume<float> similarityMatrix( Similarity similarity, const Volume<float>* mask ) const;
+
+		// Approximate the similarity matrix of all voxels from the components of low-rank members
+		Volume<float> similarityMatrix( Similarity similarity, const LowRankMembers& members ) const;
+
+		// Mean of every member and the leading principal components of the members ([component][member], the sign is chosen such that the largest coefficient
+		// is positive) with their variances, computed from the voxels of the mask (all voxels if not specified)
+		struct PrincipalBasis
+		{
+			std::vector<float> means;
+			std::vector<float> components;
+			std::vector<float> variances;
+		};
+		PrincipalBasis principalBasis( const Volume<float>* mask, int32_t componentCount, PCAMethod method ) const;
+
+		// Evaluate the gradient for all voxels using the stencil engine, the kernel is called for rows of up to simd::Width consecutive voxels
+		void evaluateGradient( const std::function<void( int32_t index, int32_t count, const vec3f* gradients, const float* magnitudes )>& kernel ) const;
+
+		// Release the extracted member volumes after the members were replaced (the values changed if the storage is lossy)
+		void releaseVolumes( bool changed );
+
+		// Store the gradient according to the gradient storage
+		void storeGradient( const Volume<vec3f>& gradient ) const;
+
 		QString _name;
-		std::vector<std::shared_ptr<Volume<float>>> _volumes;
-		mutable std::map<Derived, Volume<float>> _derivedVolumes;
-		mutable std::map<Similarity, std::pair<Volume<float>, HCNode>> _similarities;
+		Storage _storage = Storage::eVolumes;
+		std::shared_ptr<const MemberBricks> _members;
+		bool _lossy = false;
+		mutable std::vector<std::shared_ptr<Volume<float>>> _volumes;
+		mutable LazyCache<Stage, double> _stages;
+		mutable LazyCache<Derived, Volume<float>> _derivedVolumes;
+		mutable LazyCache<Similarity, std::pair<Volume<float>, HCNode>> _similarities;
+		int32_t _histogramBinCount = 5;
+		statistics::QuantileBudget _quantileBudget;
+		mutable HistogramVolume _histogram;
+		mutable LazyCache<int32_t, Volume<float>> _histogramVolumes;
+		GradientStorage _gradientStorage = GradientStorage::eFloat;
+		mutable std::atomic<uint64_t> _fingerprint { 0 };
 		mutable Volume<vec3f> _volumeGradient;
+		Volume<vec3f> _mappedGradient;
+		mutable NormalVolume _gradientNormals;
+		mutable std::unordered_map<const void*, util::MemoryBudget::Category> _trackedMemory;
+		mutable std::set<Derived> _evictedVolumes;
+		mutable std::mutex _memoryMutex;
+		bool _evictable = true;
+
+		// Stages that are recomputed in the background
+		struct Recomputation
+		{
+			std::unique_ptr<Field> field;
+			std::set<Stage> stages;
+			std::atomic<bool> cancelled { false };
+			std::future<void> finished;
+		};
+		std::unique_ptr<Recomputation> _recomputation;
 	};
 
 	// Returns a sub-ensemble using only the volumes with the given indices
@@ -174,13 +377,23 @@ public:
 	void loadTangle();
 	void loadSpheres();
 
-	// Load or save ensemble
+	// Import an ensemble from a directory of HDF5 files (one file per member, e.g. the Red Sea ensemble, requires building with REGHIEVIS_HDF5). Every field is
+	// a name and an expression of the datasets (e.g. "TEMP" or "sqrt(U^2 + V^2 + W^2)"), all three-dimensional datasets are imported if no fields are given.
+	void loadHDF5( const std::filesystem::path& directory, std::vector<std::pair<QString, QString>> fields );
+
+	// Load or save ensemble (files are saved in the mapped format, legacy files can still be loaded). Members of mapped files are decompressed on first
+	// access and derived data that is missing in the file is computed on first access, unless 'computeDerivedVolumes' is set. Saving to the file the
+	// ensemble was loaded from updates it in place, so only data that is not in the file yet (e.g. new derived volumes) is written. Derived data that is
+	// recomputed in the background is waited for before saving.
 	void load( std::filesystem::path filepath, bool computeDerivedVolumes );
-	void save( std::filesystem::path filepath ) const;
+	void save( std::filesystem::path filepath );
 
-	// Compare two ensembles for equality
+	// Compare two ensembles for equality (values are compared by their fingerprints)
 	bool compare( const Ensemble& other ) const;
 
+	// Getter for the fingerprint of the labels and the members of all fields (stored in the header of mapped files)
+	uint64_t fingerprint() const;
+
 	// Getters for basic statistics about the ensemble
 	int32_t fieldCount() const noexcept;
 	int32_t memberCount() const noexcept;
@@ -190,10 +403,24 @@ public:
 	// Getters for the label volume and fields
 	const Volume<int32_t>& labels() const noexcept;
 	const Field& field( int32_t index ) const noexcept;
+	Field& field( int32_t index ) noexcept;
+
+	// Add a virtual field that is evaluated from the other fields using an expression (e.g. "sqrt(U^2 + V^2 + W^2)"), its derived volumes are computed (should be done before the ensemble is shown)
+	void addField( QString name, const QString& expression );
+
+	// Replace the storage of the members of a field (see Field::setStorage and Field::setLowRank), virtual fields are evaluated from the new members
+	void setStorage( int32_t field, Field::Storage storage, const compression::Encoding& encoding = compression::Encoding() );
+	void setLowRank( int32_t field, int32_t rank );
+
+	// Apply the derived data that was recomputed in the background for all fields (see Field::applyRecomputedStages), returns whether all are up to date
+	bool applyRecomputedStages( bool wait = false );
 
-	// Getters for (difference) volumes
+	// Set the number of z-score histogram bins of all fields (should be done before the ensemble is shown, as the histogram volumes are replaced)
+	void setHistogramBinCount( int32_t binCount );
+
+	// Getters for (difference) volumes, differences to the other ensemble are evaluated on the fly by the consumers of the view
 	const Volume<float>& volume( const VolumeID& id ) const;
-	const Volume<float>& differenceVolume( const VolumeID& id, const Ensemble& other ) const;
+	VolumeView differenceVolume( const VolumeID& id, const Ensemble& other ) const;
 
 	// Getter for all available valid volume ids
 	const std::set<VolumeID>& availableVolumes() const noexcept;
@@ -208,13 +435,50 @@ public:
 	}
 
 private:
+	// Header of mapped ensemble files (version 2 and newer). The directory at the end of the file has the layout of legacy files, but contains the offsets
+	// of page-aligned data instead of the data, so volumes and member bricks can wrap the mapped file without reading it. Since version 3, the member
+	// bricks are compressed individually and the directory contains the brick index. Since version 4, files are updated in place: new data is written to
+	// free ranges or appended, followed by a new directory (which ends with the free ranges), and the header is written last. The identifier and the
+	// generation (the number of updates) detect files that were replaced or updated by others since they were loaded. Since version 5, the header contains
+	// the fingerprint of the ensemble and the directory the fingerprint of every field, so the content is identified without reading the data.
+	// Since version 6, the member bricks may be quantized or coded as residuals (see compression::Encoding). Since version 7, the directory contains the
+	// storage of every field and whether its values are lossy, low-rank members are stored as their components (means, coefficients, variances and
+	// domains) and the basis bricks.
+	struct FileHeader
+	{
+		char magic[8] = {};
+		uint32_t version = 0;
+		uint32_t pageSize = 0;
+		uint64_t directoryOffset = 0;
+		uint64_t directorySize = 0;
+		uint64_t identifier = 0;
+		uint64_t generation = 0;
+		uint64_t freeSize = 0;
+		uint64_t fingerprint = 0;
+	};
+	static constexpr char FileMagic[8] = { 'R', 'H', 'V', 'E', 'N', 'S', 'M', 'B' };
+	static constexpr uint32_t FileVersion = 7;
+
+	// Check whether the file of the ensemble can be updated in place (it is unchanged since it was loaded and at most half of it is free)
+	bool updatable() const;
+
+	// Copy all data that lies in the mapped file of the ensemble into memory and release the file, or wrap the equal data of the replacement (an ensemble
+	// that was loaded from the file that replaced it) and map its file from now on
+	void releaseFile( const Ensemble* replacement = nullptr );
+
+	// Evaluate the virtual fields after a field from the current members of their inputs
+	void updateVirtualFields( int32_t field );
+
 	std::filesystem::path _filepath;
+	std::shared_ptr<const MappedFile> _file;
+	mutable FileHeader _fileHeader;
+	mutable std::vector<MappedFile::Range> _freeRanges;
+	MappedFileWriter::WrittenRanges _writtenRanges;
 	std::shared_ptr<Volume<int32_t>> _volumeLabels;
 	std::vector<Field> _fields;
 
 	mutable std::set<VolumeID> _availableVolumes;
-	mutable std::map<Derived, Volume<float>> _derivedVolumes;
-	mutable std::unordered_map<const Ensemble*, std::unordered_map<VolumeID, Volume<float>>> _differenceVolumes;
+	mutable LazyCache<Derived, Volume<float>> _derivedVolumes;
 
 	static inline std::set<Ensemble::Derived> _EnsembleTypes = { Ensemble::Derived::eLabel };
 };
@@ -240,6 +504,10 @@ inline QString to_string( Ensemble::Derived type )
 	case Ensemble::Derived::eHist5: return "Z-Score Histogram (5th)";
 	case Ensemble::Derived::eHistDeviation: return "Histogram Deviation";
 	case Ensemble::Derived::eAndersonDarling: return "Anderson-Darling";
+	case Ensemble::Derived::eMedian: return "Median";
+	case Ensemble::Derived::eLowerQuartile: return "Lower Quartile";
+	case Ensemble::Derived::eUpperQuartile: return "Upper Quartile";
+	case Ensemble::Derived::eInterquartileRange: return "Interquartile Range";
 	default: return "Ensemble::Derived";
 	}
 }
@@ -332,5 +600,5 @@ private:
 	ComboBox<Ensemble::Derived>* _type = nullptr;
 	CheckBox* _difference = nullptr;
 
-	static inline std::vector<Ensemble::Derived> _Types = { Ensemble::Derived::eMinimum, Ensemble::Derived::eMaximum, Ensemble::Derived::eMean, Ensemble::Derived::eStddev, Ensemble::Derived::eGradientMagnitude, Ensemble::Derived::ePCA1, Ensemble::Derived::ePCA2, Ensemble::Derived::eLabel, Ensemble::Derived::eHistDeviation, Ensemble::Derived::eAndersonDarling };
+	static inline std::vector<Ensemble::Derived> _Types = { Ensemble::Derived::eMinimum, Ensemble::Derived::eMaximum, Ensemble::Derived::eMean, Ensemble::Derived::eStddev, Ensemble::Derived::eGradientMagnitude, Ensemble::Derived::ePCA1, Ensemble::Derived::ePCA2, Ensemble::Derived::eLabel, Ensemble::Derived::eHistDeviation, Ensemble::Derived::eAndersonDarling, Ensemble::Derived::eMedian, Ensemble::Derived::eLowerQuartile, Ensemble::Derived::eUpperQuartile, Ensemble::Derived::eInterquartileRange };
 };
\ No newline at end of file
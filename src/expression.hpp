@@ -0,0 +1,325 @@
+#pragma once
+#include "simd.hpp"
+
+#include <qstring.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Per-voxel arithmetic expression over named variables (e.g. "sqrt(U^2 + V^2 + W^2)" over the fields U, V and W). The expression is parsed once into a postfix program
+// (constant subexpressions are folded), which is evaluated in blocks of values: every instruction runs a SIMD loop over the whole block and intermediate results stay
+// in a small stack of blocks, so no temporary volumes are created and there is no indirect call per value.
+// Supported are numbers, variables (identifiers or "quoted names"), pi, + - * / ^ (right-associative, integer exponents are expanded into multiplications),
+// unary minus, parentheses and the functions abs, sqrt, exp, log (positive inputs), pow (positive base), min and max.
+class Expression
+{
+public:
+	Expression() = default;
+	Expression( const QString& source, const std::vector<QString>& variables ) : _source( source )
+	{
+		_text = source.toStdString();
+		_variableNames = variables;
+		_used = std::vector<bool>( variables.size(), false );
+
+		this->parseSum();
+		this->skipWhitespace();
+		if( _position != _text.size() ) this->fail( "Unexpected character '" + std::string( 1, _text[_position] ) + "'" );
+
+		_text.clear();
+		_variableNames.clear();
+	}
+
+	// Getters for the source and whether a variable is used by the expression
+	const QString& source() const noexcept
+	{
+		return _source;
+	}
+	bool uses( int32_t variable ) const noexcept
+	{
+		return variable >= 0 && variable < static_cast<int32_t>( _used.size() ) && _used[variable];
+	}
+
+	// Evaluate the expression for 'count' values, 'inputs' contains a pointer to the values of every variable (unused variables may be nullptr)
+	void evaluate( const float* const* inputs, float* output, int64_t count ) const
+	{
+		auto stack = std::vector<float>( static_cast<size_t>( std::max( _stackSize, 1 ) ) * BlockSize );
+		for( int64_t begin = 0; begin < count; begin += BlockSize )
+		{
+			const auto size = static_cast<int32_t>( std::min<int64_t>( BlockSize, count - begin ) );
+			const auto padded = ( size + simd::Width - 1 ) / simd::Width * simd::Width;
+
+			auto top = static_cast<float*>( nullptr );
+			for( const auto& instruction : _program )
+			{
+				switch( instruction.op )
+				{
+				case Op::eConstant:
+					top = top ? top + BlockSize : stack.data();
+					std::fill( top, top + padded, instruction.constant );
+					break;
+				case Op::eVariable:
+					top = top ? top + BlockSize : stack.data();
+					std::copy( inputs[instruction.operand] + begin, inputs[instruction.operand] + begin + size, top );
+					std::fill( top + size, top + padded, 0.0f );
+					break;
+				case Op::eAdd: top = binary( top, padded, [] ( simd::floatv a, simd::floatv b ) { return a + b; } ); break;
+				case Op::eSubtract: top = binary( top, padded, [] ( simd::floatv a, simd::floatv b ) { return a - b; } ); break;
+				case Op::eMultiply: top = binary( top, padded, [] ( simd::floatv a, simd::floatv b ) { return a * b; } ); break;
+				case Op::eDivide: top = binary( top, padded, [] ( simd::floatv a, simd::floatv b ) { return a / b; } ); break;
+				case Op::eMinimum: top = binary( top, padded, [] ( simd::floatv a, simd::floatv b ) { return simd::min( a, b ); } ); break;
+				case Op::eMaximum: top = binary( top, padded, [] ( simd::floatv a, simd::floatv b ) { return simd::max( a, b ); } ); break;
+				case Op::ePower: top = binary( top, padded, [] ( simd::floatv a, simd::floatv b ) { return simd::exp( b * simd::log( a ) ); } ); break;
+				case Op::eNegate: unary( top, padded, [] ( simd::floatv a ) { return simd::floatv( 0.0f ) - a; } ); break;
+				case Op::eAbsolute: unary( top, padded, [] ( simd::floatv a ) { return simd::abs( a ); } ); break;
+				case Op::eSquareRoot: unary( top, padded, [] ( simd::floatv a ) { return simd::sqrt( a ); } ); break;
+				case Op::eExponential: unary( top, padded, [] ( simd::floatv a ) { return simd::exp( a ); } ); break;
+				case Op::eLogarithm: unary( top, padded, [] ( simd::floatv a ) { return simd::log( a ); } ); break;
+				case Op::eIntegerPower:
+				{
+					const auto exponent = instruction.operand;
+					unary( top, padded, [exponent] ( simd::floatv a ) { return integer_power( a, exponent ); } );
+					break;
+				}
+				}
+			}
+			std::copy( top, top + size, output + begin );
+		}
+	}
+
+private:
+	enum class Op : int32_t { eConstant, eVariable, eAdd, eSubtract, eMultiply, eDivide, eMinimum, eMaximum, ePower, eNegate, eAbsolute, eSquareRoot, eExponential, eLogarithm, eIntegerPower };
+
+	// Instruction of the postfix program (the operand is the variable index or the exponent of an integer power)
+	struct Instruction
+	{
+		Op op = Op::eConstant;
+		int32_t operand = 0;
+		float constant = 0.0f;
+	};
+
+	// Number of values that are processed per instruction
+	static constexpr int32_t BlockSize = 256;
+
+	template<typename Function> static void unary( float* top, int32_t count, Function function ) noexcept
+	{
+		for( int32_t i = 0; i < count; i += simd::Width ) function( simd::floatv::load( top + i ) ).store( top + i );
+	}
+	template<typename Function> static float* binary( float* top, int32_t count, Function function ) noexcept
+	{
+		const auto second = top;
+		top -= BlockSize;
+		for( int32_t i = 0; i < count; i += simd::Width ) function( simd::floatv::load( top + i ), simd::floatv::load( second + i ) ).store( top + i );
+		return top;
+	}
+	template<typename T> static T integer_power( T value, int32_t exponent ) noexcept
+	{
+		auto result = T( 1.0f );
+		for( auto power = std::abs( exponent ); power; power >>= 1, value = value * value ) if( power & 1 ) result = result * value;
+		return exponent < 0 ? T( 1.0f ) / result : result;
+	}
+
+	// Append an instruction, folding it into a constant if all of its operands are constants
+	void append( Instruction instruction )
+	{
+		const auto arity = instruction.op == Op::eConstant || instruction.op == Op::eVariable ? 0 : ( instruction.op <= Op::ePower ? 2 : 1 );
+		const auto constants = std::count_if( _program.end() - std::min<size_t>( arity, _program.size() ), _program.end(), [] ( const Instruction& other ) { return other.op == Op::eConstant; } );
+		if( arity && constants == arity )
+		{
+			const auto b = _program.back().constant;
+			if( arity == 2 ) _program.pop_back();
+			auto& a = _program.back().constant;
+			switch( instruction.op )
+			{
+			case Op::eAdd: a = a + b; break;
+			case Op::eSubtract: a = a - b; break;
+			case Op::eMultiply: a = a * b; break;
+			case Op::eDivide: a = a / b; break;
+			case Op::eMinimum: a = std::min( a, b ); break;
+			case Op::eMaximum: a = std::max( a, b ); break;
+			case Op::ePower: a = std::pow( a, b ); break;
+			case Op::eNegate: a = -a; break;
+			case Op::eAbsolute: a = std::abs( a ); break;
+			case Op::eSquareRoot: a = std::sqrt( a ); break;
+			case Op::eExponential: a = std::exp( a ); break;
+			case Op::eLogarithm: a = std::log( a ); break;
+			case Op::eIntegerPower: a = integer_power( a, instruction.operand ); break;
+			default: break;
+			}
+			_depth -= arity - 1;
+			return;
+		}
+
+		_program.push_back( instruction );
+		_depth += arity == 0 ? 1 : 1 - arity;
+		_stackSize = std::max( _stackSize, _depth );
+	}
+
+	// Recursive descent parser (sum -> product -> unary -> power -> primary)
+	void parseSum()
+	{
+		this->parseProduct();
+		while( this->accept( '+' ) || this->accept( '-' ) )
+		{
+			const auto op = _text[_position - 1] == '+' ? Op::eAdd : Op::eSubtract;
+			this->parseProduct();
+			this->append( { op } );
+		}
+	}
+	void parseProduct()
+	{
+		this->parseUnary();
+		while( this->accept( '*' ) || this->accept( '/' ) )
+		{
+			const auto op = _text[_position - 1] == '*' ? Op::eMultiply : Op::eDivide;
+			this->parseUnary();
+			this->append( { op } );
+		}
+	}
+	void parseUnary()
+	{
+		if( this->accept( '-' ) )
+		{
+			this->parseUnary();
+			this->append( { Op::eNegate } );
+		}
+		else if( this->accept( '+' ) ) this->parseUnary();
+		else this->parsePower();
+	}
+	void parsePower()
+	{
+		this->parsePrimary();
+		if( this->accept( '^' ) )
+		{
+			this->parseUnary();
+
+			// Expand integer exponents into multiplications (also valid for negative bases)
+			const auto& exponent = _program.back();
+			if( exponent.op == Op::eConstant && exponent.constant == std::round( exponent.constant ) && std::abs( exponent.constant ) <= 64.0f )
+			{
+				const auto power = static_cast<int32_t>( exponent.constant );
+				_program.pop_back();
+				--_depth;
+				this->append( { Op::eIntegerPower, power } );
+			}
+			else this->append( { Op::ePower } );
+		}
+	}
+	void parsePrimary()
+	{
+		this->skipWhitespace();
+		if( _position == _text.size() ) this->fail( "Unexpected end of expression" );
+
+		// Parenthesized subexpression
+		if( this->accept( '(' ) )
+		{
+			this->parseSum();
+			this->expect( ')' );
+			return;
+		}
+
+		// Number
+		const auto character = _text[_position];
+		if( std::isdigit( static_cast<unsigned char>( character ) ) || character == '.' )
+		{
+			// Numbers are parsed independently of the locale
+			auto value = 0.0f;
+			const auto [end, error] = std::from_chars( _text.data() + _position, _text.data() + _text.size(), value );
+			if( error == std::errc::invalid_argument ) this->fail( "Invalid number" );
+			if( error == std::errc::result_out_of_range ) this->fail( "Number out of range" );
+			_position = end - _text.data();
+			this->append( { Op::eConstant, 0, value } );
+			return;
+		}
+
+		// Quoted variable name
+		if( this->accept( '"' ) )
+		{
+			const auto end = _text.find( '"', _position );
+			if( end == std::string::npos ) this->fail( "Missing closing quote" );
+			const auto name = _text.substr( _position, end - _position );
+			_position = end + 1;
+			this->appendVariable( name );
+			return;
+		}
+
+		// Identifier (function, constant or variable)
+		if( !std::isalpha( static_cast<unsigned char>( character ) ) && character != '_' ) this->fail( "Unexpected character '" + std::string( 1, character ) + "'" );
+		const auto begin = _position;
+		while( _position < _text.size() && ( std::isalnum( static_cast<unsigned char>( _text[_position] ) ) || _text[_position] == '_' ) ) ++_position;
+		const auto name = _text.substr( begin, _position - begin );
+
+		const auto function = [&] ( Op op, int32_t arity )
+		{
+			this->expect( '(' );
+			for( int32_t i = 0; i < arity; ++i )
+			{
+				if( i ) this->expect( ',' );
+				this->parseSum();
+			}
+			this->expect( ')' );
+			this->append( { op } );
+		};
+
+		this->skipWhitespace();
+		const auto call = _position < _text.size() && _text[_position] == '(';
+		if( call && name == "abs" ) function( Op::eAbsolute, 1 );
+		else if( call && name == "sqrt" ) function( Op::eSquareRoot, 1 );
+		else if( call && name == "exp" ) function( Op::eExponential, 1 );
+		else if( call && name == "log" ) function( Op::eLogarithm, 1 );
+		else if( call && name == "pow" ) function( Op::ePower, 2 );
+		else if( call && name == "min" ) function( Op::eMinimum, 2 );
+		else if( call && name == "max" ) function( Op::eMaximum, 2 );
+		else if( call ) this->fail( "Unknown function '" + name + "'" );
+		else if( name == "pi" ) this->append( { Op::eConstant, 0, 3.14159265358979f } );
+		else this->appendVariable( name );
+	}
+	void appendVariable( const std::string& name )
+	{
+		const auto it = std::find( _variableNames.begin(), _variableNames.end(), QString::fromStdString( name ) );
+		if( it == _variableNames.end() ) this->fail( "Unknown variable '" + name + "'" );
+
+		const auto index = static_cast<int32_t>( it - _variableNames.begin() );
+		_used[index] = true;
+		this->append( { Op::eVariable, index } );
+	}
+
+	// Helper functions for the tokens
+	void skipWhitespace() noexcept
+	{
+		while( _position < _text.size() && std::isspace( static_cast<unsigned char>( _text[_position] ) ) ) ++_position;
+	}
+	bool accept( char character ) noexcept
+	{
+		this->skipWhitespace();
+		if( _position < _text.size() && _text[_position] == character )
+		{
+			++_position;
+			return true;
+		}
+		return false;
+	}
+	void expect( char character )
+	{
+		if( !this->accept( character ) ) this->fail( "Expected '" + std::string( 1, character ) + "'" );
+	}
+	[[noreturn]] void fail( const std::string& message ) const
+	{
+		throw std::invalid_argument( "Expression::Expression -> " + message + " at position " + std::to_string( _position ) + " in '" + _text + "'." );
+	}
+
+	QString _source;
+	std::vector<Instruction> _program;
+	std::vector<bool> _used;
+	int32_t _stackSize = 0;
+
+	// State of the parser
+	std::string _text;
+	std::vector<QString> _variableNames;
+	size_t _position = 0;
+	int32_t _depth = 0;
+};
\ No newline at end of file
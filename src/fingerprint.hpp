@@ -0,0 +1,89 @@
+#pragma once
+#include "utility.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Content fingerprints (64-bit hashes) that serve as O(1) equality checks and as keys of caches. Data is hashed with XXH64 (https://github.com/Cyan4973/xxHash)
+// in chunks of a fixed size in parallel and the hashes of the chunks are hashed again, so fingerprints don't depend on the number of threads.
+namespace fingerprint
+{
+	// Size of the chunks that are hashed in parallel
+	constexpr size_t ChunkSize = size_t( 1 ) << 20;
+
+	// Primes of XXH64
+	constexpr uint64_t Prime1 = 11400714785074694791ull;
+	constexpr uint64_t Prime2 = 14029467366897019727ull;
+	constexpr uint64_t Prime3 = 1609587929392839161ull;
+	constexpr uint64_t Prime4 = 9650029242287828579ull;
+	constexpr uint64_t Prime5 = 2870177450012600261ull;
+
+	inline uint64_t rotate_left( uint64_t value, int32_t bits ) noexcept
+	{
+		return ( value << bits ) | ( value >> ( 64 - bits ) );
+	}
+	inline uint64_t round( uint64_t accumulator, uint64_t input ) noexcept
+	{
+		return rotate_left( accumulator + input * Prime2, 31 ) * Prime1;
+	}
+	template<typename T> T read( const uint8_t* source ) noexcept
+	{
+		auto value = T();
+		std::memcpy( &value, source, sizeof( T ) );
+		return value;
+	}
+
+	// Hash bytes with XXH64 (serial)
+	inline uint64_t xxh64( const void* data, size_t bytes, uint64_t seed = 0 ) noexcept
+	{
+		auto source = static_cast<const uint8_t*>( data );
+		const auto end = source + bytes;
+
+		// Process stripes of 32 bytes with four accumulators
+		auto hash = seed + Prime5;
+		if( bytes >= 32 )
+		{
+			uint64_t accumulators[4] = { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+			for( ; end - source >= 32; source += 32 )
+				for( int32_t i = 0; i < 4; ++i ) accumulators[i] = round( accumulators[i], read<uint64_t>( source + i * 8 ) );
+
+			hash = rotate_left( accumulators[0], 1 ) + rotate_left( accumulators[1], 7 ) + rotate_left( accumulators[2], 12 ) + rotate_left( accumulators[3], 18 );
+			for( const auto accumulator : accumulators ) hash = ( hash ^ round( 0, accumulator ) ) * Prime1 + Prime4;
+		}
+		hash += bytes;
+
+		// Process the remaining bytes and mix the bits of the hash
+		for( ; end - source >= 8; source += 8 ) hash = rotate_left( hash ^ round( 0, read<uint64_t>( source ) ), 27 ) * Prime1 + Prime4;
+		if( end - source >= 4 )
+		{
+			hash = rotate_left( hash ^ ( read<uint32_t>( source ) * Prime1 ), 23 ) * Prime2 + Prime3;
+			source += 4;
+		}
+		for( ; source < end; ++source ) hash = rotate_left( hash ^ ( *source * Prime5 ), 11 ) * Prime1;
+
+		hash = ( hash ^ ( hash >> 33 ) ) * Prime2;
+		hash = ( hash ^ ( hash >> 29 ) ) * Prime3;
+		return hash ^ ( hash >> 32 );
+	}
+
+	// Hash bytes in chunks in parallel (data of up to one chunk is hashed directly)
+	inline uint64_t compute( const void* data, size_t bytes, uint64_t seed = 0 )
+	{
+		if( bytes <= ChunkSize ) return xxh64( data, bytes, seed );
+
+		auto hashes = std::vector<uint64_t>( ( bytes + ChunkSize - 1 ) / ChunkSize );
+		util::compute_multi_threaded( 0, static_cast<int32_t>( hashes.size() ), [&] ( int32_t begin, int32_t end )
+		{
+			for( int32_t i = begin; i < end; ++i )
+				hashes[i] = xxh64( static_cast<const uint8_t*>( data ) + i * ChunkSize, std::min( ChunkSize, bytes - i * ChunkSize ), seed );
+		} );
+		return xxh64( hashes.data(), hashes.size() * sizeof( uint64_t ), seed + bytes );
+	}
+
+	// Combine fingerprints (or trivially copyable values) in order
+	template<typename T> uint64_t combine( uint64_t seed, const T& value ) noexcept
+	{
+		return xxh64( &value, sizeof( T ), seed );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+#include "math.hpp"
+
+#include <hdf5.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Read-only HDF5 file whose three-dimensional datasets are read as float values in hyperslabs of layers along the first (slowest) dimension, which matches
+// the order of Volume. Builds of the HDF5 library without thread-safety are not reentrant, so all calls are serialized in that case. Datasets are opened
+// once. Contiguous datasets of native floats are read with positional reads of the file that bypass the library, so reads of several threads overlap;
+// all other datasets (chunked, compressed or converted) are read by the library.
+class HDF5File
+{
+public:
+	HDF5File( const std::filesystem::path& filepath ) : _filepath( filepath )
+	{
+		const auto lock = HDF5File::lock();
+		_file = H5Fopen( filepath.string().c_str(), H5F_ACC_RDONLY, H5P_DEFAULT );
+		if( _file < 0 ) throw std::runtime_error( "HDF5File::HDF5File -> Failed to open file " + filepath.string() );
+	}
+	HDF5File( const HDF5File& ) = delete;
+	HDF5File& operator=( const HDF5File& ) = delete;
+	~HDF5File()
+	{
+		const auto lock = HDF5File::lock();
+		for( const auto& [name, dataset] : _datasets ) H5Dclose( dataset.id );
+		H5Fclose( _file );
+	}
+
+	// Check whether a file is an HDF5 file
+	static bool isHDF5( const std::filesystem::path& filepath )
+	{
+		const auto lock = HDF5File::lock();
+		return H5Fis_hdf5( filepath.string().c_str() ) > 0;
+	}
+
+	// Getter for the names of the three-dimensional datasets in the root group
+	std::vector<std::string> datasets() const
+	{
+		const auto lock = HDF5File::lock();
+		auto names = std::vector<std::string>();
+		H5Literate( _file, H5_INDEX_NAME, H5_ITER_INC, nullptr, [] ( hid_t group, const char* name, const H5L_info_t*, void* data ) -> herr_t
+		{
+			// Links that aren't datasets fail to open (errors are not printed)
+			if( const auto dataset = H5Dopen2( group, name, H5P_DEFAULT ); dataset >= 0 )
+			{
+				const auto space = H5Dget_space( dataset );
+				if( H5Sget_simple_extent_ndims( space ) == 3 ) static_cast<std::vector<std::string>*>( data )->push_back( name );
+				H5Sclose( space );
+				H5Dclose( dataset );
+			}
+			return 0;
+		}, &names );
+		return names;
+	}
+
+	// Getter for the dimensions of a three-dimensional dataset
+	vec3i dimensions( const std::string& name ) const
+	{
+		return this->dataset( name ).dimensions;
+	}
+
+	// Read 'count' layers along the first dimension, starting at layer 'begin', into the values (the library converts the values to float)
+	void read( const std::string& name, int32_t begin, int32_t count, float* values ) const
+	{
+		const auto& dataset = this->dataset( name );
+		const auto layerSize = static_cast<uint64_t>( dataset.dimensions.y ) * dataset.dimensions.z;
+		if( begin < 0 || count < 0 || begin + count > dataset.dimensions.x ) throw std::invalid_argument( "HDF5File::read -> Invalid layers of dataset '" + name + "'." );
+
+		// Contiguous native floats are read directly from the file without locking the library
+		if( dataset.offset != HADDR_UNDEF )
+		{
+			auto stream = std::ifstream( _filepath, std::ios::in | std::ios::binary );
+			stream.seekg( dataset.offset + begin * layerSize * sizeof( float ) );
+			if( !stream.read( reinterpret_cast<char*>( values ), count * layerSize * sizeof( float ) ) ) throw std::runtime_error( "HDF5File::read -> Failed to read dataset '" + name + "' of file " + _filepath.string() );
+			return;
+		}
+
+		const auto lock = HDF5File::lock();
+		const auto space = H5Dget_space( dataset.id );
+		const hsize_t offset[3] = { static_cast<hsize_t>( begin ), 0, 0 };
+		const hsize_t extent[3] = { static_cast<hsize_t>( count ), static_cast<hsize_t>( dataset.dimensions.y ), static_cast<hsize_t>( dataset.dimensions.z ) };
+		const auto memory = H5Screate_simple( 3, extent, nullptr );
+		const auto success = H5Sselect_hyperslab( space, H5S_SELECT_SET, offset, nullptr, extent, nullptr ) >= 0
+			&& H5Dread( dataset.id, H5T_NATIVE_FLOAT, memory, space, H5P_DEFAULT, values ) >= 0;
+		H5Sclose( memory );
+		H5Sclose( space );
+		if( !success ) throw std::runtime_error( "HDF5File::read -> Failed to read dataset '" + name + "' of file " + _filepath.string() );
+	}
+
+private:
+	// Opened dataset with its dimensions and the offset of its values in the file (undefined unless the values are stored contiguously as native floats)
+	struct Dataset
+	{
+		hid_t id = -1;
+		vec3i dimensions;
+		haddr_t offset = HADDR_UNDEF;
+	};
+
+	// Return an opened three-dimensional dataset, datasets are opened on first access and closed with the file
+	const Dataset& dataset( const std::string& name ) const
+	{
+		const auto datasetsLock = std::scoped_lock( _mutex );
+		if( const auto it = _datasets.find( name ); it != _datasets.end() ) return it->second;
+
+		const auto lock = HDF5File::lock();
+		auto dataset = Dataset();
+		dataset.id = H5Dopen2( _file, name.c_str(), H5P_DEFAULT );
+		if( dataset.id < 0 ) throw std::runtime_error( "HDF5File::dataset -> Dataset '" + name + "' doesn't exist in file " + _filepath.string() );
+
+		const auto space = H5Dget_space( dataset.id );
+		hsize_t dimensions[3] = {};
+		const auto valid = H5Sget_simple_extent_ndims( space ) == 3 && H5Sget_simple_extent_dims( space, dimensions, nullptr ) == 3;
+		H5Sclose( space );
+		if( !valid )
+		{
+			H5Dclose( dataset.id );
+			throw std::runtime_error( "HDF5File::dataset -> Dataset '" + name + "' of file " + _filepath.string() + " is not three-dimensional." );
+		}
+		dataset.dimensions = vec3i( static_cast<int32_t>( dimensions[0] ), static_cast<int32_t>( dimensions[1] ), static_cast<int32_t>( dimensions[2] ) );
+
+		// The offset is only defined for contiguous datasets whose values are allocated (filters require chunks), the values must not need a conversion
+		const auto type = H5Dget_type( dataset.id );
+		const auto properties = H5Dget_create_plist( dataset.id );
+		if( H5Tequal( type, H5T_NATIVE_FLOAT ) > 0 && H5Pget_layout( properties ) == H5D_CONTIGUOUS ) dataset.offset = H5Dget_offset( dataset.id );
+		H5Pclose( properties );
+		H5Tclose( type );
+
+		return _datasets.emplace( name, dataset ).first->second;
+	}
+
+	// Lock the library if it isn't thread-safe (the returned lock doesn't own a mutex otherwise) and disable printing errors for the calling thread
+	static std::unique_lock<std::mutex> lock()
+	{
+#ifdef H5_HAVE_THREADSAFE
+		auto lock = std::unique_lock<std::mutex>();
+#else
+		static auto mutex = std::mutex();
+		auto lock = std::unique_lock<std::mutex>( mutex );
+#endif
+		H5Eset_auto2( H5E_DEFAULT, nullptr, nullptr );
+		return lock;
+	}
+
+	std::filesystem::path _filepath;
+	hid_t _file = -1;
+	mutable std::map<std::string, Dataset> _datasets;
+	mutable std::mutex _mutex;
+};
\ No newline at end of file
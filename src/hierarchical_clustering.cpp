@@ -54,7 +54,7 @@ HCNode::HCNode( int32_t count, const std::function<float( int32_t, int32_t )>&si
 	*this = std::move( *nodes.front() );
 	delete nodes.front();
 }
-HCNode::HCNode( std::ifstream & stream ) : _value(), _parent(), _left(), _right(), _similarity(), _valueCount(), _width(), _height()
+HCNode::HCNode( std::istream & stream ) : _value(), _parent(), _left(), _right(), _similarity(), _valueCount(), _width(), _height()
 {
 	// Read dendrogram recursively
 	stream.read( reinterpret_cast<char*>( &_valueCount ), sizeof( int32_t ) );
@@ -112,7 +112,7 @@ HCNode& HCNode::operator=( HCNode && other )
 	return *this;
 }
 
-void HCNode::save( std::ofstream & stream ) const
+void HCNode::save( std::ostream & stream ) const
 {
 	// Save dendrogram recursively
 	stream.write( reinterpret_cast<const char*>( &_valueCount ), sizeof( _valueCount ) );
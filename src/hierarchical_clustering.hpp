@@ -21,7 +21,7 @@ public:
 	HCNode( int32_t count, const std::function<float( int32_t, int32_t )>& similarityFunction );
 
 	// Read a dendrogram from a file
-	HCNode( std::ifstream& stream );
+	HCNode( std::istream& stream );
 
 	// Copying dendrogram leads to problems, so prevent it
 	HCNode( const HCNode& ) = delete;
@@ -32,7 +32,7 @@ public:
 	HCNode& operator=( HCNode&& other );
 
 	// Save a dendrogram to a file
-	void save( std::ofstream& stream ) const;
+	void save( std::ostream& stream ) const;
 
 	// Getter for the value of a leaf
 	bool hasValue() const noexcept;
@@ -0,0 +1,110 @@
+#pragma once
+#include "volume.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Volume of per-voxel histograms over the members of an ensemble, stored as interleaved bin counts ([voxel][bin]). Counts use 8 bits for up to 255 members
+// and 16 bits otherwise, so a histogram with five bins needs 5 or 10 bytes per voxel instead of 20 bytes for five normalized float volumes.
+class HistogramVolume
+{
+public:
+	HistogramVolume() noexcept = default;
+	HistogramVolume( vec3i dimensions, std::vector<double> edges, int32_t memberCount ) : _dimensions( dimensions ), _edges( std::move( edges ) ), _memberCount( memberCount )
+	{
+		if( memberCount > std::numeric_limits<uint16_t>::max() ) throw std::runtime_error( "HistogramVolume::HistogramVolume -> Member count exceeds 16-bit counts" );
+
+		const auto size = static_cast<size_t>( dimensions.product() ) * this->binCount();
+		if( memberCount <= std::numeric_limits<uint8_t>::max() ) _counts8.resize( size );
+		else _counts16.resize( size );
+	}
+
+	// Read the histogram from a stream or save it to a stream
+	HistogramVolume( std::istream& stream )
+	{
+		util::read_binary( stream, _dimensions );
+		util::read_binary_vector( stream, _edges );
+		util::read_binary( stream, _memberCount );
+		util::read_binary_vector( stream, _counts8 );
+		util::read_binary_vector( stream, _counts16 );
+
+		const auto size = static_cast<size_t>( _dimensions.product() ) * this->binCount();
+		if( _counts8.size() + _counts16.size() != size ) throw std::runtime_error( "HistogramVolume::HistogramVolume -> Size of the counts doesn't match." );
+	}
+	void save( std::ostream& stream ) const
+	{
+		util::write_binary( stream, _dimensions );
+		util::write_binary_vector( stream, _edges );
+		util::write_binary( stream, _memberCount );
+		util::write_binary_vector( stream, _counts8 );
+		util::write_binary_vector( stream, _counts16 );
+	}
+
+	// Getters for basic statistics
+	vec3i dimensions() const noexcept
+	{
+		return _dimensions;
+	}
+	int32_t binCount() const noexcept
+	{
+		return static_cast<int32_t>( _edges.size() ) + 1;
+	}
+	int32_t memberCount() const noexcept
+	{
+		return _memberCount;
+	}
+	bool empty() const noexcept
+	{
+		return _counts8.empty() && _counts16.empty();
+	}
+	size_t bytes() const noexcept
+	{
+		return _counts8.size() * sizeof( uint8_t ) + _counts16.size() * sizeof( uint16_t );
+	}
+
+	// Getter for the upper (inclusive) edges of all bins but the last
+	const std::vector<double>& edges() const noexcept
+	{
+		return _edges;
+	}
+
+	// Return the bin of a value, bins are left-open intervals (edge[bin - 1], edge[bin]]
+	int32_t bin( double value ) const noexcept
+	{
+		return static_cast<int32_t>( std::lower_bound( _edges.begin(), _edges.end(), value ) - _edges.begin() );
+	}
+
+	// Setter and getter for the counts of a voxel
+	void setCounts( int32_t index, const int32_t* counts ) noexcept
+	{
+		const auto offset = static_cast<size_t>( index ) * this->binCount();
+		if( _counts16.empty() ) for( int32_t i = 0; i < this->binCount(); ++i ) _counts8[offset + i] = static_cast<uint8_t>( counts[i] );
+		else for( int32_t i = 0; i < this->binCount(); ++i ) _counts16[offset + i] = static_cast<uint16_t>( counts[i] );
+	}
+	int32_t count( int32_t index, int32_t bin ) const noexcept
+	{
+		const auto offset = static_cast<size_t>( index ) * this->binCount() + bin;
+		return _counts16.empty() ? _counts8[offset] : _counts16[offset];
+	}
+
+	// Return the counts of a single bin normalized by the member count
+	Volume<float> normalized( int32_t bin, QString name ) const
+	{
+		auto volume = Volume<float>( _dimensions, std::move( name ) );
+		util::compute_multi_threaded( 0, volume.voxelCount(), [&] ( int32_t begin, int32_t end )
+		{
+			for( int32_t i = begin; i < end; ++i )
+				volume.at( i ) = static_cast<float>( this->count( i, bin ) ) / _memberCount;
+		} );
+		return volume;
+	}
+
+private:
+	vec3i _dimensions;
+	std::vector<double> _edges;
+	int32_t _memberCount = 0;
+	std::vector<uint8_t> _counts8;
+	std::vector<uint16_t> _counts16;
+};
\ No newline at end of file
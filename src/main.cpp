@@ -1,3 +1,4 @@
+#include "disk_cache.hpp"
 #include "window.hpp"
 
 #include <qapplication.h>
@@ -5,9 +6,26 @@
 #include <qfont.h>
 #include <qicon.h>
 #include <qoffscreensurface.h>
+#include <qstandardpaths.h>
 
+#include <charconv>
+#include <cstring>
 #include <iostream>
 
+// Usage of the optional command line arguments (the dataset is selected in a dialog if no path is given)
+static constexpr auto Usage = "Usage: reghievis [path | teardrop | tangle | spheres] [histogram bins] [main memory MiB] [graphics memory MiB] [name=expression ...]";
+
+// Parse a non-negative integer argument (unsigned decimal digits only) that is at most 'maximum'
+static uint64_t parse_count( const char* text, const char* name, uint64_t maximum )
+{
+	auto value = uint64_t( 0 );
+	const auto end = text + std::strlen( text );
+	const auto [last, error] = std::from_chars( text, end, value );
+	if( error != std::errc() || last != end || last == text || value > maximum )
+		throw std::invalid_argument( "Invalid " + std::string( name ) + " '" + text + "', expected an integer between 0 and " + std::to_string( maximum ) + "." );
+	return value;
+}
+
 int main( int argc, char** argv )
 {
 	try
@@ -35,8 +53,34 @@ int main( int argc, char** argv )
 		else if( filepath.isEmpty() ) filepath = QFileDialog::getOpenFileName( nullptr, "Open File", "../datasets" );
 		if( filepath.isEmpty() ) return EXIT_SUCCESS;
 
+		// Get the number of z-score histogram bins (optional, at least one bin)
+		const auto histogramBinCount = argc > 2 ? static_cast<int32_t>( parse_count( argv[2], "histogram bin count", std::numeric_limits<int32_t>::max() ) ) : 5;
+		if( histogramBinCount < 1 ) throw std::invalid_argument( "Invalid histogram bin count '" + std::string( argv[2] ) + "', expected at least one bin." );
+
+		// Get the memory budgets for main memory and graphics memory in MiB (optional, unlimited by default or if zero)
+		const auto maximumMebibytes = std::numeric_limits<uint64_t>::max() >> 20;
+		if( const auto budget = argc > 3 ? parse_count( argv[3], "main memory budget", maximumMebibytes ) : 0 ) util::memory_budget().setBudget( util::MemoryBudget::Pool::eHost, budget << 20 );
+		if( const auto budget = argc > 4 ? parse_count( argv[4], "graphics memory budget", maximumMebibytes ) : 0 ) util::memory_budget().setBudget( util::MemoryBudget::Pool::eDevice, budget << 20 );
+
+		// Cache expensive derived data (PCA, histograms, similarities, dendrograms, ...) on disk across runs. The directory and the size limit in MiB can be
+		// changed using the environment variables REGHIEVIS_CACHE and REGHIEVIS_CACHE_LIMIT (an empty directory disables the cache).
+		if( const auto directory = std::getenv( "REGHIEVIS_CACHE" ) ) util::disk_cache().setDirectory( directory );
+		else util::disk_cache().setDirectory( ( QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + "/derived" ).toStdString() );
+		if( const auto limit = std::getenv( "REGHIEVIS_CACHE_LIMIT" ) ) util::disk_cache().setLimit( parse_count( limit, "disk cache limit (REGHIEVIS_CACHE_LIMIT)", maximumMebibytes ) << 20 );
+
+		// Get the definitions of virtual fields as "name=expression" (optional, e.g. "Speed=sqrt(U^2 + V^2 + W^2)"). For a directory of HDF5 member files,
+		// the fields are imported from the datasets instead (all three-dimensional datasets if none are defined).
+		auto fields = std::vector<std::pair<QString, QString>>();
+		for( int32_t i = 5; i < argc; ++i )
+		{
+			const auto definition = QString( argv[i] );
+			const auto separator = definition.indexOf( '=' );
+			if( separator <= 0 ) throw std::invalid_argument( "Invalid field definition '" + definition.toStdString() + "', expected 'name=expression'." );
+			fields.emplace_back( definition.left( separator ).trimmed(), definition.mid( separator + 1 ) );
+		}
+
 		// Create and show man window
-		auto window = Window( filepath.toStdString() );
+		auto window = Window( filepath.toStdString(), histogramBinCount, fields );
 		window.setWindowTitle( "Ensemble Visualization" );
 		window.setWindowIcon( QIcon( ":/cube.png" ) );
 		window.setMinimumSize( QSize( 1280, 720 ) );
@@ -44,7 +88,11 @@ int main( int argc, char** argv )
 
 		return app.exec();
 
-	} catch( std::exception e )
+	} catch( const std::invalid_argument& e )
+	{
+		std::cerr << "[Error]: " << e.what() << std::endl << Usage << std::endl;
+		return EXIT_FAILURE;
+	} catch( const std::exception& e )
 	{
 		std::cerr << "[Error]: " << e.what() << std::endl;
 		return EXIT_FAILURE;
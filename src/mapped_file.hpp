@@ -0,0 +1,256 @@
+#pragma once
+#include "fingerprint.hpp"
+
+#include <qfile.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/file.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+// File that is memory-mapped as a whole. The mapping is private (copy-on-write), so volumes can wrap the mapped values without copying them and
+// even modify them without changing the file. Pages are only read on first access and are shared with other processes through the page cache.
+// Pages that weren't modified still show later writes to the file, so every mapping holds a shared advisory lock of the file (see ExclusiveLock).
+class MappedFile
+{
+public:
+	MappedFile( const std::filesystem::path& filepath ) : _file( QString::fromStdString( filepath.string() ) )
+	{
+		if( !_file.open( QIODevice::ReadOnly ) ) throw std::runtime_error( "MappedFile::MappedFile -> Failed to open file " + filepath.string() );
+		this->lock( false );
+		_size = static_cast<uint64_t>( _file.size() );
+		_data = _file.map( 0, static_cast<qint64>( _size ), QFileDevice::MapPrivateOption );
+		if( !_data ) throw std::runtime_error( "MappedFile::MappedFile -> Failed to map file " + filepath.string() );
+	}
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+	~MappedFile()
+	{
+		_file.unmap( _data );
+	}
+
+	// Getters for the size and the mapped data at an offset (checks that 'bytes' bytes are within the file)
+	uint64_t size() const noexcept
+	{
+		return _size;
+	}
+	template<typename T> T* data( uint64_t offset, uint64_t bytes ) const
+	{
+		if( offset > _size || bytes > _size - offset ) throw std::runtime_error( "MappedFile::data -> Range exceeds the file, the file is probably truncated." );
+		return reinterpret_cast<T*>( _data + offset );
+	}
+
+	// Check whether data lies within the mapping and return its offset in the file
+	bool contains( const void* data, uint64_t bytes ) const noexcept
+	{
+		const auto address = reinterpret_cast<const uchar*>( data );
+		return address >= _data && address <= _data + _size && bytes <= static_cast<uint64_t>( _data + _size - address );
+	}
+	uint64_t offset( const void* data ) const noexcept
+	{
+		return static_cast<uint64_t>( reinterpret_cast<const uchar*>( data ) - _data );
+	}
+
+	// Exclusive lock of a mapped file, which is only acquired while no other mapping of the file exists (in this or another process). New mappings wait
+	// until it is released, so updates in place may reuse ranges of the file while they hold the lock (older mappings might still refer to them otherwise).
+	// Without support for advisory locks, the lock is never acquired.
+	class ExclusiveLock
+	{
+	public:
+		ExclusiveLock( const MappedFile& file ) : _file( file ), _locked( file.lock( true ) )
+		{
+			// A failed conversion may have released the shared lock
+			if( !_locked ) _file.lock( false );
+		}
+		ExclusiveLock( const ExclusiveLock& ) = delete;
+		ExclusiveLock& operator=( const ExclusiveLock& ) = delete;
+		~ExclusiveLock()
+		{
+			if( _locked ) _file.lock( false );
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return _locked;
+		}
+
+	private:
+		const MappedFile& _file;
+		bool _locked = false;
+	};
+
+	// Write the data of the file to the disk (e.g. before a header that refers to it is written)
+	static void sync( const std::filesystem::path& filepath )
+	{
+		auto file = QFile( QString::fromStdString( filepath.string() ) );
+		if( !file.open( QIODevice::ReadWrite ) ) throw std::runtime_error( "MappedFile::sync -> Failed to open file " + filepath.string() );
+#ifndef _WIN32
+		const auto synced = ::fsync( file.handle() ) == 0;
+#else
+		const auto synced = ::_commit( file.handle() ) == 0;
+#endif
+		if( !synced ) throw std::runtime_error( "MappedFile::sync -> Failed to write file " + filepath.string() + " to the disk." );
+	}
+
+	// Range of bytes in a file
+	struct Range
+	{
+		uint64_t offset = 0;
+		uint64_t bytes = 0;
+	};
+
+	// Size of the pages that data in mapped files is aligned to
+	static constexpr uint64_t PageSize = 4096;
+
+	// Pad the stream to the next page boundary and write the data, returns the offset of the data
+	static uint64_t writeAligned( std::ostream& stream, const void* data, uint64_t bytes )
+	{
+		const auto position = static_cast<uint64_t>( stream.tellp() );
+		const auto offset = ( position + PageSize - 1 ) / PageSize * PageSize;
+		const auto padding = std::string( offset - position, '\0' );
+		stream.write( padding.data(), padding.size() );
+		stream.write( reinterpret_cast<const char*>( data ), bytes );
+		return offset;
+	}
+
+private:
+	// Lock the file shared (waits for an exclusive lock) or try to lock it exclusively (converting the shared lock of the mapping)
+	bool lock( bool exclusive ) const
+	{
+#ifndef _WIN32
+		return ::flock( _file.handle(), exclusive ? LOCK_EX | LOCK_NB : LOCK_SH ) == 0;
+#else
+		return !exclusive;
+#endif
+	}
+
+	mutable QFile _file;
+	uint64_t _size = 0;
+	uchar* _data = nullptr;
+};
+
+// Writer for the page-aligned data of mapped files, which returns the offsets that are stored in the directory of the file. When a mapped file is updated
+// in place, data that lies in its mapping (e.g. volumes that wrap the file) is kept where it is, other data is written to reusable free ranges or appended.
+// Reusable ranges must not be referenced by the mapping's users, i.e. they have to be free since the file was mapped, and are only written while no other
+// mapping exists (see MappedFile::ExclusiveLock). Data that was written by the previous update isn't mapped, so it is identified by its hash and size and
+// kept where it is while it is unchanged.
+class MappedFileWriter
+{
+public:
+	// Offsets of data that was written by an update, the keys are the hash and the size of the data
+	using WrittenRanges = std::multimap<std::pair<uint64_t, uint64_t>, uint64_t>;
+
+	// Write the data of a new file, starting at the current position of the stream
+	MappedFileWriter( std::ostream& stream ) : _stream( stream ), _end( static_cast<uint64_t>( stream.tellp() ) ), _used( 1, MappedFile::Range { 0, _end } )
+	{}
+
+	// Update a mapped file in place, 'stream' writes to the file, which has a size of 'end' bytes (the first page contains the header). Reusable ranges are
+	// only written if 'reuse' is set, otherwise all new data is appended (the ranges stay reusable for later updates).
+	MappedFileWriter( std::ostream& stream, std::shared_ptr<const MappedFile> file, uint64_t end, std::vector<MappedFile::Range> reusable, WrittenRanges written, bool reuse ) :
+		_stream( stream ), _file( std::move( file ) ), _end( end ), _reusable( std::move( reusable ) ), _previous( std::move( written ) ), _used( 1, MappedFile::Range { 0, MappedFile::PageSize } ),
+		_reuse( reuse )
+	{}
+
+	// Write the data (or keep it, if it lies in the mapped file) and return its offset
+	uint64_t write( const void* data, uint64_t bytes )
+	{
+		if( !_file ) return this->append( data, bytes );
+		if( _file->contains( data, bytes ) ) return this->use( _file->offset( data ), bytes );
+
+		// Keep data of the previous update (every range is used once, so equal data of different owners isn't shared)
+		const auto key = std::make_pair( fingerprint::xxh64( data, bytes ), bytes );
+		if( const auto it = _previous.find( key ); it != _previous.end() )
+		{
+			const auto offset = it->second;
+			_previous.erase( it );
+			_written.emplace( key, offset );
+			return this->use( offset, bytes );
+		}
+
+		// Use the first reusable range that is large enough (the ranges start at page boundaries)
+		auto offset = uint64_t( 0 );
+		const auto range = !_reuse ? _reusable.end() : std::find_if( _reusable.begin(), _reusable.end(), [bytes] ( const MappedFile::Range& range ) { return range.bytes >= bytes; } );
+		if( range != _reusable.end() )
+		{
+			offset = range->offset;
+			const auto size = std::min( range->bytes, ( bytes + MappedFile::PageSize - 1 ) / MappedFile::PageSize * MappedFile::PageSize );
+			*range = MappedFile::Range { range->offset + size, range->bytes - size };
+			_stream.seekp( offset );
+			_stream.write( reinterpret_cast<const char*>( data ), bytes );
+			this->use( offset, bytes );
+		}
+		else offset = this->append( data, bytes );
+		_written.emplace( key, offset );
+		return offset;
+	}
+
+	// Append the data to the end of the file and return its offset
+	uint64_t append( const void* data, uint64_t bytes )
+	{
+		_stream.seekp( _end );
+		const auto offset = MappedFile::writeAligned( _stream, data, bytes );
+		_end = offset + bytes;
+		return this->use( offset, bytes );
+	}
+
+	// Getter for the free ranges of the file, i.e. whole pages that are not used by the data written so far
+	std::vector<MappedFile::Range> freeRanges() const
+	{
+		auto used = _used;
+		std::sort( used.begin(), used.end(), [] ( const MappedFile::Range& a, const MappedFile::Range& b ) { return a.offset < b.offset; } );
+
+		auto ranges = std::vector<MappedFile::Range>();
+		auto position = uint64_t( 0 );
+		for( const auto& range : used )
+		{
+			const auto begin = ( position + MappedFile::PageSize - 1 ) / MappedFile::PageSize * MappedFile::PageSize;
+			if( range.offset > begin ) ranges.push_back( MappedFile::Range { begin, range.offset - begin } );
+			position = std::max( position, range.offset + range.bytes );
+		}
+		return ranges;
+	}
+
+	// Getter for the reusable ranges that were not used (yet), data of the previous update that was not kept isn't mapped either, so its ranges are reusable
+	std::vector<MappedFile::Range> reusableRanges() const
+	{
+		auto ranges = std::vector<MappedFile::Range>();
+		for( const auto& range : _reusable ) if( range.bytes ) ranges.push_back( range );
+		for( const auto& [key, offset] : _previous ) ranges.push_back( MappedFile::Range { offset, key.second } );
+		return ranges;
+	}
+
+	// Getter for the data that was written by this update (and isn't mapped)
+	const WrittenRanges& writtenRanges() const noexcept
+	{
+		return _written;
+	}
+
+private:
+	// Mark the range as used and return its offset
+	uint64_t use( uint64_t offset, uint64_t bytes )
+	{
+		_used.push_back( MappedFile::Range { offset, bytes } );
+		return offset;
+	}
+
+	std::ostream& _stream;
+	std::shared_ptr<const MappedFile> _file;
+	uint64_t _end = 0;
+	std::vector<MappedFile::Range> _reusable;
+	WrittenRanges _previous;
+	WrittenRanges _written;
+	std::vector<MappedFile::Range> _used;
+	bool _reuse = false;
+};
\ No newline at end of file
@@ -0,0 +1,246 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace util
+{
+	// Registry that accounts the memory of cached data (derived volumes, histograms, textures, ...) and evicts entries to stay within a budget per memory pool.
+	// Entries are identified by their owner (e.g. the address of a volume) and category. Eviction is cost-aware LRU (GreedyDual-Size): every access gives an entry
+	// the priority 'clock + cost / bytes', the entry with the lowest priority is evicted first and advances the clock, so cheap and large entries go first.
+	// Entries can be added, touched and removed from any thread. Evictions only happen in collect(), which has to be called at a safe point, i.e. on the GUI thread
+	// while no computation holds references to evictable data. Owners that are pinned (e.g. volumes on screen) are never evicted.
+	class MemoryBudget
+	{
+	public:
+		// Enums for the memory pools (main memory and graphics memory) and the categories of cached data
+		enum class Pool : int32_t { eHost, eDevice };
+		enum class Category : int32_t { eMembers, eMemberVolume, eDerivedVolume, eHistogram, eSimilarity, eGradient, eTexture };
+
+		// Memory usage of a category
+		struct Usage
+		{
+			size_t bytes = 0;
+			size_t pinnedBytes = 0;
+			size_t evictableBytes = 0;
+			int32_t entries = 0;
+		};
+
+		// Scoped pin of one or more owners, pins are counted so owners can be pinned multiple times
+		class Pin
+		{
+		public:
+			Pin() noexcept = default;
+			Pin( std::vector<const void*> owners, MemoryBudget& budget ) : _budget( &budget ), _owners( std::move( owners ) )
+			{
+				_budget->pin( _owners, 1 );
+			}
+			Pin( Pin&& other ) noexcept : _budget( std::exchange( other._budget, nullptr ) ), _owners( std::move( other._owners ) )
+			{}
+			Pin& operator=( Pin&& other ) noexcept
+			{
+				if( this != &other )
+				{
+					this->release();
+					_budget = std::exchange( other._budget, nullptr );
+					_owners = std::move( other._owners );
+				}
+				return *this;
+			}
+			~Pin()
+			{
+				this->release();
+			}
+
+		private:
+			void release() noexcept
+			{
+				if( _budget ) _budget->pin( _owners, -1 );
+				_budget = nullptr;
+			}
+
+			MemoryBudget* _budget = nullptr;
+			std::vector<const void*> _owners;
+		};
+
+		// Return the pool of a category
+		static Pool pool( Category category ) noexcept
+		{
+			return category == Category::eTexture ? Pool::eDevice : Pool::eHost;
+		}
+
+		// Setter and getter for the budget of a pool (unlimited by default)
+		void setBudget( Pool pool, size_t bytes )
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			_budgets[static_cast<int32_t>( pool )] = bytes;
+		}
+		size_t budget( Pool pool ) const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			return _budgets[static_cast<int32_t>( pool )];
+		}
+
+		// Getters for the current usage of a pool, the usage per category and the number of evicted bytes
+		size_t usage( Pool pool ) const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			return _usage[static_cast<int32_t>( pool )];
+		}
+		std::map<Category, Usage> breakdown() const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			auto breakdown = std::map<Category, Usage>();
+			for( const auto& [key, entry] : _entries )
+			{
+				auto& usage = breakdown[key.second];
+				usage.bytes += entry.bytes;
+				if( _pins.count( key.first ) ) usage.pinnedBytes += entry.bytes;
+				else if( entry.evict ) usage.evictableBytes += entry.bytes;
+				++usage.entries;
+			}
+			return breakdown;
+		}
+		size_t evictedBytes() const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			return _evictedBytes;
+		}
+
+		// Add or update an entry, 'cost' estimates the time to recreate the data (in ms) and 'evict' releases it (entries without it are only accounted)
+		void add( const void* owner, Category category, size_t bytes, double cost, std::function<void()> evict = {} )
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			const auto pool = static_cast<int32_t>( MemoryBudget::pool( category ) );
+			auto [it, inserted] = _entries.try_emplace( std::make_pair( owner, category ) );
+			auto& entry = it->second;
+			if( inserted ) entry.priority = _clock + cost / std::max<size_t>( bytes, 1 );
+			_usage[pool] += bytes - entry.bytes;
+			entry.bytes = bytes;
+			entry.cost = cost;
+			entry.evict = std::move( evict );
+		}
+
+		// Remove an entry (e.g. when the data is destroyed)
+		void remove( const void* owner, Category category )
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			if( const auto it = _entries.find( std::make_pair( owner, category ) ); it != _entries.end() )
+			{
+				_usage[static_cast<int32_t>( MemoryBudget::pool( category ) )] -= it->second.bytes;
+				_entries.erase( it );
+			}
+		}
+
+		// Mark an entry as used
+		void touch( const void* owner, Category category )
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			if( const auto it = _entries.find( std::make_pair( owner, category ) ); it != _entries.end() )
+				it->second.priority = _clock + it->second.cost / std::max<size_t>( it->second.bytes, 1 );
+		}
+
+		// Check whether an owner is pinned (e.g. to keep data that is referenced on screen when it is replaced)
+		bool pinned( const void* owner ) const
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			return _pins.count( owner ) != 0;
+		}
+
+		// Evict unpinned entries until all pools are within their budget (only call at a safe point, see above)
+		void collect()
+		{
+			for( const auto pool : { Pool::eHost, Pool::eDevice } )
+			{
+				while( true )
+				{
+					auto evict = std::function<void()>();
+					{
+						const auto lock = std::scoped_lock( _mutex );
+						const auto index = static_cast<int32_t>( pool );
+						if( _usage[index] <= _budgets[index] ) break;
+
+						// Find the evictable entry with the lowest priority
+						auto victim = _entries.end();
+						for( auto it = _entries.begin(); it != _entries.end(); ++it )
+						{
+							if( MemoryBudget::pool( it->first.second ) != pool || !it->second.evict || _pins.count( it->first.first ) ) continue;
+							if( victim == _entries.end() || it->second.priority < victim->second.priority ) victim = it;
+						}
+						if( victim == _entries.end() ) break;
+
+						_clock = victim->second.priority;
+						_usage[index] -= victim->second.bytes;
+						_evictedBytes += victim->second.bytes;
+						evict = std::move( victim->second.evict );
+						_entries.erase( victim );
+					}
+
+					// Release the data without holding the lock, as the owner may update other entries
+					evict();
+				}
+			}
+		}
+
+	private:
+		struct Entry
+		{
+			size_t bytes = 0;
+			double cost = 0.0;
+			double priority = 0.0;
+			std::function<void()> evict;
+		};
+
+		void pin( const std::vector<const void*>& owners, int32_t delta )
+		{
+			const auto lock = std::scoped_lock( _mutex );
+			for( const auto owner : owners )
+			{
+				if( !owner ) continue;
+				if( ( _pins[owner] += delta ) <= 0 ) _pins.erase( owner );
+			}
+		}
+		mutable std::mutex _mutex;
+		std::map<std::pair<const void*, Category>, Entry> _entries;
+		std::unordered_map<const void*, int32_t> _pins;
+		size_t _budgets[2] = { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max() };
+		size_t _usage[2] = { 0, 0 };
+		size_t _evictedBytes = 0;
+		double _clock = 0.0;
+	};
+
+	// Return the global memory budget
+	inline MemoryBudget& memory_budget()
+	{
+		static auto budget = MemoryBudget();
+		return budget;
+	}
+
+	// Pin the owners in the global memory budget
+	inline MemoryBudget::Pin pin_memory( std::vector<const void*> owners )
+	{
+		return MemoryBudget::Pin( std::move( owners ), memory_budget() );
+	}
+}
+
+// Function to convert util::MemoryBudget::Category to a string
+inline const char* to_string( util::MemoryBudget::Category category )
+{
+	switch( category )
+	{
+	case util::MemoryBudget::Category::eMembers: return "Members";
+	case util::MemoryBudget::Category::eMemberVolume: return "Member volumes";
+	case util::MemoryBudget::Category::eDerivedVolume: return "Derived volumes";
+	case util::MemoryBudget::Category::eHistogram: return "Histograms";
+	case util::MemoryBudget::Category::eSimilarity: return "Similarity matrices";
+	case util::MemoryBudget::Category::eGradient: return "Gradients";
+	case util::MemoryBudget::Category::eTexture: return "Textures";
+	default: return "Unknown";
+	}
+}
\ No newline at end of file
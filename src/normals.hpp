@@ -0,0 +1,90 @@
+#pragma once
+#include "utility.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// Volume of unit vectors (e.g. gradient directions) that are packed into two values per voxel using the octahedral mapping (https://jcgt.org/published/0003/02/01/).
+// Two signed normalized 8-bit values need 2 bytes per voxel (angular error below 1 degree), two half-precision floats need 4 bytes per voxel (angular error below 0.1 degrees).
+class NormalVolume
+{
+public:
+	enum class Encoding : int32_t { eSnorm8, eFloat16 };
+
+	NormalVolume() noexcept = default;
+	NormalVolume( vec3i dimensions, Encoding encoding ) : _dimensions( dimensions ), _encoding( encoding ), _values( static_cast<size_t>( dimensions.product() ) * ( encoding == Encoding::eSnorm8 ? 2 : 4 ) )
+	{}
+
+	// Getters for basic statistics
+	vec3i dimensions() const noexcept
+	{
+		return _dimensions;
+	}
+	Encoding encoding() const noexcept
+	{
+		return _encoding;
+	}
+	bool empty() const noexcept
+	{
+		return _values.empty();
+	}
+	size_t bytes() const noexcept
+	{
+		return _values.size();
+	}
+
+	// Pack and store a vector (does not need to be normalized, zero vectors are decoded as (0, 0, 1))
+	void set( int32_t index, vec3f normal ) noexcept
+	{
+		// Project onto the octahedron and fold the lower hemisphere
+		auto encoded = vec2f( 0.0f, 0.0f );
+		if( const auto sum = std::abs( normal.x ) + std::abs( normal.y ) + std::abs( normal.z ); sum > 0.0f )
+		{
+			encoded = vec2f( normal.x / sum, normal.y / sum );
+			if( normal.z < 0.0f ) encoded = vec2f( ( 1.0f - std::abs( encoded.y ) ) * sign( encoded.x ), ( 1.0f - std::abs( encoded.x ) ) * sign( encoded.y ) );
+		}
+
+		if( _encoding == Encoding::eSnorm8 )
+		{
+			auto destination = reinterpret_cast<int8_t*>( _values.data() ) + static_cast<size_t>( index ) * 2;
+			destination[0] = static_cast<int8_t>( std::round( std::clamp( encoded.x, -1.0f, 1.0f ) * 127.0f ) );
+			destination[1] = static_cast<int8_t>( std::round( std::clamp( encoded.y, -1.0f, 1.0f ) * 127.0f ) );
+		}
+		else
+		{
+			const uint16_t halfs[2] = { util::float_to_half( encoded.x ), util::float_to_half( encoded.y ) };
+			std::memcpy( _values.data() + static_cast<size_t>( index ) * 4, halfs, sizeof( halfs ) );
+		}
+	}
+
+	// Unpack a normalized vector
+	vec3f get( int32_t index ) const noexcept
+	{
+		auto encoded = vec2f();
+		if( _encoding == Encoding::eSnorm8 )
+		{
+			const auto source = reinterpret_cast<const int8_t*>( _values.data() ) + static_cast<size_t>( index ) * 2;
+			encoded = vec2f( source[0] / 127.0f, source[1] / 127.0f );
+		}
+		else
+		{
+			uint16_t halfs[2];
+			std::memcpy( halfs, _values.data() + static_cast<size_t>( index ) * 4, sizeof( halfs ) );
+			encoded = vec2f( util::half_to_float( halfs[0] ), util::half_to_float( halfs[1] ) );
+		}
+
+		auto normal = vec3f( encoded.x, encoded.y, 1.0f - std::abs( encoded.x ) - std::abs( encoded.y ) );
+		if( normal.z < 0.0f ) normal = vec3f( ( 1.0f - std::abs( encoded.y ) ) * sign( encoded.x ), ( 1.0f - std::abs( encoded.x ) ) * sign( encoded.y ), normal.z );
+		return normal / normal.length();
+	}
+
+private:
+	static float sign( float value ) noexcept
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	vec3i _dimensions;
+	Encoding _encoding = Encoding::eSnorm8;
+	std::vector<uint8_t> _values;
+};
\ No newline at end of file
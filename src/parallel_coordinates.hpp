@@ -156,6 +156,7 @@ public:
 	void setVolume( const Volume<float>& volume )
 	{
 		_volume = &volume;
+		_volumePin = util::pin_memory( { &volume } );
 
 		// Expand range
 		const auto currentRange = vec2d( _lower->minimum(), _lower->maximum() );
@@ -227,6 +228,7 @@ public slots:
 
 private:
 	const Volume<float>* _volume = nullptr;
+	util::MemoryBudget::Pin _volumePin;
 	bool _hasMaximumRange = true;
 
 	QLabel* _label = nullptr;
@@ -296,6 +298,7 @@ public:
 		// Connect new region
 		_region = region;
 		QObject::connect( _region, &Region::selectionChanged, this, &ParallelCoordinates::onSelectionChanged );
+		QObject::connect( _region, &Region::axisVolumesChanged, this, &ParallelCoordinates::onAxisVolumesChanged );
 
 		// Update axes
 		for( auto [type, axis] : _axes )
@@ -307,6 +310,9 @@ public:
 			axis->setVisible( enabled );
 		}
 
+		// The new region might replace other volumes
+		this->onAxisVolumesChanged();
+
 		if( _initialized )
 		{
 			_updateWhenScrollAreaRepaints = true;
@@ -331,21 +337,17 @@ public:
 			for( const auto& id : available )
 			{
 				const auto volumeType = id.type;
-				const auto& volume = ensemble.volume( id );
+				const auto& volume = _region->volume( ensemble, id );
 
 				auto axis = _axes[id] = new ParallelCoordinatesAxis( _region->intervals( id ), volume );
 				_region->enabledAxes().insert( id );
 
-				if( volumeType >= Ensemble::Derived::eHist1 && volumeType <= Ensemble::Derived::eHist5 )
+				if( volumeType == Ensemble::Derived::eHist1 )
 				{
-					const auto highlightedValues = std::vector<double> {
-						// 0.0668, 0.0918, 0.1499, 0.3829, 0.1499, 0.0918, 0.0668
-						0.2, 0.2, 0.2, 0.2, 0.2
-					};
-
+					// All bins have equal probability under a normal distribution
 					axis->setTitle( volume.name().split( ' ' ).back() );
 					axis->setMovable( false );
-					axis->setHighlightedValue( highlightedValues[static_cast<int32_t>( volumeType ) - static_cast<int32_t>( Ensemble::Derived::eHist1 )] );
+					axis->setHighlightedValue( 1.0 / ensemble.field( id.field ).histogramBinCount() );
 					_histogramLayout->addWidget( axis );
 				}
 				else _axesLayout->insertWidget( _axesLayout->count() - 1, axis );
@@ -383,7 +385,7 @@ public:
 		// Update axis volumes
 		_ensemble = &ensemble;
 		for( auto [volumeID, axis] : _axes ) if( _region->enabledAxes().count( volumeID ) )
-			axis->setVolume( _ensemble->volume( volumeID ) );
+			axis->setVolume( _region->volume( *_ensemble, volumeID ) );
 
 		// Unblock signals
 		for( const auto [key, axis] : _axes ) axis->blockSignals( false );
@@ -412,7 +414,7 @@ public:
 			if( enabled )
 			{
 				_region->enabledAxes().insert( id );
-				const auto& volume = _ensemble->volume( id );
+				const auto& volume = _region->volume( *_ensemble, id );
 				if( &volume != &axis->volume() )
 				{
 					axis->setVolume( volume );
@@ -424,9 +426,9 @@ public:
 			axis->setVisible( enabled );
 		};
 
-		if( id.type >= Ensemble::Derived::eHist1 && id.type <= Ensemble::Derived::eHist5 )
-			for( auto type = Ensemble::Derived::eHist1; type <= Ensemble::Derived::eHist5; type = static_cast<Ensemble::Derived>( static_cast<int32_t>( type ) + 1 ) )
-				setAxisEnabledIntern( Ensemble::VolumeID( id.field, type ), enabled );
+		if( id.type == Ensemble::Derived::eHist1 && id.index < 0 )
+			for( int32_t bin = 0; bin < _ensemble->field( id.field ).histogramBinCount(); ++bin )
+				setAxisEnabledIntern( Ensemble::VolumeID::histogram( id.field, bin ), enabled );
 		else setAxisEnabledIntern( id, enabled );
 
 		if( updateVolumesBuffer ) this->updateVolumesBuffer();
@@ -585,6 +587,25 @@ private slots:
 		for( auto& [type, axis] : _axes ) axis->update();
 	}
 
+	// When the region replaces volumes of axes, update the axes and all buffers
+	void onAxisVolumesChanged()
+	{
+		if( !_ensemble ) return;
+
+		auto updateVolumesBuffer = false;
+		for( auto [volumeID, axis] : _axes ) if( _region->enabledAxes().count( volumeID ) )
+		{
+			const auto& volume = _region->volume( *_ensemble, volumeID );
+			if( &volume != &axis->volume() )
+			{
+				axis->setVolume( volume );
+				axis->update();
+				updateVolumesBuffer = true;
+			}
+		}
+		if( updateVolumesBuffer && _initialized ) this->updateVolumesBuffer( true, !_region->constantMask() );
+	}
+
 private:
 	// Initialize some OpenGL objects
 	void initializeGL() override
@@ -18,7 +18,7 @@ public:
 	{}
 
 	// Copy a region, giving it another name
-	Region( QString name, const Region& other ) : _name( std::move( name ) ), _intervals( other._intervals ), _enabledAxes( other._enabledAxes ), _constantMask( other._constantMask ? new Volume<float>( *other._constantMask ) : nullptr )
+	Region( QString name, const Region& other ) : _name( std::move( name ) ), _intervals( other._intervals ), _enabledAxes( other._enabledAxes ), _axisEnsemble( other._axisEnsemble ), _axisVolumes( other._axisVolumes ), _constantMask( other._constantMask ? new Volume<float>( *other._constantMask ) : nullptr )
 	{
 		if( other._selectionBuffer )
 		{
@@ -52,6 +52,25 @@ public:
 		return _enabledAxes;
 	}
 
+	// Replace volumes of an ensemble on the parallel coordinates axes of this region (e.g. principal components computed for another region)
+	void setAxisVolumes( const Ensemble* ensemble, std::unordered_map<Ensemble::VolumeID, std::shared_ptr<Volume<float>>> volumes )
+	{
+		for( const auto& [id, volume] : _axisVolumes ) _intervals[id].clear();
+		for( const auto& [id, volume] : volumes ) _intervals[id].clear();
+
+		_axisEnsemble = ensemble;
+		_axisVolumes = std::move( volumes );
+		emit axisVolumesChanged();
+	}
+
+	// Return the volume that is used for a parallel coordinates axis (and brushing)
+	const Volume<float>& volume( const Ensemble& ensemble, Ensemble::VolumeID id ) const
+	{
+		if( &ensemble == _axisEnsemble )
+			if( const auto it = _axisVolumes.find( id ); it != _axisVolumes.end() ) return *it->second;
+		return ensemble.volume( id );
+	}
+
 	// Getter and setter for the region's name
 	void setName( QString name )
 	{
@@ -113,7 +132,7 @@ public:
 		for( const auto& [type, intervals_sb] : _intervals ) if( _enabledAxes.count( type ) && intervals_sb.size() )
 		{
 			const auto& intervals = intervals_sb;
-			const auto& volume = ensemble.volume( type );
+			const auto& volume = this->volume( ensemble, type );
 			util::compute_multi_threaded( 0, mask->voxelCount(), [&] ( int32_t begin, int32_t end )
 			{
 				for( int32_t i = begin; i < end; ++i ) if( mask->at( i ) != 0.0f )
@@ -142,11 +161,14 @@ public:
 signals:
 	void selectionChanged();
 	void nameChanged( const QString& );
+	void axisVolumesChanged();
 
 private:
 	QString _name;
 	std::unordered_map<Ensemble::VolumeID, std::vector<vec2d>> _intervals;
 	std::unordered_set<Ensemble::VolumeID> _enabledAxes;
+	const Ensemble* _axisEnsemble = nullptr;
+	std::unordered_map<Ensemble::VolumeID, std::shared_ptr<Volume<float>>> _axisVolumes;
 	std::shared_ptr<Volume<float>> _constantMask;
 
 	mutable GLuint _selectionBuffer = 0;
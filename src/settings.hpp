@@ -5,6 +5,7 @@
 #include <qlabel.h>
 #include <qpushbutton.h>
 #include <qspinbox.h>
+#include <qtimer.h>
 #include <qwidget.h>
 
 #include <iostream>
@@ -20,7 +21,7 @@ class Settings : public QWidget
 {
 	Q_OBJECT
 public:
-	void initialize( const Ensemble& ensemble, ColorMapManager* colorMapManager, Dendrogram* dendrogram, VolumeRendererManager* volumeRendererManager, ParallelCoordinates* parallelCoordinates )
+	void initialize( Ensemble& ensemble, ColorMapManager* colorMapManager, Dendrogram* dendrogram, VolumeRendererManager* volumeRendererManager, ParallelCoordinates* parallelCoordinates )
 	{
 		// Remember main widgets
 		_ensemble = &ensemble;
@@ -58,6 +59,7 @@ public:
 		this->initializeDendrogram();
 		this->initializeParallelCoordinates();
 		this->initializeVolumeRenderer();
+		this->initializeStorage();
 
 		// Initialize some connections
 		const auto updateSampleColors = [=]
@@ -197,6 +199,13 @@ private:
 
 		_layout->addRow( "", util::createBoxLayout( QBoxLayout::LeftToRight, 5, { firstRegion, combineOp, secondRegion, buttonCombineRegions }, { 1, 0, 1, 0 } ) );
 
+		// Principal components computed only for the voxels of a region (replace the PCA axes of the current region)
+		auto pcaRegion = new ComboBox<Region*>();
+		pcaRegion->addItem( "Region", _regions->item() );
+		auto applyPCARegion = new QPushButton( "Apply" );
+		auto resetPCARegion = new QPushButton( "Reset" );
+		_layout->addRow( "PCA Region", util::createBoxLayout( QBoxLayout::LeftToRight, 5, { pcaRegion, applyPCARegion, resetPCARegion }, { 1, 0, 0 } ) );
+
 		// Volume (axes) selection
 		auto field = new ComboBox<int32_t>();
 		auto volumeList = new ListView<Ensemble::VolumeID>();
@@ -287,6 +296,7 @@ private:
 			item->setName( name );
 			firstRegion->setText( index, name );
 			secondRegion->setText( index, name );
+			pcaRegion->setText( index, name );
 			_regionsDendrogram->setText( index, name );
 			_currentRegion->setText( _currentRegion->index( item ), name );
 			_configRegions->setText( _configRegions->index( item ), name );
@@ -303,6 +313,7 @@ private:
 
 			firstRegion->addItem( "Region", region );
 			secondRegion->addItem( "Region", region );
+			pcaRegion->addItem( "Region", region );
 			_regionsDendrogram->addItem( "Region", region );
 			_configRegions->addItem( region, "Region", false );
 		} );
@@ -311,6 +322,7 @@ private:
 			_regions->item( index )->deleteLater();
 			firstRegion->removeItem( index );
 			secondRegion->removeItem( index );
+			pcaRegion->removeItem( index );
 			_regionsDendrogram->removeItem( index );
 			_configRegions->removeItem( _regions->item( index ) );
 		} );
@@ -337,6 +349,25 @@ private:
 			region->setConstantMask( resultMask );
 			_regions->addItem( "Region", region );
 		} );
+		QObject::connect( applyPCARegion, &QPushButton::clicked, [=]
+		{
+			const auto ensemble = _parallelCoordinates->ensemble();
+			if( !ensemble ) return;
+
+			const auto mask = pcaRegion->item()->createMask( *ensemble );
+			auto volumes = std::unordered_map<Ensemble::VolumeID, std::shared_ptr<Volume<float>>>();
+			for( int32_t i = 0; i < ensemble->fieldCount(); ++i )
+			{
+				auto [pca1, pca2] = ensemble->field( i ).principalComponents( mask.get() );
+				volumes[Ensemble::VolumeID( i, Ensemble::Derived::ePCA1 )] = std::make_shared<Volume<float>>( std::move( pca1 ) );
+				volumes[Ensemble::VolumeID( i, Ensemble::Derived::ePCA2 )] = std::make_shared<Volume<float>>( std::move( pca2 ) );
+			}
+			_regions->item()->setAxisVolumes( ensemble, std::move( volumes ) );
+		} );
+		QObject::connect( resetPCARegion, &QPushButton::clicked, [=]
+		{
+			_regions->item()->setAxisVolumes( nullptr, {} );
+		} );
 		QObject::connect( field, &ComboBoxSignals::indexChanged, [=] ( int32_t index )
 		{
 			volumeList->blockSignals( true );
@@ -735,8 +766,142 @@ private:
 			_volumeRendererManager->setColorMap1DAlpha( _currentRegion->index(), colorMap1DAlpha->item( nullptr ) );
 		} );
 	}
+	void initializeStorage()
+	{
+		addSection( "Storage", QFont::Weight::Medium );
+
+		// Field selection
+		auto field = new ComboBox<int32_t>();
+		for( int32_t i = 0; i < _ensemble->fieldCount(); ++i )
+			field->addItem( _ensemble->field( i ).name(), i );
+		_layout->addRow( "Field", field );
+		field->setVisible( _ensemble->fieldCount() > 1 );
+
+		// Gradient storage selection (the gradient is only used for comparisons and saved with the ensemble)
+		auto gradient = new ComboBox<Ensemble::Field::GradientStorage>();
+		gradient->addItem( "Full Precision", Ensemble::Field::GradientStorage::eFloat );
+		gradient->addItem( "Half Precision", Ensemble::Field::GradientStorage::eFloat16 );
+		gradient->addItem( "8-Bit Directions", Ensemble::Field::GradientStorage::eSnorm8 );
+		gradient->addItem( "On Demand", Ensemble::Field::GradientStorage::eOnDemand );
+		gradient->setItem( _ensemble->field( 0 ).gradientStorage() );
+		_layout->addRow( "Gradient", gradient );
+
+		// Storage of the members, compressed and paged members can be encoded lossily (see compression::Quantization and compression::Encoding for the error
+		// bounds), low-rank members keep the leading principal components
+		auto storage = new ComboBox<Ensemble::Field::Storage>();
+		storage->addItem( "Volumes", Ensemble::Field::Storage::eVolumes );
+		storage->addItem( "Interleaved", Ensemble::Field::Storage::eInterleaved );
+		storage->addItem( "Compressed", Ensemble::Field::Storage::eCompressed );
+		storage->addItem( "Paged", Ensemble::Field::Storage::ePaged );
+		storage->addItem( "Low Rank", Ensemble::Field::Storage::eLowRank );
+		_layout->addRow( "Members", storage );
+
+		auto rank = new NumberWidget( 1, std::max( 1, _ensemble->memberCount() ), std::min( 16, _ensemble->memberCount() ) );
+		_layout->addRow( "Rank", rank );
+
+		auto encoding = new ComboBox<compression::Encoding>();
+		encoding->addItem( "Lossless", compression::Encoding() );
+		encoding->addItem( "Half Precision", compression::Encoding { compression::Quantization::eHalf } );
+		encoding->addItem( "16-Bit Scaled", compression::Encoding { compression::Quantization::eScaled16 } );
+		encoding->addItem( "8-Bit Scaled", compression::Encoding { compression::Quantization::eScaled8 } );
+		encoding->addItem( "Residuals", compression::Encoding { compression::Quantization::eNone, true } );
+		encoding->addItem( "Bounded Residuals", compression::Encoding { compression::Quantization::eNone, true, 1.0f } );
+		auto applyStorage = new QPushButton( "Apply" );
+		_layout->addRow( "Encoding", util::createBoxLayout( QBoxLayout::LeftToRight, 5, { encoding, applyStorage }, { 1, 0 } ) );
+
+		// Absolute error bound of bounded residuals
+		auto tolerance = new NumberWidget( 0.0, 1000000.0, 0.001, 0.001, 6 );
+		_layout->addRow( "Tolerance", tolerance );
+
+		// Budget for the quartiles (exact selection up to the member count, quantile sketches with the number of bins above)
+		addSection( "Quartiles", QFont::Weight::Light );
+		const auto& budget = _ensemble->field( 0 ).quantileBudget();
+		auto exactMemberCount = new NumberWidget( 0, 65536, budget.exactMemberCount );
+		_layout->addRow( "Exact Members", exactMemberCount );
+
+		auto sketchBins = new NumberWidget( 1, 65536, budget.sketchBins );
+		auto applyBudget = new QPushButton( "Apply" );
+		_layout->addRow( "Sketch Bins", util::createBoxLayout( QBoxLayout::LeftToRight, 5, { sketchBins, applyBudget }, { 1, 0 } ) );
+
+		// Initialize connections (the storage of virtual fields can't be changed, lossy members can't be encoded lossily again)
+		const auto updateEncoding = [=]
+		{
+			const auto encoded = storage->index() >= 0 && ( storage->item() == Ensemble::Field::Storage::eCompressed || storage->item() == Ensemble::Field::Storage::ePaged );
+			if( !encoded ) encoding->setItem( compression::Encoding() );
+			encoding->setEnabled( encoded && !_ensemble->field( field->item() ).lossy() );
+			tolerance->setEnabled( encoding->isEnabled() && !encoding->item().lossless() && encoding->item().residuals );
+			rank->setEnabled( storage->index() >= 0 && storage->item() == Ensemble::Field::Storage::eLowRank );
+			applyStorage->setEnabled( storage->index() >= 0 );
+		};
+		const auto updateStorage = [=]
+		{
+			const auto& selected = _ensemble->field( field->item() );
+			storage->blockSignals( true );
+			storage->setItem( selected.storage() );
+			storage->blockSignals( false );
+			storage->setEnabled( selected.storage() != Ensemble::Field::Storage::eVirtual );
+			encoding->setItem( compression::Encoding() );
+			updateEncoding();
+		};
+		QObject::connect( field, &ComboBoxSignals::indexChanged, [=]
+		{
+			const auto& selected = _ensemble->field( field->item() );
+			gradient->blockSignals( true );
+			gradient->setItem( selected.gradientStorage() );
+			gradient->blockSignals( false );
+			exactMemberCount->setValue( selected.quantileBudget().exactMemberCount );
+			sketchBins->setValue( selected.quantileBudget().sketchBins );
+			updateStorage();
+		} );
+		QObject::connect( applyBudget, &QPushButton::clicked, [=]
+		{
+			auto budget = statistics::QuantileBudget();
+			budget.exactMemberCount = static_cast<int32_t>( exactMemberCount->value() );
+			budget.sketchBins = static_cast<int32_t>( sketchBins->value() );
+			_ensemble->field( field->item() ).setQuantileBudget( budget );
+		} );
+		QObject::connect( gradient, &ComboBoxSignals::indexChanged, [=]
+		{
+			_ensemble->field( field->item() ).setGradientStorage( gradient->item() );
+		} );
+		QObject::connect( storage, &ComboBoxSignals::indexChanged, updateEncoding );
+		QObject::connect( encoding, &ComboBoxSignals::indexChanged, updateEncoding );
+
+		// Derived data is recomputed in the background after the members were replaced, the results are applied between events
+		auto recomputation = new QTimer( this );
+		QObject::connect( recomputation, &QTimer::timeout, [=]
+		{
+			auto applied = false;
+			try
+			{
+				applied = _ensemble->applyRecomputedStages();
+			} catch( const std::exception& e )
+			{
+				std::cerr << "[Error]: " << e.what() << std::endl;
+			}
+			if( !applied ) return;
+			recomputation->stop();
+			this->window()->update();
+		} );
+		QObject::connect( applyStorage, &QPushButton::clicked, [=]
+		{
+			try
+			{
+				auto selected = encoding->item();
+				if( selected.residuals && !selected.lossless() ) selected.tolerance = static_cast<float>( tolerance->value() );
+				if( storage->item() == Ensemble::Field::Storage::eLowRank ) _ensemble->setLowRank( field->item(), static_cast<int32_t>( rank->value() ) );
+				else _ensemble->setStorage( field->item(), storage->item(), selected );
+			} catch( const std::exception& e )
+			{
+				std::cerr << "[Error]: " << e.what() << std::endl;
+			}
+			updateStorage();
+			recomputation->start( 100 );
+		} );
+		updateStorage();
+	}
 
-	const Ensemble* _ensemble = nullptr;
+	Ensemble* _ensemble = nullptr;
 	ColorMapManager* _colorMapManager = nullptr;
 	Dendrogram* _dendrogram = nullptr;
 	VolumeRendererManager* _volumeRendererManager = nullptr;
@@ -0,0 +1,289 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined( __AVX2__ ) && defined( __FMA__ )
+#include <immintrin.h>
+#define SIMD_AVX2
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define SIMD_SSE2
+#endif
+
+// Minimal wrapper for SIMD vectors of floats (AVX2, SSE2 or a scalar fallback) and vectorized approximations of math functions
+namespace simd
+{
+	// Whether the vectors map to hardware registers (otherwise the operations are emulated lane by lane)
+#if defined( SIMD_AVX2 ) || defined( SIMD_SSE2 )
+	constexpr bool Native = true;
+#else
+	constexpr bool Native = false;
+#endif
+
+#if defined( SIMD_AVX2 )
+	constexpr int32_t Width = 8;
+	using native_float = __m256;
+	using native_int = __m256i;
+#elif defined( SIMD_SSE2 )
+	constexpr int32_t Width = 4;
+	using native_float = __m128;
+	using native_int = __m128i;
+#else
+	constexpr int32_t Width = 4;
+	struct native_float { float v[Width]; };
+	struct native_int { int32_t v[Width]; };
+#endif
+
+	// Vector of 32-bit integers, only used to manipulate the bits of floats
+	struct intv
+	{
+		native_int v;
+	};
+
+	// Vector of floats
+	struct floatv
+	{
+		native_float v;
+
+		floatv() noexcept = default;
+		floatv( native_float v ) noexcept : v( v )
+		{}
+		floatv( float value ) noexcept
+		{
+#if defined( SIMD_AVX2 )
+			v = _mm256_set1_ps( value );
+#elif defined( SIMD_SSE2 )
+			v = _mm_set1_ps( value );
+#else
+			for( auto& lane : v.v ) lane = value;
+#endif
+		}
+
+		static floatv load( const float* values ) noexcept
+		{
+#if defined( SIMD_AVX2 )
+			return _mm256_loadu_ps( values );
+#elif defined( SIMD_SSE2 )
+			return _mm_loadu_ps( values );
+#else
+			auto result = floatv();
+			std::memcpy( result.v.v, values, sizeof( result.v.v ) );
+			return result;
+#endif
+		}
+		void store( float* values ) const noexcept
+		{
+#if defined( SIMD_AVX2 )
+			_mm256_storeu_ps( values, v );
+#elif defined( SIMD_SSE2 )
+			_mm_storeu_ps( values, v );
+#else
+			std::memcpy( values, v.v, sizeof( v.v ) );
+#endif
+		}
+	};
+
+#if defined( SIMD_AVX2 )
+	inline floatv operator+( floatv a, floatv b ) noexcept { return _mm256_add_ps( a.v, b.v ); }
+	inline floatv operator-( floatv a, floatv b ) noexcept { return _mm256_sub_ps( a.v, b.v ); }
+	inline floatv operator*( floatv a, floatv b ) noexcept { return _mm256_mul_ps( a.v, b.v ); }
+	inline floatv operator/( floatv a, floatv b ) noexcept { return _mm256_div_ps( a.v, b.v ); }
+	inline floatv min( floatv a, floatv b ) noexcept { return _mm256_min_ps( a.v, b.v ); }
+	inline floatv max( floatv a, floatv b ) noexcept { return _mm256_max_ps( a.v, b.v ); }
+	inline floatv fma( floatv a, floatv b, floatv c ) noexcept { return _mm256_fmadd_ps( a.v, b.v, c.v ); }
+	inline floatv operator<( floatv a, floatv b ) noexcept { return _mm256_cmp_ps( a.v, b.v, _CMP_LT_OQ ); }
+	inline floatv operator<=( floatv a, floatv b ) noexcept { return _mm256_cmp_ps( a.v, b.v, _CMP_LE_OQ ); }
+	inline floatv select( floatv mask, floatv a, floatv b ) noexcept { return _mm256_blendv_ps( b.v, a.v, mask.v ); }
+	inline floatv abs( floatv a ) noexcept { return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a.v ); }
+	inline floatv sqrt( floatv a ) noexcept { return _mm256_sqrt_ps( a.v ); }
+
+	inline intv truncate( floatv a ) noexcept { return { _mm256_cvttps_epi32( a.v ) }; }
+	inline floatv convert( intv a ) noexcept { return _mm256_cvtepi32_ps( a.v ); }
+	inline intv bits( floatv a ) noexcept { return { _mm256_castps_si256( a.v ) }; }
+	inline floatv from_bits( intv a ) noexcept { return _mm256_castsi256_ps( a.v ); }
+	inline intv operator+( intv a, intv b ) noexcept { return { _mm256_add_epi32( a.v, b.v ) }; }
+	inline intv operator-( intv a, intv b ) noexcept { return { _mm256_sub_epi32( a.v, b.v ) }; }
+	inline intv operator&( intv a, intv b ) noexcept { return { _mm256_and_si256( a.v, b.v ) }; }
+	inline intv operator|( intv a, intv b ) noexcept { return { _mm256_or_si256( a.v, b.v ) }; }
+	inline intv broadcast( int32_t value ) noexcept { return { _mm256_set1_epi32( value ) }; }
+	template<int32_t Shift> intv shift_left( intv a ) noexcept { return { _mm256_slli_epi32( a.v, Shift ) }; }
+	template<int32_t Shift> intv shift_right( intv a ) noexcept { return { _mm256_srli_epi32( a.v, Shift ) }; }
+	inline intv load_u16( const uint16_t* values ) noexcept { return { _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( values ) ) ) }; }
+	inline intv load_u8( const uint8_t* values ) noexcept { return { _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( values ) ) ) }; }
+#elif defined( SIMD_SSE2 )
+	inline floatv operator+( floatv a, floatv b ) noexcept { return _mm_add_ps( a.v, b.v ); }
+	inline floatv operator-( floatv a, floatv b ) noexcept { return _mm_sub_ps( a.v, b.v ); }
+	inline floatv operator*( floatv a, floatv b ) noexcept { return _mm_mul_ps( a.v, b.v ); }
+	inline floatv operator/( floatv a, floatv b ) noexcept { return _mm_div_ps( a.v, b.v ); }
+	inline floatv min( floatv a, floatv b ) noexcept { return _mm_min_ps( a.v, b.v ); }
+	inline floatv max( floatv a, floatv b ) noexcept { return _mm_max_ps( a.v, b.v ); }
+	inline floatv fma( floatv a, floatv b, floatv c ) noexcept { return _mm_add_ps( _mm_mul_ps( a.v, b.v ), c.v ); }
+	inline floatv operator<( floatv a, floatv b ) noexcept { return _mm_cmplt_ps( a.v, b.v ); }
+	inline floatv operator<=( floatv a, floatv b ) noexcept { return _mm_cmple_ps( a.v, b.v ); }
+	inline floatv select( floatv mask, floatv a, floatv b ) noexcept { return _mm_or_ps( _mm_and_ps( mask.v, a.v ), _mm_andnot_ps( mask.v, b.v ) ); }
+	inline floatv abs( floatv a ) noexcept { return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a.v ); }
+	inline floatv sqrt( floatv a ) noexcept { return _mm_sqrt_ps( a.v ); }
+
+	inline intv truncate( floatv a ) noexcept { return { _mm_cvttps_epi32( a.v ) }; }
+	inline floatv convert( intv a ) noexcept { return _mm_cvtepi32_ps( a.v ); }
+	inline intv bits( floatv a ) noexcept { return { _mm_castps_si128( a.v ) }; }
+	inline floatv from_bits( intv a ) noexcept { return _mm_castsi128_ps( a.v ); }
+	inline intv operator+( intv a, intv b ) noexcept { return { _mm_add_epi32( a.v, b.v ) }; }
+	inline intv operator-( intv a, intv b ) noexcept { return { _mm_sub_epi32( a.v, b.v ) }; }
+	inline intv operator&( intv a, intv b ) noexcept { return { _mm_and_si128( a.v, b.v ) }; }
+	inline intv operator|( intv a, intv b ) noexcept { return { _mm_or_si128( a.v, b.v ) }; }
+	inline intv broadcast( int32_t value ) noexcept { return { _mm_set1_epi32( value ) }; }
+	template<int32_t Shift> intv shift_left( intv a ) noexcept { return { _mm_slli_epi32( a.v, Shift ) }; }
+	template<int32_t Shift> intv shift_right( intv a ) noexcept { return { _mm_srli_epi32( a.v, Shift ) }; }
+	inline intv load_u16( const uint16_t* values ) noexcept { return { _mm_unpacklo_epi16( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( values ) ), _mm_setzero_si128() ) }; }
+	inline intv load_u8( const uint8_t* values ) noexcept
+	{
+		auto bytes = int32_t( 0 );
+		std::memcpy( &bytes, values, sizeof( bytes ) );
+		const auto words = _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), _mm_setzero_si128() );
+		return { _mm_unpacklo_epi16( words, _mm_setzero_si128() ) };
+	}
+#else
+	template<typename Function> floatv apply( floatv a, floatv b, Function function ) noexcept
+	{
+		for( int32_t i = 0; i < Width; ++i ) a.v.v[i] = function( a.v.v[i], b.v.v[i] );
+		return a;
+	}
+	template<typename Function> intv apply( intv a, intv b, Function function ) noexcept
+	{
+		for( int32_t i = 0; i < Width; ++i ) a.v.v[i] = function( a.v.v[i], b.v.v[i] );
+		return a;
+	}
+	inline floatv mask( bool condition ) noexcept
+	{
+		auto value = condition ? ~0u : 0u;
+		auto result = 0.0f;
+		std::memcpy( &result, &value, sizeof( result ) );
+		return result;
+	}
+
+	inline floatv operator+( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return x + y; } ); }
+	inline floatv operator-( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return x - y; } ); }
+	inline floatv operator*( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return x * y; } ); }
+	inline floatv operator/( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return x / y; } ); }
+	inline floatv min( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return x < y ? x : y; } ); }
+	inline floatv max( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return x > y ? x : y; } ); }
+	inline floatv fma( floatv a, floatv b, floatv c ) noexcept { return a * b + c; }
+	inline floatv operator<( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return mask( x < y ).v.v[0]; } ); }
+	inline floatv operator<=( floatv a, floatv b ) noexcept { return apply( a, b, [] ( float x, float y ) { return mask( x <= y ).v.v[0]; } ); }
+	inline floatv select( floatv mask, floatv a, floatv b ) noexcept
+	{
+		for( int32_t i = 0; i < Width; ++i )
+		{
+			auto bits = 0u;
+			std::memcpy( &bits, &mask.v.v[i], sizeof( bits ) );
+			if( !bits ) a.v.v[i] = b.v.v[i];
+		}
+		return a;
+	}
+	inline floatv abs( floatv a ) noexcept { return apply( a, a, [] ( float x, float ) { return x < 0.0f ? -x : x; } ); }
+	inline floatv sqrt( floatv a ) noexcept { return apply( a, a, [] ( float x, float ) { return std::sqrt( x ); } ); }
+
+	inline intv truncate( floatv a ) noexcept { intv result; for( int32_t i = 0; i < Width; ++i ) result.v.v[i] = static_cast<int32_t>( a.v.v[i] ); return result; }
+	inline floatv convert( intv a ) noexcept { floatv result; for( int32_t i = 0; i < Width; ++i ) result.v.v[i] = static_cast<float>( a.v.v[i] ); return result; }
+	inline intv bits( floatv a ) noexcept { intv result; std::memcpy( &result, &a, sizeof( a ) ); return result; }
+	inline floatv from_bits( intv a ) noexcept { floatv result; std::memcpy( &result, &a, sizeof( a ) ); return result; }
+	inline intv operator+( intv a, intv b ) noexcept { return apply( a, b, [] ( int32_t x, int32_t y ) { return x + y; } ); }
+	inline intv operator-( intv a, intv b ) noexcept { return apply( a, b, [] ( int32_t x, int32_t y ) { return x - y; } ); }
+	inline intv operator&( intv a, intv b ) noexcept { return apply( a, b, [] ( int32_t x, int32_t y ) { return x & y; } ); }
+	inline intv operator|( intv a, intv b ) noexcept { return apply( a, b, [] ( int32_t x, int32_t y ) { return x | y; } ); }
+	inline intv broadcast( int32_t value ) noexcept { intv result; for( auto& lane : result.v.v ) lane = value; return result; }
+	template<int32_t Shift> intv shift_left( intv a ) noexcept { for( auto& lane : a.v.v ) lane = static_cast<int32_t>( static_cast<uint32_t>( lane ) << Shift ); return a; }
+	template<int32_t Shift> intv shift_right( intv a ) noexcept { for( auto& lane : a.v.v ) lane = static_cast<int32_t>( static_cast<uint32_t>( lane ) >> Shift ); return a; }
+	inline intv load_u16( const uint16_t* values ) noexcept { intv result; for( int32_t i = 0; i < Width; ++i ) result.v.v[i] = values[i]; return result; }
+	inline intv load_u8( const uint8_t* values ) noexcept { intv result; for( int32_t i = 0; i < Width; ++i ) result.v.v[i] = values[i]; return result; }
+#endif
+
+	// Round towards negative infinity
+	inline floatv floor( floatv a ) noexcept
+	{
+		const auto truncated = convert( truncate( a ) );
+		return select( a < truncated, truncated - 1.0f, truncated );
+	}
+
+	// Natural logarithm for positive, normal inputs (Cephes logf, relative error below 2 ulp)
+	inline floatv log( floatv x ) noexcept
+	{
+		// Split into exponent and mantissa in [0.5, 1)
+		const auto exponentBits = shift_right<23>( bits( x ) );
+		auto exponent = convert( exponentBits - broadcast( 126 ) );
+		x = from_bits( ( bits( x ) & broadcast( 0x007FFFFF ) ) | broadcast( 0x3F000000 ) );
+
+		// Move mantissa to [sqrt(0.5), sqrt(2)) and compute log(1 + x)
+		const auto small = x < 0.707106781186547524f;
+		exponent = exponent - select( small, 1.0f, 0.0f );
+		x = x + select( small, x, 0.0f ) - 1.0f;
+
+		const auto z = x * x;
+		auto y = floatv( 7.0376836292e-2f );
+		y = fma( y, x, -1.1514610310e-1f );
+		y = fma( y, x, 1.1676998740e-1f );
+		y = fma( y, x, -1.2420140846e-1f );
+		y = fma( y, x, 1.4249322787e-1f );
+		y = fma( y, x, -1.6668057665e-1f );
+		y = fma( y, x, 2.0000714765e-1f );
+		y = fma( y, x, -2.4999993993e-1f );
+		y = fma( y, x, 3.3333331174e-1f );
+		y = y * x * z;
+
+		y = fma( exponent, -2.12194440e-4f, y );
+		y = fma( z, -0.5f, y );
+		return fma( exponent, 0.693359375f, x + y );
+	}
+
+	// Exponential function (Cephes expf, relative error below 2 ulp, inputs are clamped to the range of normal floats)
+	inline floatv exp( floatv x ) noexcept
+	{
+		x = min( max( x, -87.3365f ), 88.3762626647949f );
+
+		// Split into 2^n * e^r with |r| <= ln(2)/2
+		const auto n = floor( fma( x, 1.44269504088896341f, 0.5f ) );
+		x = fma( n, -0.693359375f, x );
+		x = fma( n, 2.12194440e-4f, x );
+
+		auto y = floatv( 1.9875691500e-4f );
+		y = fma( y, x, 1.3981999507e-3f );
+		y = fma( y, x, 8.3334519073e-3f );
+		y = fma( y, x, 4.1665795894e-2f );
+		y = fma( y, x, 1.6666665459e-1f );
+		y = fma( y, x, 5.0000001201e-1f );
+		y = fma( y, x * x, x + 1.0f );
+
+		return y * from_bits( shift_left<23>( truncate( n ) + broadcast( 127 ) ) );
+	}
+
+	// Compute log(normalCDF(z)) and log(1 - normalCDF(z)) at once. Both are derived from the tail probability 0.5 * erfc(|z| / sqrt(2)), where log(erfc)
+	// is evaluated directly using the Chebyshev fit from Numerical Recipes (erfcc, relative error below 1.2e-7). This avoids taking the logarithm of tiny
+	// probabilities or of 1 - normalCDF(z). The absolute error of both results is below 1e-6 (dominated by float rounding).
+	inline void log_normal_cdf( floatv z, floatv& lower, floatv& upper ) noexcept
+	{
+		const auto x = abs( z ) * 0.707106781186547524f;
+		const auto s = fma( x, 0.5f, 1.0f );
+		const auto t = 1.0f / s;
+
+		auto p = floatv( 0.17087277f );
+		p = fma( p, t, -0.82215223f );
+		p = fma( p, t, 1.48851587f );
+		p = fma( p, t, -1.13520398f );
+		p = fma( p, t, 0.27886807f );
+		p = fma( p, t, -0.18628806f );
+		p = fma( p, t, 0.09678418f );
+		p = fma( p, t, 0.37409196f );
+		p = fma( p, t, 1.00002368f );
+		p = fma( p, t, -1.26551223f );
+
+		// Logarithm of the smaller tail probability and of its complement
+		const auto tail = p - x * x - log( s ) - 0.693147180559945309f;
+		const auto complement = log( 1.0f - exp( tail ) );
+
+		const auto negative = z <= 0.0f;
+		lower = select( negative, tail, complement );
+		upper = select( negative, complement, tail );
+	}
+}
\ No newline at end of file
@@ -0,0 +1,417 @@
+#pragma once
+#include "simd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Per-voxel statistics over the members of an ensemble, computed for batches of voxels with interleaved member values (values[voxel * memberCount + member])
+namespace statistics
+{
+	// Compare-exchange of two elements in a sorting network, the smaller value ends up at 'first'
+	struct Comparator
+	{
+		int16_t first = 0;
+		int16_t second = 0;
+	};
+
+	// Largest member count that is sorted using sorting networks
+	constexpr int32_t MaxNetworkSize = 256;
+
+	// Enumerate the comparators of Batcher's odd-even merge sort for n elements (https://en.wikipedia.org/wiki/Batcher_odd%E2%80%93even_mergesort)
+	template<typename Function> constexpr void enumerate_sorting_network( int32_t n, Function function )
+	{
+		for( int32_t p = 1; p < n; p += p )
+			for( int32_t k = p; k > 0; k /= 2 )
+				for( int32_t j = k % p; j + k < n; j += 2 * k )
+					for( int32_t i = 0; i < k && i + j + k < n; ++i )
+						if( ( i + j ) / ( 2 * p ) == ( i + j + k ) / ( 2 * p ) )
+							function( Comparator { static_cast<int16_t>( i + j ), static_cast<int16_t>( i + j + k ) } );
+	}
+	constexpr int32_t sorting_network_size( int32_t n )
+	{
+		auto size = 0;
+		enumerate_sorting_network( n, [&size] ( Comparator ) { ++size; } );
+		return size;
+	}
+
+	// Sorting network for a member count known at compile time
+	template<int32_t N> struct SortingNetwork
+	{
+		static constexpr std::array<Comparator, sorting_network_size( N )> generate()
+		{
+			auto comparators = std::array<Comparator, sorting_network_size( N )>();
+			auto index = 0;
+			enumerate_sorting_network( N, [&] ( Comparator comparator ) { comparators[index++] = comparator; } );
+			return comparators;
+		}
+		static constexpr auto comparators = generate();
+	};
+
+	// Sorting network for a member count known at run time (cached per thread)
+	inline const std::vector<Comparator>& sorting_network( int32_t n )
+	{
+		thread_local auto size = -1;
+		thread_local auto comparators = std::vector<Comparator>();
+		if( size != n )
+		{
+			comparators.clear();
+			enumerate_sorting_network( n, [] ( Comparator comparator ) { comparators.push_back( comparator ); } );
+			size = n;
+		}
+		return comparators;
+	}
+
+	// Sort every lane of the rows independently
+	inline void sort( simd::floatv* rows, const Comparator* begin, const Comparator* end ) noexcept
+	{
+		for( auto comparator = begin; comparator != end; ++comparator )
+		{
+			const auto first = rows[comparator->first];
+			const auto second = rows[comparator->second];
+			rows[comparator->first] = simd::min( first, second );
+			rows[comparator->second] = simd::max( first, second );
+		}
+	}
+
+	// Convert the weighted sum of log probabilities of the sorted, standardized samples to the p-value of the Anderson-Darling test
+	inline float anderson_darling_pvalue( double sum, int32_t n ) noexcept
+	{
+		auto A = -n - 1.0 / n * sum;
+		A = A * ( 1.0 + 0.75 / n - 2.25 / ( static_cast<double>( n ) * n ) );
+
+		// Convert test statistic to p-value (https://www.spcforexcel.com/knowledge/basic-statistics/anderson-darling-test-for-normality)
+		const auto pvalue = A >= 0.6 ? std::exp( 1.2937 - 5.709 * A + 0.0186 * A * A )
+			: A > 0.34 ? std::exp( 0.9177 - 4.279 * A - 1.38 * A * A )
+			: A > 0.2 ? 1.0 - std::exp( -8.318 + 42.796 * A - 59.938 * A * A )
+			: 1.0 - std::exp( -13.436 + 101.14 * A - 223.73 * A * A );
+
+		// Handle edge case
+		return std::isnan( pvalue ) ? 0.0f : static_cast<float>( pvalue );
+	}
+
+	// Scalar Anderson-Darling test for normality of a single voxel (https://en.wikipedia.org/wiki/Anderson%E2%80%93Darling_test#Test_for_normality),
+	// evaluated in double precision using std::erfc. Used for large member counts and as reference for the vectorized version.
+	inline float anderson_darling_scalar( const float* members, int32_t n, float mean, float stddev, std::vector<float>& values )
+	{
+		// Handle edge case
+		if( stddev == 0.0f ) return 1.0f;
+
+		// Compute the cumulative distribution function of the normal distribution using std::erfc (https://stackoverflow.com/questions/2328258/cumulative-normal-distribution-function-in-c-c)
+		const auto normalCDF = [] ( double v )
+		{
+			return 0.5 * std::erfc( -v * 0.707106781186547524401 );
+		};
+
+		// Standardize and sort values
+		values.resize( n );
+		for( int32_t j = 0; j < n; ++j )
+			values[j] = ( members[j] - mean ) / stddev;
+		std::sort( values.begin(), values.end() );
+
+		auto sum = 0.0;
+		for( int32_t j = 0; j < n; ++j )
+		{
+			const auto o = j + 1;
+			sum += ( 2 * o - 1 ) * ( std::log( normalCDF( values[j] ) ) + std::log( 1.0 - normalCDF( values[n - o] ) ) );
+		}
+		return anderson_darling_pvalue( sum, n );
+	}
+
+	// Vectorized Anderson-Darling test, every SIMD lane processes one voxel. The members are standardized and sorted using a sorting network
+	// (compile-time for N > 0, otherwise generated for 'memberCount'), the log probabilities are evaluated using simd::log_normal_cdf and summed
+	// up in double precision. The p-values differ from the scalar version by less than 2e-5 (absolute, see tests/tests.cpp).
+	template<int32_t N> void anderson_darling( const float* values, int32_t voxelCount, int32_t memberCount, const float* means, const float* stddevs, float* results )
+	{
+		const auto n = N ? N : memberCount;
+		auto networkBegin = static_cast<const Comparator*>( nullptr ), networkEnd = networkBegin;
+		if constexpr( N > 0 )
+		{
+			networkBegin = SortingNetwork<N>::comparators.data();
+			networkEnd = networkBegin + SortingNetwork<N>::comparators.size();
+		}
+		else
+		{
+			const auto& network = sorting_network( n );
+			networkBegin = network.data();
+			networkEnd = networkBegin + network.size();
+		}
+
+		thread_local auto rows = std::vector<simd::floatv>();
+		thread_local auto lower = std::vector<simd::floatv>();
+		thread_local auto upper = std::vector<simd::floatv>();
+		rows.resize( n );
+		lower.resize( n );
+		upper.resize( n );
+
+		for( int32_t begin = 0; begin < voxelCount; begin += simd::Width )
+		{
+			const auto lanes = std::min( simd::Width, voxelCount - begin );
+
+			// Transpose the member values into the lanes (unused lanes are filled with zeros)
+			float lane[simd::Width] = {}, mean[simd::Width] = {}, stddev[simd::Width] = {};
+			std::fill( stddev, stddev + simd::Width, 1.0f );
+			std::copy( means + begin, means + begin + lanes, mean );
+			std::copy( stddevs + begin, stddevs + begin + lanes, stddev );
+			const auto meanLanes = simd::floatv::load( mean );
+			const auto stddevLanes = simd::floatv::load( stddev );
+
+			for( int32_t j = 0; j < n; ++j )
+			{
+				for( int32_t l = 0; l < lanes; ++l ) lane[l] = values[static_cast<size_t>( begin + l ) * n + j];
+				rows[j] = ( simd::floatv::load( lane ) - meanLanes ) / stddevLanes;
+			}
+
+			// Sort and evaluate log(normalCDF(x)) and log(1 - normalCDF(x)) for all values
+			sort( rows.data(), networkBegin, networkEnd );
+			for( int32_t j = 0; j < n; ++j )
+				simd::log_normal_cdf( rows[j], lower[j], upper[j] );
+
+			double sums[simd::Width] = {};
+			for( int32_t j = 0; j < n; ++j )
+			{
+				( lower[j] + upper[n - 1 - j] ).store( lane );
+				for( int32_t l = 0; l < simd::Width; ++l )
+					sums[l] += ( 2 * j + 1 ) * static_cast<double>( lane[l] );
+			}
+
+			for( int32_t l = 0; l < lanes; ++l )
+				results[begin + l] = stddev[l] == 0.0f ? 1.0f : anderson_darling_pvalue( sums[l], n );
+		}
+	}
+
+	// Anderson-Darling test for normality for every voxel, dispatches to sorting networks specialized for common member counts
+	// (falls back to the scalar version for large member counts or if no SIMD instruction set is available)
+	inline void anderson_darling( const float* values, int32_t voxelCount, int32_t memberCount, const float* means, const float* stddevs, float* results )
+	{
+		if constexpr( simd::Native )
+		{
+			switch( memberCount )
+			{
+			case 16: return anderson_darling<16>( values, voxelCount, memberCount, means, stddevs, results );
+			case 20: return anderson_darling<20>( values, voxelCount, memberCount, means, stddevs, results );
+			case 25: return anderson_darling<25>( values, voxelCount, memberCount, means, stddevs, results );
+			case 32: return anderson_darling<32>( values, voxelCount, memberCount, means, stddevs, results );
+			case 50: return anderson_darling<50>( values, voxelCount, memberCount, means, stddevs, results );
+			case 64: return anderson_darling<64>( values, voxelCount, memberCount, means, stddevs, results );
+			case 100: return anderson_darling<100>( values, voxelCount, memberCount, means, stddevs, results );
+			case 128: return anderson_darling<128>( values, voxelCount, memberCount, means, stddevs, results );
+			case 200: return anderson_darling<200>( values, voxelCount, memberCount, means, stddevs, results );
+			case 256: return anderson_darling<256>( values, voxelCount, memberCount, means, stddevs, results );
+			}
+
+			if( memberCount <= MaxNetworkSize )
+				return anderson_darling<0>( values, voxelCount, memberCount, means, stddevs, results );
+		}
+
+		auto sorted = std::vector<float>();
+		for( int32_t i = 0; i < voxelCount; ++i )
+			results[i] = anderson_darling_scalar( values + static_cast<size_t>( i ) * memberCount, memberCount, means[i], stddevs[i], sorted );
+	}
+	// Quantile function of the standard normal distribution (bisection of the cumulative distribution function)
+	inline double normal_quantile( double p ) noexcept
+	{
+		auto lower = -10.0, upper = 10.0;
+		for( int32_t i = 0; i < 64; ++i )
+		{
+			const auto middle = 0.5 * ( lower + upper );
+			if( 0.5 * std::erfc( -middle * 0.707106781186547524401 ) < p ) lower = middle;
+			else upper = middle;
+		}
+		return 0.5 * ( lower + upper );
+	}
+
+	// Edges of z-score histogram bins with equal probability under a standard normal distribution (rounded to three decimals)
+	inline std::vector<double> z_score_edges( int32_t binCount )
+	{
+		auto edges = std::vector<double>( binCount - 1 );
+		for( int32_t i = 0; i < binCount - 1; ++i )
+			edges[i] = std::round( normal_quantile( ( i + 1.0 ) / binCount ) * 1000.0 ) / 1000.0 + 0.0; // Adding zero avoids negative zero
+		return edges;
+	}
+
+	// Quantiles that are computed for every voxel (lower quartile, median, upper quartile), interpolated linearly between order statistics
+	constexpr std::array<float, 3> Quartiles = { 0.25f, 0.5f, 0.75f };
+
+	// Explicit budgets for the computation of per-voxel quantiles. Up to 'MaxNetworkSize' members, SIMD selection networks are used (no additional memory).
+	// Up to 'exactMemberCount' members, the quantiles are selected exactly from a copy of the members (4 bytes per member and thread, linear time per voxel).
+	// Above, the members are summarized in a quantile sketch (4 bytes per bin and thread, time linear in members and bins, error at most (max - min) / bins).
+	struct QuantileBudget
+	{
+		int32_t exactMemberCount = 4096;
+		int32_t sketchBins = 1024;
+	};
+
+	// Ranks of the two order statistics that are interpolated for the quantile p of n values
+	inline std::pair<int32_t, int32_t> quantile_ranks( float p, int32_t n ) noexcept
+	{
+		const auto lower = static_cast<int32_t>( p * ( n - 1 ) );
+		return { lower, std::min( lower + 1, n - 1 ) };
+	}
+	inline float quantile_interpolate( float p, int32_t n, float lower, float upper ) noexcept
+	{
+		const auto h = p * ( n - 1 );
+		return lower + ( h - std::floor( h ) ) * ( upper - lower );
+	}
+
+	// Quantile sketch with a fixed number of equally sized bins over a known value range (e.g. the minimum and maximum of the voxel). Sketches with the same
+	// range and bin count can be merged, e.g. when the members are processed in chunks. Order statistics are assumed to be evenly spread within their bin.
+	class QuantileSketch
+	{
+	public:
+		QuantileSketch( int32_t bins ) : _counts( bins )
+		{}
+
+		int32_t bins() const noexcept
+		{
+			return static_cast<int32_t>( _counts.size() );
+		}
+
+		void reset( float minimum, float maximum ) noexcept
+		{
+			std::fill( _counts.begin(), _counts.end(), 0 );
+			_count = 0;
+			_minimum = minimum;
+			_maximum = maximum;
+			_scale = maximum > minimum ? _counts.size() / ( maximum - minimum ) : 0.0f;
+		}
+		void add( float value ) noexcept
+		{
+			++_counts[std::clamp( static_cast<int32_t>( ( value - _minimum ) * _scale ), 0, static_cast<int32_t>( _counts.size() ) - 1 )];
+			++_count;
+		}
+		void merge( const QuantileSketch& other )
+		{
+			if( _counts.size() != other._counts.size() || _minimum != other._minimum || _maximum != other._maximum )
+				throw std::runtime_error( "QuantileSketch::merge -> Sketches with different bins cannot be merged" );
+			for( size_t i = 0; i < _counts.size(); ++i ) _counts[i] += other._counts[i];
+			_count += other._count;
+		}
+
+		// Estimate the quantile p (in [0, 1]) of all added values
+		float quantile( float p ) const noexcept
+		{
+			const auto [lower, upper] = quantile_ranks( p, _count );
+			return quantile_interpolate( p, _count, this->orderStatistic( lower ), this->orderStatistic( upper ) );
+		}
+
+	private:
+		float orderStatistic( int32_t rank ) const noexcept
+		{
+			if( _scale == 0.0f ) return _minimum;
+
+			auto before = 0;
+			for( size_t bin = 0; bin < _counts.size(); ++bin )
+			{
+				if( rank < before + _counts[bin] ) return std::min( _maximum, _minimum + ( bin + ( rank - before + 0.5f ) / _counts[bin] ) / _scale );
+				before += _counts[bin];
+			}
+			return _maximum;
+		}
+
+		std::vector<int32_t> _counts;
+		int32_t _count = 0;
+		float _minimum = 0.0f;
+		float _maximum = 0.0f;
+		float _scale = 0.0f;
+	};
+
+	// Selection network for the order statistics of the quartiles of n values (cached per thread). The sorting network is pruned to the comparators whose
+	// results are needed for the selected ranks.
+	inline const std::vector<Comparator>& quartile_network( int32_t n )
+	{
+		thread_local auto size = -1;
+		thread_local auto comparators = std::vector<Comparator>();
+		if( size != n )
+		{
+			auto needed = std::vector<bool>( n );
+			for( const auto p : Quartiles )
+			{
+				const auto [lower, upper] = quantile_ranks( p, n );
+				needed[lower] = needed[upper] = true;
+			}
+
+			const auto& network = sorting_network( n );
+			comparators.clear();
+			for( auto comparator = network.rbegin(); comparator != network.rend(); ++comparator )
+			{
+				if( !needed[comparator->first] && !needed[comparator->second] ) continue;
+				needed[comparator->first] = needed[comparator->second] = true;
+				comparators.push_back( *comparator );
+			}
+			std::reverse( comparators.begin(), comparators.end() );
+			size = n;
+		}
+		return comparators;
+	}
+
+	// Quartiles of every voxel, the results are stored as [voxel][quartile]. Dispatches to selection networks, exact selection or quantile sketches based on the budget.
+	inline void quartiles( const float* values, int32_t voxelCount, int32_t memberCount, const float* minimums, const float* maximums, const QuantileBudget& budget, float* results )
+	{
+		if( simd::Native && memberCount <= MaxNetworkSize )
+		{
+			const auto& network = quartile_network( memberCount );
+			thread_local auto rows = std::vector<simd::floatv>();
+			rows.resize( memberCount );
+
+			for( int32_t begin = 0; begin < voxelCount; begin += simd::Width )
+			{
+				const auto lanes = std::min( simd::Width, voxelCount - begin );
+
+				// Transpose the member values into the lanes and select the order statistics
+				float lane[simd::Width] = {}, lower[simd::Width], upper[simd::Width];
+				for( int32_t j = 0; j < memberCount; ++j )
+				{
+					for( int32_t l = 0; l < lanes; ++l ) lane[l] = values[static_cast<size_t>( begin + l ) * memberCount + j];
+					rows[j] = simd::floatv::load( lane );
+				}
+				sort( rows.data(), network.data(), network.data() + network.size() );
+
+				for( size_t q = 0; q < Quartiles.size(); ++q )
+				{
+					const auto [lowerRank, upperRank] = quantile_ranks( Quartiles[q], memberCount );
+					rows[lowerRank].store( lower );
+					rows[upperRank].store( upper );
+					for( int32_t l = 0; l < lanes; ++l )
+						results[( begin + l ) * Quartiles.size() + q] = quantile_interpolate( Quartiles[q], memberCount, lower[l], upper[l] );
+				}
+			}
+		}
+		else if( memberCount <= budget.exactMemberCount )
+		{
+			thread_local auto scratch = std::vector<float>();
+			for( int32_t i = 0; i < voxelCount; ++i )
+			{
+				const auto members = values + static_cast<size_t>( i ) * memberCount;
+				scratch.assign( members, members + memberCount );
+
+				// Select from the highest to the lowest quantile, so that every selection only needs to partition the values below the previous one
+				auto end = scratch.end();
+				for( auto q = static_cast<int32_t>( Quartiles.size() ) - 1; q >= 0; --q )
+				{
+					const auto [lowerRank, upperRank] = quantile_ranks( Quartiles[q], memberCount );
+					std::nth_element( scratch.begin(), scratch.begin() + lowerRank, end );
+					const auto lower = scratch[lowerRank];
+					const auto upper = upperRank == lowerRank ? lower : *std::min_element( scratch.begin() + upperRank, scratch.end() );
+					results[i * Quartiles.size() + q] = quantile_interpolate( Quartiles[q], memberCount, lower, upper );
+					end = scratch.begin() + lowerRank + 1;
+				}
+			}
+		}
+		else
+		{
+			thread_local auto sketch = QuantileSketch( 0 );
+			if( sketch.bins() != budget.sketchBins ) sketch = QuantileSketch( budget.sketchBins );
+			for( int32_t i = 0; i < voxelCount; ++i )
+			{
+				const auto members = values + static_cast<size_t>( i ) * memberCount;
+				sketch.reset( minimums[i], maximums[i] );
+				for( int32_t j = 0; j < memberCount; ++j ) sketch.add( members[j] );
+				for( size_t q = 0; q < Quartiles.size(); ++q )
+					results[i * Quartiles.size() + q] = sketch.quantile( Quartiles[q] );
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+#include "bricks.hpp"
+#include "simd.hpp"
+
+// Engine for stencil filters (e.g. gradients, smoothing) on volumes. The volume is processed in bricks, every brick is copied together with a halo of
+// 'Radius' voxels into a padded buffer. Coordinates outside the volume are clamped to the border, so kernels can access their neighborhood without any
+// bounds checks or branches. Kernels are called for rows of up to simd::Width voxels along the z-axis.
+namespace stencil
+{
+	// Edge length of the bricks (without halo)
+	constexpr int32_t BrickSize = 16;
+
+	// Row of voxels that is passed to the kernels
+	struct Row
+	{
+		const float* center = nullptr;
+		int32_t strideX = 0;
+		int32_t strideY = 0;
+		vec3i dimensions;
+		vec3i voxel;
+		int32_t index = 0;
+		int32_t count = 0;
+
+		// Load the values at an offset from the voxels of the row (|offset| <= Radius)
+		simd::floatv at( int32_t x, int32_t y, int32_t z ) const noexcept
+		{
+			return simd::floatv::load( center + x * strideX + y * strideY + z );
+		}
+
+		// Return the z-coordinates of the voxels of the row
+		simd::floatv z() const noexcept
+		{
+			float lanes[simd::Width];
+			for( int32_t i = 0; i < simd::Width; ++i ) lanes[i] = static_cast<float>( voxel.z + i );
+			return simd::floatv::load( lanes );
+		}
+
+		// Store the values of the row to a volume
+		void store( Volume<float>& volume, simd::floatv values ) const noexcept
+		{
+			if( count == simd::Width ) values.store( volume.data() + index );
+			else
+			{
+				float lanes[simd::Width];
+				values.store( lanes );
+				std::copy( lanes, lanes + count, volume.data() + index );
+			}
+		}
+	};
+
+	// Apply a kernel (void( const Row& )) to all voxels of the volume in parallel
+	template<int32_t Radius, typename Kernel> void apply( const Volume<float>& volume, const Kernel& kernel )
+	{
+		const auto dimensions = volume.dimensions();
+		const auto layout = BrickLayout( dimensions, BrickSize );
+
+		// Strides within the padded brick, the buffer is over-allocated so that rows can always be loaded as full vectors
+		constexpr auto padded = BrickSize + 2 * Radius;
+		constexpr auto strideY = padded;
+		constexpr auto strideX = padded * padded;
+
+		util::compute_multi_threaded( 0, layout.brickCount(), [&] ( int32_t begin, int32_t end )
+		{
+			auto buffer = std::vector<float>( padded * padded * padded + simd::Width );
+			for( int32_t brick = begin; brick < end; ++brick )
+			{
+				const auto origin = layout.origin( brick );
+				const auto extent = layout.extent( brick );
+
+				// Copy the brick and its halo, clamping coordinates to the volume
+				for( int32_t x = -Radius; x < extent.x + Radius; ++x )
+				{
+					for( int32_t y = -Radius; y < extent.y + Radius; ++y )
+					{
+						const auto source = volume.data() + volume.voxelToIndex( vec3i( std::clamp( origin.x + x, 0, dimensions.x - 1 ), std::clamp( origin.y + y, 0, dimensions.y - 1 ), 0 ) );
+						auto destination = buffer.data() + ( x + Radius ) * strideX + ( y + Radius ) * strideY;
+						for( int32_t z = -Radius; z < extent.z + Radius; ++z )
+							*destination++ = source[std::clamp( origin.z + z, 0, dimensions.z - 1 )];
+					}
+				}
+
+				// Run the kernel on all rows of the brick
+				auto row = Row();
+				row.strideX = strideX;
+				row.strideY = strideY;
+				row.dimensions = dimensions;
+				for( int32_t x = 0; x < extent.x; ++x )
+				{
+					for( int32_t y = 0; y < extent.y; ++y )
+					{
+						for( int32_t z = 0; z < extent.z; z += simd::Width )
+						{
+							row.center = buffer.data() + ( x + Radius ) * strideX + ( y + Radius ) * strideY + z + Radius;
+							row.voxel = origin + vec3i( x, y, z );
+							row.index = volume.voxelToIndex( row.voxel );
+							row.count = std::min( simd::Width, extent.z - z );
+							kernel( row );
+						}
+					}
+				}
+			}
+		} );
+	}
+}
\ No newline at end of file
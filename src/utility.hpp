@@ -1,6 +1,19 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <qlayout.h>
@@ -8,29 +21,29 @@
 
 namespace util
 {
-	// Helper functions for writing objects to a binary file
-	template<typename T> void write_binary( std::ofstream& stream, const T& value )
+	// Helper functions for writing objects to a binary file (or any other binary stream)
+	template<typename T> void write_binary( std::ostream& stream, const T& value )
 	{
 		stream.write( reinterpret_cast<const char*>( &value ), sizeof( T ) );
 	}
-	template<typename T> void read_binary( std::ifstream& stream, T& value )
+	template<typename T> void read_binary( std::istream& stream, T& value )
 	{
 		stream.read( reinterpret_cast<char*>( &value ), sizeof( value ) );
 	}
-	template<typename T> T read_binary( std::ifstream& stream )
+	template<typename T> T read_binary( std::istream& stream )
 	{
 		T value;
 		stream.read( reinterpret_cast<char*>( &value ), sizeof( value ) );
 		return value;
 	}
 
-	template<> inline void write_binary<std::string>( std::ofstream& stream, const std::string& string )
+	template<> inline void write_binary<std::string>( std::ostream& stream, const std::string& string )
 	{
 		const auto size = string.size();
 		stream.write( reinterpret_cast<const char*>( &size ), sizeof( size ) );
 		stream.write( reinterpret_cast<const char*>( string.data() ), string.size() );
 	}
-	template<> inline void read_binary<std::string>( std::ifstream& stream, std::string& string )
+	template<> inline void read_binary<std::string>( std::istream& stream, std::string& string )
 	{
 		size_t size;
 		stream.read( reinterpret_cast<char*>( &size ), sizeof( size ) );
@@ -39,13 +52,13 @@ namespace util
 		stream.read( reinterpret_cast<char*>( string.data() ), size );
 	}
 
-	template<typename T> void write_binary_vector( std::ofstream& stream, const std::vector<T>& values )
+	template<typename T> void write_binary_vector( std::ostream& stream, const std::vector<T>& values )
 	{
 		const auto size = values.size();
 		stream.write( reinterpret_cast<const char*>( &size ), sizeof( size ) );
 		stream.write( reinterpret_cast<const char*>( values.data() ), values.size() * sizeof( T ) );
 	}
-	template<typename T> void read_binary_vector( std::ifstream& stream, std::vector<T>& values )
+	template<typename T> void read_binary_vector( std::istream& stream, std::vector<T>& values )
 	{
 		size_t size;
 		stream.read( reinterpret_cast<char*>( &size ), sizeof( size ) );
@@ -60,6 +73,50 @@ namespace util
 		return seed ^ ( std::hash<T>()( v ) + 0x9e3779b9 + ( seed << 6 ) + ( seed >> 2 ) );
 	}
 
+	// Convert between single- and half-precision floats (round to nearest even, https://en.wikipedia.org/wiki/Half-precision_floating-point_format)
+	inline uint16_t float_to_half( float value ) noexcept
+	{
+		auto bits = 0u;
+		std::memcpy( &bits, &value, sizeof( bits ) );
+		const auto sign = static_cast<uint16_t>( ( bits >> 16 ) & 0x8000 );
+		bits &= 0x7FFFFFFF;
+
+		// Overflow, infinity and NaN
+		if( bits >= 0x47800000 ) return sign | 0x7C00 | ( bits > 0x7F800000 ? 0x0200 : 0 );
+
+		// Subnormal numbers (in units of 2^-24)
+		if( bits < 0x38800000 )
+		{
+			auto magnitude = 0.0f;
+			std::memcpy( &magnitude, &bits, sizeof( magnitude ) );
+			return sign | static_cast<uint16_t>( std::nearbyint( magnitude * 16777216.0f ) );
+		}
+
+		// Normal numbers: rebias the exponent and round the mantissa
+		bits += 0x0FFF + ( ( bits >> 13 ) & 1 );
+		return sign | static_cast<uint16_t>( ( bits - 0x38000000 ) >> 13 );
+	}
+	inline float half_to_float( uint16_t half ) noexcept
+	{
+		const auto sign = static_cast<uint32_t>( half & 0x8000 ) << 16;
+		const auto exponent = ( half >> 10 ) & 0x1F;
+		const auto mantissa = static_cast<uint32_t>( half & 0x03FF );
+
+		auto bits = 0u;
+		if( exponent == 0 )
+		{
+			const auto magnitude = mantissa / 16777216.0f;
+			std::memcpy( &bits, &magnitude, sizeof( bits ) );
+			bits |= sign;
+		}
+		else if( exponent == 31 ) bits = sign | 0x7F800000 | ( mantissa << 13 );
+		else bits = sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 );
+
+		auto value = 0.0f;
+		std::memcpy( &value, &bits, sizeof( value ) );
+		return value;
+	}
+
 	// Convert RGB to LAB (http://www.easyrgb.com/index.php?X=MATH&H=01#text1)
 	inline vec3f rgb2lab( vec3f rgb )
 	{
@@ -135,23 +192,276 @@ namespace util
 		return vec3f( var_R, var_G, var_B );
 	}
 
+	// Pool of worker threads that is shared by all parallel computations (see util::thread_pool())
+	class ThreadPool
+	{
+	public:
+		// Group of tasks that can be waited for. Waiting threads execute queued tasks of the group themselves, so tasks can create and wait for groups as
+		// well. Every group has its own queue, so a wait is never delayed by unrelated (possibly long) tasks of other groups.
+		class TaskGroup
+		{
+		public:
+			TaskGroup( ThreadPool& pool ) noexcept : _pool( pool )
+			{}
+			TaskGroup( const TaskGroup& ) = delete;
+			~TaskGroup()
+			{
+				_pool.help( *this );
+			}
+
+			// Queue a task (may be called from tasks of the group)
+			void run( std::function<void()> task )
+			{
+				{
+					const auto lock = std::scoped_lock( _pool._mutex );
+					++_pending;
+					if( _tasks.empty() ) _pool._groups.push_back( this );
+					_tasks.push_back( [this, task = std::move( task )]
+					{
+						auto exception = std::exception_ptr();
+						try { task(); } catch( ... ) { exception = std::current_exception(); }
+
+						const auto lock = std::scoped_lock( _pool._mutex );
+						if( exception && !_exception ) _exception = exception;
+						if( --_pending == 0 ) _condition.notify_all();
+					} );
+				}
+				_condition.notify_one();
+				_pool._condition.notify_one();
+			}
+
+			// Wait for all tasks of the group, rethrows the first exception of a task
+			void wait()
+			{
+				_pool.help( *this );
+				if( _exception ) std::rethrow_exception( std::exchange( _exception, nullptr ) );
+			}
+
+		private:
+			friend class ThreadPool;
+
+			// Remove the most recent task from the queue (the mutex of the pool has to be locked)
+			std::function<void()> pop()
+			{
+				auto task = std::move( _tasks.back() );
+				_tasks.pop_back();
+				if( _tasks.empty() ) _pool._groups.erase( std::find( _pool._groups.begin(), _pool._groups.end(), this ) );
+				return task;
+			}
+
+			ThreadPool& _pool;
+			std::deque<std::function<void()>> _tasks;
+			std::condition_variable _condition;
+			int32_t _pending = 0;
+			std::exception_ptr _exception;
+		};
+
+		ThreadPool( int32_t threadCount )
+		{
+			for( int32_t i = 0; i < threadCount; ++i ) _threads.emplace_back( [this] { this->work(); } );
+		}
+		ThreadPool( const ThreadPool& ) = delete;
+		~ThreadPool()
+		{
+			{
+				const auto lock = std::scoped_lock( _mutex );
+				_stopping = true;
+			}
+			_condition.notify_all();
+			for( auto& thread : _threads ) thread.join();
+		}
+
+		// Number of threads that execute tasks in parallel (workers and the waiting thread)
+		int32_t concurrency() const noexcept
+		{
+			return static_cast<int32_t>( _threads.size() ) + 1;
+		}
+
+	private:
+		// Execute the tasks of all groups until the pool is destroyed. The most recent groups are served first, so workers prefer the tasks of nested groups.
+		void work()
+		{
+			auto lock = std::unique_lock( _mutex );
+			while( true )
+			{
+				_condition.wait( lock, [this] { return _stopping || !_groups.empty(); } );
+				if( _stopping ) return;
+
+				auto task = _groups.back()->pop();
+				lock.unlock();
+				task();
+				lock.lock();
+			}
+		}
+
+		// Execute the tasks of the group until all of them are finished (tasks that are already running on other threads are waited for)
+		void help( TaskGroup& group )
+		{
+			auto lock = std::unique_lock( _mutex );
+			while( true )
+			{
+				group._condition.wait( lock, [&group] { return group._pending == 0 || !group._tasks.empty(); } );
+				if( group._pending == 0 ) return;
+
+				auto task = group.pop();
+				lock.unlock();
+				task();
+				lock.lock();
+			}
+		}
+
+		std::vector<std::thread> _threads;
+		std::vector<TaskGroup*> _groups;
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		bool _stopping = false;
+	};
+
+	// Global thread pool with one thread per hardware thread (including the waiting thread)
+	inline ThreadPool& thread_pool()
+	{
+		static auto pool = ThreadPool( std::max( 1, static_cast<int32_t>( std::thread::hardware_concurrency() ) ) - 1 );
+		return pool;
+	}
+
 	// Helper function to easily setup parallel computation
 	inline void compute_multi_threaded( const std::function<void( int32_t, int32_t )>& function )
 	{
-		auto threads = std::vector<std::thread>( std::thread::hardware_concurrency() );
-		for( int32_t i = 0; i < threads.size(); ++i ) threads[i] = std::thread( function, i, static_cast<int32_t>( threads.size() ) );
-		for( auto& thread : threads ) thread.join();
+		const auto count = thread_pool().concurrency();
+		auto group = ThreadPool::TaskGroup( thread_pool() );
+		for( int32_t i = 0; i < count; ++i ) group.run( [&function, i, count] { function( i, count ); } );
+		group.wait();
 	}
 	inline void compute_multi_threaded( int32_t begin, int32_t end, const std::function<void( int32_t, int32_t )>& function )
 	{
-		auto threads = std::vector<std::thread>( std::thread::hardware_concurrency() );
-		int32_t step = ( end - begin ) / threads.size();
-		for( int32_t i = 0; i < threads.size(); ++i )
+		const auto count = thread_pool().concurrency();
+		const auto step = ( end - begin ) / count;
+		auto group = ThreadPool::TaskGroup( thread_pool() );
+		for( int32_t i = 0; i < count; ++i )
 		{
-			threads[i] = std::thread( function, begin, ( i == threads.size() - 1 ) ? end : begin + step );
+			const auto chunkEnd = ( i == count - 1 ) ? end : begin + step;
+			group.run( [&function, begin, chunkEnd] { function( begin, chunkEnd ); } );
 			begin += step;
 		}
-		for( auto& thread : threads ) thread.join();
+		group.wait();
+	}
+
+	// Range of a file that is read into a preallocated buffer
+	struct FileRange
+	{
+		uint64_t offset = 0;
+		uint64_t bytes = 0;
+		void* destination = nullptr;
+	};
+
+	// Read ranges of a file in parallel. The ranges are split into chunks and every task reads chunks with its own stream (positional reads), so several
+	// requests are outstanding at once and the throughput of fast drives is not limited by a single thread.
+	inline void read_parallel( const std::filesystem::path& filepath, const std::vector<FileRange>& ranges, uint64_t chunkSize = 8 << 20 )
+	{
+		auto chunks = std::vector<FileRange>();
+		for( const auto& range : ranges ) for( uint64_t offset = 0; offset < range.bytes; offset += chunkSize )
+			chunks.push_back( FileRange { range.offset + offset, std::min( chunkSize, range.bytes - offset ), static_cast<char*>( range.destination ) + offset } );
+
+		auto next = std::atomic<size_t>( 0 );
+		auto failed = std::atomic<bool>( false );
+		compute_multi_threaded( [&] ( int32_t, int32_t )
+		{
+			auto stream = std::ifstream( filepath, std::ios::in | std::ios::binary );
+			for( auto i = next++; i < chunks.size() && stream; i = next++ )
+			{
+				stream.seekg( chunks[i].offset );
+				stream.read( static_cast<char*>( chunks[i].destination ), chunks[i].bytes );
+			}
+			if( !stream ) failed = true;
+		} );
+		if( failed ) throw std::runtime_error( "util::read_parallel -> Failed to read file " + filepath.string() );
+	}
+
+	// Read whitespace-separated numbers from a text file (e.g. to convert legacy text files to binary files)
+	template<typename T> std::vector<T> read_text_values( const std::filesystem::path& filepath )
+	{
+		auto stream = std::ifstream( filepath, std::ios::in | std::ios::binary );
+		if( !stream ) throw std::runtime_error( "util::read_text_values -> Failed to open file " + filepath.string() );
+		const auto text = std::string( std::istreambuf_iterator<char>( stream ), std::istreambuf_iterator<char>() );
+
+		// The numbers are parsed independently of the locale, reading stops at the first text that is not a number
+		auto values = std::vector<T>();
+		const auto end = text.data() + text.size();
+		for( auto position = text.data(); ; )
+		{
+			position = std::find_if_not( position, end, [] ( char character ) { return std::isspace( static_cast<unsigned char>( character ) ); } );
+			if( position != end && *position == '+' ) ++position;
+
+			auto value = 0.0;
+			const auto [next, error] = std::from_chars( position, end, value );
+			if( error == std::errc::invalid_argument ) break;
+			if( error == std::errc::result_out_of_range ) throw std::runtime_error( "util::read_text_values -> Number out of range in file " + filepath.string() );
+			values.push_back( static_cast<T>( value ) );
+			position = next;
+		}
+		return values;
+	}
+
+	// Write a file through a temporary file, which replaces the file once it was written completely (so a failed write leaves no partial file behind)
+	inline void write_file( const std::filesystem::path& filepath, const std::function<void( std::ostream& )>& write )
+	{
+		const auto temporary = std::filesystem::path( filepath ).concat( ".tmp" );
+		{
+			auto stream = std::ofstream( temporary, std::ios::out | std::ios::binary );
+			write( stream );
+			stream.close();
+			if( !stream )
+			{
+				std::filesystem::remove( temporary );
+				throw std::runtime_error( "util::write_file -> Failed to write file " + temporary.string() );
+			}
+		}
+		std::filesystem::rename( temporary, filepath );
+	}
+
+	// Node of a task graph, the task is run after all nodes it depends on (indices into the graph) are finished
+	struct GraphNode
+	{
+		std::function<void()> task;
+		std::vector<int32_t> dependencies;
+	};
+
+	// Run an acyclic task graph on the thread pool, all nodes whose dependencies are finished run concurrently
+	inline void compute_graph( const std::vector<GraphNode>& graph )
+	{
+		auto pending = std::vector<int32_t>( graph.size() );
+		auto dependents = std::vector<std::vector<int32_t>>( graph.size() );
+		for( int32_t i = 0; i < graph.size(); ++i )
+		{
+			pending[i] = static_cast<int32_t>( graph[i].dependencies.size() );
+			for( const auto dependency : graph[i].dependencies ) dependents[dependency].push_back( i );
+		}
+
+		auto mutex = std::mutex();
+		auto group = ThreadPool::TaskGroup( thread_pool() );
+		auto start = std::function<void( int32_t )>();
+		start = [&] ( int32_t node )
+		{
+			group.run( [&, node]
+			{
+				graph[node].task();
+				for( const auto dependent : dependents[node] )
+				{
+					auto ready = false;
+					{
+						const auto lock = std::scoped_lock( mutex );
+						ready = --pending[dependent] == 0;
+					}
+					if( ready ) start( dependent );
+				}
+			} );
+		};
+
+		// Collect the roots before starting any task, as finished tasks already modify the pending counts
+		auto roots = std::vector<int32_t>();
+		for( int32_t i = 0; i < graph.size(); ++i ) if( pending[i] == 0 ) roots.push_back( i );
+		for( const auto root : roots ) start( root );
+		group.wait();
 	}
 
 	// Helper function to easily create box layouts in a single line
@@ -1,13 +1,34 @@
 #pragma once
 #include "utility.hpp"
+#include "fingerprint.hpp"
+#include "mapped_file.hpp"
 #include "math.hpp"
+#include "memory.hpp"
 
 #include <qstring.h>
 #include <qopenglcontext.h>
 #include <qopenglfunctions_4_5_core.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 
+namespace util
+{
+	// Make a context of the global share group current, unless one is current already (e.g. to delete textures outside of widgets, when data is evicted or
+	// destroyed). Returns false if the global share context doesn't exist anymore, its objects are deleted with it.
+	inline bool make_share_context_current()
+	{
+		const auto context = QOpenGLContext::globalShareContext();
+		if( !context ) return false;
+
+		const auto current = QOpenGLContext::currentContext();
+		if( current && QOpenGLContext::areSharing( current, context ) ) return true;
+		return context->surface() && context->makeCurrent( context->surface() );
+	}
+}
+
 // Class to manage a volume
 template<typename T> class Volume
 {
@@ -15,81 +36,111 @@ public:
 	Volume() noexcept = default;
 
 	// Create a volume from specified dimensions, values, name, or read it from a file
-	Volume( vec3i dimensions, QString name = "" ) : _name( std::move( name ) ), _dimensions( dimensions ), _values( dimensions.product() )
+	Volume( vec3i dimensions, QString name = "" ) : _name( std::move( name ) ), _dimensions( dimensions ), _values( dimensions.product() ), _data( _values.data() )
 	{}
-	Volume( vec3i dimensions, std::vector<T> values, QString name = "" ) : _name( std::move( name ) ), _dimensions( dimensions ), _values( std::move( values ) )
+	Volume( vec3i dimensions, std::vector<T> values, QString name = "" ) : _name( std::move( name ) ), _dimensions( dimensions ), _values( std::move( values ) ), _data( _values.data() )
 	{
 		if( dimensions.product() != _values.size() )
 			throw std::runtime_error( "Volume::Volume( vec3i, std::vector<T> ) -> Dimensions dont match size of vector." );
 	}
-	Volume( std::ifstream& stream )
+
+	// Create a volume that wraps values it does not own (e.g. in a mapped file), 'owner' keeps the values alive
+	Volume( vec3i dimensions, T* values, std::shared_ptr<const void> owner, QString name = "" ) : _name( std::move( name ) ), _dimensions( dimensions ), _data( values ), _owner( std::move( owner ) )
+	{}
+
+	// Read a volume from a stream, the values either follow in the stream or the stream contains their offset in the mapped file
+	Volume( std::istream& stream, const std::shared_ptr<const MappedFile>& file = nullptr )
 	{
 		std::string name;
 		util::read_binary( stream, name );
 		_name = QString::fromStdString( name );
 
 		util::read_binary( stream, _dimensions );
-		util::read_binary_vector( stream, _values );
+		if( file )
+		{
+			const auto offset = util::read_binary<uint64_t>( stream );
+			_data = file->data<T>( offset, static_cast<uint64_t>( _dimensions.product() ) * sizeof( T ) );
+			_owner = file;
+		}
+		else
+		{
+			util::read_binary_vector( stream, _values );
+			_data = _values.data();
+		}
 		util::read_binary( stream, _domain );
 		_domainValid = true;
 	}
 
-	// Copy and move constructors
-	Volume( const Volume& other ) : _name( other._name ), _dimensions( other._dimensions ), _values( other._values ), _domain( other._domain ), _domainValid( other._domainValid ), _texture( 0 ), _textureValid( false )
+	// Copy and move constructors (copies always own their values)
+	Volume( const Volume& other ) : _name( other._name ), _dimensions( other._dimensions ), _values( other.begin(), other.end() ), _data( _values.data() ), _domain( other._domain ), _domainValid( other._domainValid.load() ),
+		_fingerprint( other._fingerprint ), _fingerprintValid( other._fingerprintValid.load() ), _texture( 0 ), _textureValid( false )
 	{}
-	Volume( Volume&& other ) : _name( std::move( other._name ) ), _dimensions( other._dimensions ), _values( std::move( other._values ) ), _domain( other._domain ), _domainValid( other._domainValid ), _texture( other._texture ), _textureValid( other._textureValid )
+	Volume( Volume&& other ) : _name( std::move( other._name ) ), _dimensions( other._dimensions ), _values( std::move( other._values ) ), _data( std::exchange( other._data, nullptr ) ), _owner( std::move( other._owner ) ),
+		_domain( other._domain ), _domainValid( other._domainValid.load() ), _fingerprint( other._fingerprint ), _fingerprintValid( other._fingerprintValid.load() ),
+		_texture( other._texture ), _textureValid( other._textureValid )
 	{
 		other._texture = 0;
 		other._textureValid = false;
+		this->trackTexture( &other );
 	}
 
 	// Copy and move assignment operators
 	Volume& operator=( const Volume& other )
 	{
+		this->releaseTexture();
 		_name = other._name;
 		_dimensions = other._dimensions;
-		_values = other._values;
+		_values = std::vector<T>( other.begin(), other.end() );
+		_data = _values.data();
+		_owner.reset();
 		_domain = other._domain;
-		_domainValid = other._domainValid;
+		_domainValid = other._domainValid.load();
+		_fingerprint = other._fingerprint;
+		_fingerprintValid = other._fingerprintValid.load();
+		_revision = Volume::nextRevision();
 		_texture = 0;
 		_textureValid = false;
 		return *this;
 	}
 	Volume& operator=( Volume&& other )
 	{
+		this->releaseTexture();
 		_name = std::move( other._name );
 		_dimensions = other._dimensions;
 		_values = std::move( other._values );
+		_data = std::exchange( other._data, nullptr );
+		_owner = std::move( other._owner );
 		_domain = other._domain;
-		_domainValid = other._domainValid;
+		_domainValid = other._domainValid.load();
+		_fingerprint = other._fingerprint;
+		_fingerprintValid = other._fingerprintValid.load();
+		_revision = Volume::nextRevision();
 		_texture = other._texture;
 		_textureValid = other._textureValid;
 
 		other._texture = 0;
 		other._textureValid = false;
+		this->trackTexture( &other );
 		return *this;
 	}
 
 	// Destructor :)
 	virtual ~Volume()
 	{
-		if( _texture )
-		{
-			const auto context = QOpenGLContext::globalShareContext();
-			const auto functions = context->versionFunctions<QOpenGLFunctions_4_5_Core>();
-			functions->glDeleteTextures( 1, &_texture );
-
-			_texture = 0;
-			_textureValid = false;
-		}
+		this->releaseTexture();
 	}
 
-	// Save volume to file
-	void save( std::ofstream& stream ) const
+	// Save volume to a stream, or save the values to the data of a mapped file and only their offset to the stream
+	void save( std::ostream& stream, MappedFileWriter* data = nullptr ) const
 	{
 		util::write_binary( stream, _name.toStdString() );
 		util::write_binary( stream, _dimensions );
-		util::write_binary_vector( stream, _values );
+		if( data ) util::write_binary( stream, data->write( _data, static_cast<uint64_t>( this->voxelCount() ) * sizeof( T ) ) );
+		else
+		{
+			util::write_binary( stream, static_cast<size_t>( this->voxelCount() ) );
+			stream.write( reinterpret_cast<const char*>( _data ), static_cast<size_t>( this->voxelCount() ) * sizeof( T ) );
+		}
 
 		if constexpr( std::is_arithmetic<T>::value ) auto domain = this->domain();
 		util::write_binary( stream, _domain );
@@ -108,13 +159,40 @@ public:
 	// Getter and setter for the volume values
 	void setValues( std::vector<T> values )
 	{
-		if( values.size() != _values.size() ) throw std::runtime_error( "Volume::setValues -> Wrong number of values were given." );
+		if( values.size() != this->voxelCount() ) throw std::runtime_error( "Volume::setValues -> Wrong number of values were given." );
 		_values = std::move( values );
+		_data = _values.data();
+		_owner.reset();
 		this->invalidate();
 	}
-	const std::vector<T>& values() const noexcept
+	std::vector<T> values() const
+	{
+		return std::vector<T>( this->begin(), this->end() );
+	}
+
+	// Check whether the volume wraps values it does not own (e.g. in a mapped file)
+	bool wrapped() const noexcept
+	{
+		return _owner != nullptr;
+	}
+
+	// Copy wrapped values into the volume, so it doesn't reference their owner anymore (e.g. to release a mapped file), the values don't change
+	void own()
 	{
-		return _values;
+		if( !_owner ) return;
+		_values = std::vector<T>( this->begin(), this->end() );
+		_data = _values.data();
+		_owner.reset();
+	}
+
+	// Wrap the equal values of another volume instead (e.g. the same values in a new mapped file), or copy them into the volume if there is none. The values
+	// don't change.
+	void wrap( const Volume* other )
+	{
+		if( !other || !other->_owner || other->_dimensions != _dimensions ) return this->own();
+		_data = other->_data;
+		_owner = other->_owner;
+		_values = std::vector<T>();
 	}
 
 	// Getters for basic statistics
@@ -124,35 +202,35 @@ public:
 	}
 	int32_t voxelCount() const noexcept
 	{
-		return _values.size();
+		return _data ? _dimensions.product() : 0;
 	}
 
 	// Data pointer getters
 	const T* data() const noexcept
 	{
-		return _values.data();
+		return _data;
 	}
 	T* data() noexcept
 	{
-		return _values.data();
+		return _data;
 	}
 
 	const T* begin() const noexcept
 	{
-		return _values.data();
+		return _data;
 	}
 	T* begin() noexcept
 	{
-		return _values.data();
+		return _data;
 	}
 
 	const T* end() const noexcept
 	{
-		return _values.data() + _values.size();
+		return _data + this->voxelCount();
 	}
 	T* end() noexcept
 	{
-		return _values.data() + _values.size();
+		return _data + this->voxelCount();
 	}
 
 	// Convert a 3D voxel position to an index into the underlying data vector
@@ -164,20 +242,20 @@ public:
 	// Element access
 	const T& at( int32_t index ) const
 	{
-		return _values[index];
+		return _data[index];
 	}
 	T& at( int32_t index )
 	{
-		return _values[index];
+		return _data[index];
 	}
 
 	const T& at( vec3i coords ) const
 	{
-		return _values[this->voxelToIndex( coords )];
+		return _data[this->voxelToIndex( coords )];
 	}
 	T& at( vec3i coords )
 	{
-		return  _values[this->voxelToIndex( coords )];
+		return  _data[this->voxelToIndex( coords )];
 	}
 
 	// Getter for the value domain (for example, some volume should always have the domain [0,1])
@@ -185,17 +263,42 @@ public:
 	{
 		static_assert( std::is_arithmetic<T>::value, "Type must be arithmetic to compute domain." );
 
-		// The domain is cached, so compute it if its not available (lazy evaluation)
-		if( !_domainValid )
+		// The domain is cached, so compute it if its not available (lazy evaluation, may be called from multiple threads)
+		if( !_domainValid.load( std::memory_order_acquire ) )
 		{
-			const auto [min, max] = std::minmax_element( _values.begin(), _values.end() );
-			_domain = vec2<T>( *min, *max );
-			_domainValid = true;
+			const auto lock = std::scoped_lock( _domainMutex );
+			if( !_domainValid.load( std::memory_order_relaxed ) )
+			{
+				const auto [min, max] = std::minmax_element( this->begin(), this->end() );
+				_domain = vec2<T>( *min, *max );
+				_domainValid.store( true, std::memory_order_release );
+			}
 		}
 
 		return _domain;
 	}
 
+	// Getter for the fingerprint of the dimensions and values (see fingerprint.hpp), it is cached like the domain
+	uint64_t fingerprint() const
+	{
+		if( !_fingerprintValid.load( std::memory_order_acquire ) )
+		{
+			const auto lock = std::scoped_lock( _domainMutex );
+			if( !_fingerprintValid.load( std::memory_order_relaxed ) )
+			{
+				_fingerprint = fingerprint::compute( _data, static_cast<size_t>( this->voxelCount() ) * sizeof( T ), fingerprint::combine( 0, _dimensions ) );
+				_fingerprintValid.store( true, std::memory_order_release );
+			}
+		}
+		return _fingerprint;
+	}
+
+	// Getter for the revision, which is unique for every volume and changes whenever the values are replaced or invalidated (e.g. for data derived elsewhere)
+	uint64_t revision() const noexcept
+	{
+		return _revision;
+	}
+
 	// Expand the domain if possible
 	void expandDomain( vec2<T> expansion )
 	{
@@ -228,36 +331,54 @@ public:
 				functions->glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
 			}
 
-			functions->glTexImage3D( GL_TEXTURE_3D, 0, GL_R32F, _dimensions.x, _dimensions.y, _dimensions.z, 0, GL_RED, GL_FLOAT, _values.data() );
+			functions->glTexImage3D( GL_TEXTURE_3D, 0, GL_R32F, _dimensions.x, _dimensions.y, _dimensions.z, 0, GL_RED, GL_FLOAT, _data );
 			_textureValid = true;
+			this->trackTexture();
 		}
+		else util::memory_budget().touch( this, util::MemoryBudget::Category::eTexture );
 		return _texture;
 	}
+
+	// Delete the OpenGL texture (e.g. when evicted from the memory budget), it is recreated on the next access
+	void releaseTexture() const
+	{
+		if( _texture )
+		{
+			if( util::make_share_context_current() )
+			{
+				const auto functions = QOpenGLContext::globalShareContext()->versionFunctions<QOpenGLFunctions_4_5_Core>();
+				functions->glDeleteTextures( 1, &_texture );
+			}
+			util::memory_budget().remove( this, util::MemoryBudget::Category::eTexture );
+
+			_texture = 0;
+			_textureValid = false;
+		}
+	}
 	void invalidate()
 	{
 		_domainValid = false;
+		_fingerprintValid = false;
+		_revision = Volume::nextRevision();
 		_textureValid = false;
 	}
 
-	// Compare two volumes
+	// Compare two volumes, the values are compared by their fingerprints
 	bool operator==( const Volume& other ) const
 	{
-		if( _name != other._name ) return false;
-		if( _dimensions != other._dimensions ) return false;
-		for( size_t i = 0; i < _values.size(); ++i ) if( _values[i] != other._values[i] ) return false;
-		if( _domain != other._domain ) return false;
-		return true;
+		return _name == other._name && _dimensions == other._dimensions && _domain == other._domain && this->fingerprint() == other.fingerprint();
 	}
 	bool operator!=( const Volume& other ) const
 	{
 		return !this->operator==( other );
 	}
 
-	// Simply map one volume to another using a conversion function
-	template<typename U> Volume<U> map( const std::function<U( T )>& conversion ) const
+	// Simply map one volume to another using a conversion function (any callable, so simple conversions can be inlined)
+	template<typename Function> auto map( const Function& conversion ) const
 	{
+		using U = decltype( conversion( std::declval<T>() ) );
 		auto result = Volume<U>( _dimensions, _name );
-		util::compute_multi_threaded( 0, _values.size(), [&] ( int32_t begin, int32_t end )
+		util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
 		{
 			for( int32_t i = begin; i < end; ++i )
 				result.at( i ) = conversion( this->at( i ) );
@@ -267,7 +388,7 @@ public:
 	template<typename U> Volume<U> cast() const
 	{
 		auto result = Volume<U>( _dimensions, _name );
-		util::compute_multi_threaded( 0, _values.size(), [&] ( int32_t begin, int32_t end )
+		util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
 		{
 			for( int32_t i = begin; i < end; ++i )
 				result.at( i ) = static_cast<U>( this->at( i ) );
@@ -276,12 +397,37 @@ public:
 	}
 
 private:
+	// Return the next revision (shared by all volumes, so a volume that is created at the address of a deleted one has a new revision as well)
+	static uint64_t nextRevision() noexcept
+	{
+		static auto counter = std::atomic<uint64_t>( 0 );
+		return ++counter;
+	}
+
+	// Register the texture with the memory budget, replacing the entry of the volume it was moved from (uploads are estimated at 1 GB/s)
+	void trackTexture( const Volume* movedFrom = nullptr ) const
+	{
+		if( movedFrom && _texture ) util::memory_budget().remove( movedFrom, util::MemoryBudget::Category::eTexture );
+		if( _texture )
+		{
+			const auto bytes = static_cast<size_t>( this->voxelCount() ) * sizeof( T );
+			util::memory_budget().add( this, util::MemoryBudget::Category::eTexture, bytes, bytes * 1e-6, [this] { this->releaseTexture(); } );
+		}
+	}
+
 	QString _name;
 	vec3i _dimensions;
 	std::vector<T> _values;
+	T* _data = nullptr;
+	std::shared_ptr<const void> _owner;
 
 	mutable vec2<T> _domain;
-	mutable bool _domainValid = false;
+	mutable std::atomic<bool> _domainValid { false };
+	mutable std::mutex _domainMutex;
+
+	mutable uint64_t _fingerprint = 0;
+	mutable std::atomic<bool> _fingerprintValid { false };
+	std::atomic<uint64_t> _revision { Volume::nextRevision() };
 
 	mutable GLuint _texture = 0;
 	mutable bool _textureValid = false;
@@ -208,21 +208,24 @@ public:
 		emit maskChanged();
 		emit regionChanged();
 	}
-	void setFirstVolume( const Volume<float>* volume, QString field )
+	void setFirstVolume( VolumeView volume, QString field )
 	{
 		_volumes.first = volume;
+		_volumePins.first = volume ? volume.pin() : util::MemoryBudget::Pin();
 		_firstVolumeField = std::move( field );
 		emit regionChanged();
 	}
-	void setSecondVolume( const Volume<float>* volume, QString field )
+	void setSecondVolume( VolumeView volume, QString field )
 	{
 		_volumes.second = volume;
+		_volumePins.second = volume ? volume.pin() : util::MemoryBudget::Pin();
 		_secondVolumeField = std::move( field );
 		emit regionChanged();
 	}
-	void setAlphaVolume( const Volume<float>* volume, QString field )
+	void setAlphaVolume( VolumeView volume, QString field )
 	{
 		_alphaVolume = volume;
+		_alphaVolumePin = volume ? volume.pin() : util::MemoryBudget::Pin();
 		_alphaVolumeField = std::move( field );
 		emit regionChanged();
 	}
@@ -254,11 +257,11 @@ public:
 	{
 		return _maskVolume;
 	}
-	std::pair<const Volume<float>*, const Volume<float>*> volumes() const noexcept
+	const std::pair<VolumeView, VolumeView>& volumes() const noexcept
 	{
 		return _volumes;
 	}
-	const Volume<float>* alphaVolume() const noexcept
+	const VolumeView& alphaVolume() const noexcept
 	{
 		return _alphaVolume;
 	}
@@ -284,15 +287,15 @@ public:
 	}
 	GLuint firstVolumeTexture() const noexcept
 	{
-		return _volumes.first ? _volumes.first->texture() : 0;
+		return _volumes.first ? _volumes.first.texture() : 0;
 	}
 	GLuint secondVolumeTexture() const noexcept
 	{
-		return _volumes.second ? _volumes.second->texture() : 0;
+		return _volumes.second ? _volumes.second.texture() : 0;
 	}
 	GLuint alphaVolumeTexture() const noexcept
 	{
-		return _alphaVolume ? _alphaVolume->texture() : 0;
+		return _alphaVolume ? _alphaVolume.texture() : 0;
 	}
 
 	// Getter for the name of the regions
@@ -324,8 +327,12 @@ signals:
 private:
 	QString _name;
 	std::shared_ptr<Volume<float>> _maskVolume;
-	std::pair<const Volume<float>*, const Volume<float>*> _volumes;
-	const Volume<float>* _alphaVolume = nullptr;
+	std::pair<VolumeView, VolumeView> _volumes;
+	VolumeView _alphaVolume;
+
+	// The volumes on screen are pinned in the memory budget
+	std::pair<util::MemoryBudget::Pin, util::MemoryBudget::Pin> _volumePins;
+	util::MemoryBudget::Pin _alphaVolumePin;
 
 	QString _firstVolumeField, _secondVolumeField, _alphaVolumeField;
 
@@ -691,7 +698,7 @@ private slots:
 		}
 
 		// Calculate dimension and location of slice
-		const auto dimensions = _regions.front()->volumes().first->dimensions();
+		const auto dimensions = _regions.front()->volumes().first.dimensions();
 		const auto slice = _settings.slice();
 		const auto pixelQueryTexel = _settings.highlightedTexel();
 
@@ -782,17 +789,17 @@ private slots:
 
 			if( _regions[i]->volumes().first )
 			{
-				regions[i].volumes[0].name = _regions[i]->volumes().first->name();
+				regions[i].volumes[0].name = _regions[i]->volumes().first.name();
 				if( !_regions[i]->firstVolumeField().isEmpty() ) regions[i].volumes[0].name += " (" + _regions[i]->firstVolumeField() + ")";
 			}
 			if( _regions[i]->colorMap2D() && _regions[i]->volumes().second )
 			{
-				regions[i].volumes[1].name = _regions[i]->volumes().second->name();
+				regions[i].volumes[1].name = _regions[i]->volumes().second.name();
 				if( !_regions[i]->secondVolumeField().isEmpty() ) regions[i].volumes[1].name += " (" + _regions[i]->secondVolumeField() + ")";
 			}
 			if( _regions[i]->colorMap1DAlpha() && _regions[i]->alphaVolume() )
 			{
-				regions[i].volumes[2].name = _regions[i]->alphaVolume()->name();
+				regions[i].volumes[2].name = _regions[i]->alphaVolume().name();
 				if( !_regions[i]->alphaVolumeField().isEmpty() ) regions[i].volumes[2].name += " (" + _regions[i]->alphaVolumeField() + ")";
 			}
 
@@ -936,7 +943,7 @@ private:
 			if( _captureFrame && _renderDoc ) _renderDoc->StartFrameCapture( nullptr, nullptr );
 
 			// Prepare ray caster by updating uniforms
-			const auto dimensions = _regions.front()->volumes().first->dimensions();
+			const auto dimensions = _regions.front()->volumes().first.dimensions();
 			const auto clipRangeBegin = vec3f( _settings.clipRegion().first ) / dimensions;
 			const auto clipRangeEnd =  vec3f( _settings.clipRegion().second ) / dimensions;
 			const auto maxDimension = std::max( dimensions.x, std::max( dimensions.y, dimensions.z ) );
@@ -1066,7 +1073,7 @@ private:
 			glClear( GL_COLOR_BUFFER_BIT );
 
 			// Render slice texure in the center of the widget
-			const auto dimensions = _regions.front()->volumes().first->dimensions();
+			const auto dimensions = _regions.front()->volumes().first.dimensions();
 			const auto slice = _settings.slice();
 
 			int width = 0, height = 0;
@@ -1271,7 +1278,7 @@ private:
 			else
 			{
 				const auto dim = slice.x == -1 ? slice.y == -1 ? 2 : 1 : 0;
-				slice[dim] = std::clamp( slice[dim] + ( event->delta() > 0 ? 1 : -1 ), 0, _regions.front()->volumes().first->dimensions()[dim] - 1 );
+				slice[dim] = std::clamp( slice[dim] + ( event->delta() > 0 ? 1 : -1 ), 0, _regions.front()->volumes().first.dimensions()[dim] - 1 );
 			}
 			_settings.setSlice( slice );
 		}
@@ -2029,9 +2036,9 @@ private slots:
 
 			const auto getVolume = [&] ( const Ensemble::VolumeID& id )
 			{
-				const Volume<float>* volume = nullptr;
-				if( id.difference && otherEnsemble ) volume = &ensemble->differenceVolume( id, *otherEnsemble );
-				else volume = &ensemble->volume( id );
+				auto volume = VolumeView();
+				if( id.difference && otherEnsemble ) volume = ensemble->differenceVolume( id, *otherEnsemble );
+				else volume = ensemble->volume( id );
 
 				const auto name = ensemble->fieldCount() > 1 ? ensemble->field( id.field ).name() : "";
 				return std::make_pair( volume, name );
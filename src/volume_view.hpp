@@ -0,0 +1,230 @@
+#pragma once
+#include "volume.hpp"
+
+#include <map>
+#include <memory>
+
+// Read-only view of a scalar volume, which is either a stored volume or the difference of two stored volumes (first - second).
+// Differences are never materialized, consumers evaluate them per voxel or in chunks of slices (e.g. for uploads to the GPU).
+class VolumeView
+{
+public:
+	VolumeView() noexcept = default;
+	VolumeView( const Volume<float>* volume ) noexcept : _volume( volume )
+	{}
+	VolumeView( const Volume<float>& volume ) noexcept : _volume( &volume )
+	{}
+
+	// Create a view of the difference of two volumes with equal dimensions (both have to outlive the view). Views of the same two volumes share their state
+	// while any of them is alive, so the domain and the texture are only computed once (e.g. when consumers request the difference again on every update)
+	// and again after any of the volumes changed (see Volume::revision).
+	static VolumeView difference( const Volume<float>& first, const Volume<float>& second, QString name )
+	{
+		if( first.dimensions() != second.dimensions() ) throw std::invalid_argument( "VolumeView::difference( const Volume<float>&, const Volume<float>&, QString ) -> Dimensions dont match." );
+
+		static auto mutex = std::mutex();
+		static auto differences = std::map<std::pair<const Volume<float>*, const Volume<float>*>, std::weak_ptr<Difference>>();
+		const auto lock = std::scoped_lock( mutex );
+
+		auto view = VolumeView();
+		auto& shared = differences[std::make_pair( &first, &second )];
+		if( !( view._difference = shared.lock() ) ) shared = view._difference = std::make_shared<Difference>( first, second, std::move( name ) );
+
+		// Forget differences that are no longer viewed
+		for( auto it = differences.begin(); it != differences.end(); ) it = it->second.expired() ? differences.erase( it ) : std::next( it );
+		return view;
+	}
+
+	// Check if the view refers to a volume and whether two views refer to the same volume
+	explicit operator bool() const noexcept
+	{
+		return _volume || _difference;
+	}
+	bool operator==( const VolumeView& other ) const noexcept
+	{
+		return _volume == other._volume && _difference == other._difference;
+	}
+	bool operator!=( const VolumeView& other ) const noexcept
+	{
+		return !( *this == other );
+	}
+
+	// Getters for basic properties
+	const QString& name() const noexcept
+	{
+		return _difference ? _difference->name : _volume->name();
+	}
+	vec3i dimensions() const noexcept
+	{
+		return _difference ? _difference->first.dimensions() : _volume->dimensions();
+	}
+	int32_t voxelCount() const noexcept
+	{
+		return _difference ? _difference->first.voxelCount() : _volume->voxelCount();
+	}
+	bool isDifference() const noexcept
+	{
+		return _difference != nullptr;
+	}
+
+	// Pin the underlying volumes (and the texture of a difference) in the memory budget, e.g. while the view is on screen
+	util::MemoryBudget::Pin pin() const
+	{
+		if( _difference ) return util::pin_memory( { &_difference->first, &_difference->second, _difference.get() } );
+		return util::pin_memory( { _volume } );
+	}
+
+	// Getter for the value of a single voxel
+	float at( int32_t index ) const
+	{
+		return _difference ? _difference->first.at( index ) - _difference->second.at( index ) : _volume->at( index );
+	}
+
+	// Call the function (void( int32_t begin, int32_t count, const float* values )) for consecutive chunks of whole slices (along the slowest dimension of the texture)
+	// Stored volumes pass their data directly, differences are evaluated into a buffer of up to 'chunkSize' values that is reused for all chunks
+	template<typename Function> void forEachChunk( Function function, int32_t chunkSize = 1 << 22 ) const
+	{
+		const auto dimensions = this->dimensions();
+		const auto sliceSize = dimensions.x * dimensions.y;
+		const auto chunkSlices = std::max( 1, chunkSize / std::max( 1, sliceSize ) );
+
+		auto buffer = std::vector<float>();
+		for( int32_t slice = 0; slice < dimensions.z; slice += chunkSlices )
+		{
+			const auto begin = slice * sliceSize;
+			const auto count = std::min( chunkSlices, dimensions.z - slice ) * sliceSize;
+			if( !_difference ) function( begin, count, _volume->data() + begin );
+			else
+			{
+				buffer.resize( count );
+				const auto first = _difference->first.data() + begin;
+				const auto second = _difference->second.data() + begin;
+				util::compute_multi_threaded( 0, count, [&] ( int32_t begin, int32_t end )
+				{
+					for( int32_t i = begin; i < end; ++i ) buffer[i] = first[i] - second[i];
+				} );
+				function( begin, count, buffer.data() );
+			}
+		}
+	}
+
+	// Return the domain (minimum and maximum), it is computed in a single fused pass for differences and cached
+	vec2f domain() const
+	{
+		if( !_difference ) return _volume->domain();
+
+		const auto lock = std::scoped_lock( _difference->mutex );
+		_difference->validate();
+		if( !_difference->domainValid )
+		{
+			auto domain = vec2f( std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() );
+			auto mutex = std::mutex();
+			util::compute_multi_threaded( 0, this->voxelCount(), [&] ( int32_t begin, int32_t end )
+			{
+				auto local = vec2f( std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() );
+				for( int32_t i = begin; i < end; ++i )
+				{
+					const auto value = _difference->first.at( i ) - _difference->second.at( i );
+					local = vec2f( std::min( local.x, value ), std::max( local.y, value ) );
+				}
+
+				const auto lock = std::scoped_lock( mutex );
+				domain = vec2f( std::min( domain.x, local.x ), std::max( domain.y, local.y ) );
+			} );
+			_difference->domain = domain;
+			_difference->domainValid = true;
+		}
+		return _difference->domain;
+	}
+
+	// Return the OpenGL texture, differences are uploaded chunk by chunk (the texture is shared by all copies of the view)
+	GLuint texture() const
+	{
+		if( !_difference ) return _volume->texture();
+
+		const auto lock = std::scoped_lock( _difference->mutex );
+		_difference->validate();
+		if( !_difference->texture )
+		{
+			const auto context = QOpenGLContext::globalShareContext();
+			const auto functions = context->versionFunctions<QOpenGLFunctions_4_5_Core>();
+			const auto dimensions = this->dimensions();
+
+			functions->glGenTextures( 1, &_difference->texture );
+			functions->glBindTexture( GL_TEXTURE_3D, _difference->texture );
+			functions->glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0 );
+			functions->glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+			functions->glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+			functions->glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+			functions->glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+			functions->glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+			functions->glTexImage3D( GL_TEXTURE_3D, 0, GL_R32F, dimensions.x, dimensions.y, dimensions.z, 0, GL_RED, GL_FLOAT, nullptr );
+
+			const auto sliceSize = dimensions.x * dimensions.y;
+			this->forEachChunk( [&] ( int32_t begin, int32_t count, const float* values )
+			{
+				functions->glTexSubImage3D( GL_TEXTURE_3D, 0, 0, 0, begin / sliceSize, dimensions.x, dimensions.y, count / sliceSize, GL_RED, GL_FLOAT, values );
+			} );
+
+			const auto bytes = static_cast<size_t>( this->voxelCount() ) * sizeof( float );
+			util::memory_budget().add( _difference.get(), util::MemoryBudget::Category::eTexture, bytes, bytes * 1e-6, [difference = _difference.get()]
+			{
+				const auto lock = std::scoped_lock( difference->mutex );
+				difference->releaseTexture();
+			} );
+		}
+		else util::memory_budget().touch( _difference.get(), util::MemoryBudget::Category::eTexture );
+		return _difference->texture;
+	}
+
+private:
+	// Shared state of a difference, the cached domain and texture are reused by all copies of the view
+	struct Difference
+	{
+		Difference( const Volume<float>& first, const Volume<float>& second, QString name ) : first( first ), second( second ), name( std::move( name ) ),
+			revisions( first.revision(), second.revision() )
+		{}
+		~Difference()
+		{
+			this->releaseTexture();
+		}
+
+		// Drop the cached domain and texture if any of the volumes was replaced or changed in place since they were computed (called with the mutex locked)
+		void validate()
+		{
+			const auto current = std::make_pair( first.revision(), second.revision() );
+			if( current == revisions ) return;
+
+			revisions = current;
+			domainValid = false;
+			this->releaseTexture();
+		}
+		void releaseTexture()
+		{
+			if( texture )
+			{
+				// The texture can only be deleted with a context of the share group current (it is gone with the context otherwise)
+				if( util::make_share_context_current() )
+				{
+					const auto functions = QOpenGLContext::globalShareContext()->versionFunctions<QOpenGLFunctions_4_5_Core>();
+					functions->glDeleteTextures( 1, &texture );
+				}
+				util::memory_budget().remove( this, util::MemoryBudget::Category::eTexture );
+				texture = 0;
+			}
+		}
+
+		const Volume<float>& first;
+		const Volume<float>& second;
+		QString name;
+
+		std::mutex mutex;
+		std::pair<uint64_t, uint64_t> revisions;
+		vec2f domain;
+		bool domainValid = false;
+		GLuint texture = 0;
+	};
+
+	const Volume<float>* _volume = nullptr;
+	std::shared_ptr<Difference> _difference;
+};
\ No newline at end of file
@@ -8,12 +8,13 @@
 #include "ensemble.hpp"
 
 #include <qsplitter.h>
+#include <qtimer.h>
 
 class Window : public QWidget
 {
 	Q_OBJECT
 public:
-	Window( std::filesystem::path filepath ) : QWidget(),
+	Window( std::filesystem::path filepath, int32_t histogramBinCount = 5, const std::vector<std::pair<QString, QString>>& fields = {} ) : QWidget(),
 		_ensemble( new Ensemble() ),
 		_colorMapManager( new ColorMapManager() ),
 		_colorPicker( new ColorPicker() ),
@@ -22,11 +23,17 @@ public:
 		_volumeRendererManager( new VolumeRendererManager( _ensemble, *_dendrogram, *_parallelCoordinates ) ),
 		_settings( new Settings() )
 	{
-		// Load ensemble
+		// Load ensemble (directories contain HDF5 files of the members)
+		const auto imported = std::filesystem::is_directory( filepath );
 		if( filepath == "teardrop" ) _ensemble->loadTeardrop();
 		else if( filepath == "tangle" ) _ensemble->loadTangle();
 		else if( filepath == "spheres" ) _ensemble->loadSpheres();
+		else if( imported ) _ensemble->loadHDF5( filepath, fields );
 		else _ensemble->load( std::move( filepath ), false );
+		_ensemble->setHistogramBinCount( histogramBinCount );
+
+		// Add virtual fields that are evaluated from the loaded fields (the fields of imported directories are read from the datasets instead)
+		if( !imported ) for( const auto& [name, expression] : fields ) _ensemble->addField( name, expression );
 
 		// Layout main widgets
 		auto row = util::createBoxLayout( QBoxLayout::LeftToRight, 0 );
@@ -92,6 +99,33 @@ public:
 			}
 		} );
 		QObject::connect( _parallelCoordinates, &ParallelCoordinates::permutationBufferChanged, _colorMapManager, &ColorMapManager::setPermutationBuffer );
+
+		// Enforce the memory budget regularly (between events no computation holds references to cached data) and report evictions
+		auto memoryTimer = new QTimer( this );
+		QObject::connect( memoryTimer, &QTimer::timeout, [=]
+		{
+			auto& budget = util::memory_budget();
+			const auto evictedBytes = budget.evictedBytes();
+			budget.collect();
+			if( budget.evictedBytes() != evictedBytes ) this->printMemoryUsage();
+		} );
+		memoryTimer->start( 1000 );
+	}
+
+	// Print the current memory usage per category of cached data
+	void printMemoryUsage() const
+	{
+		const auto& budget = util::memory_budget();
+		const auto mebibytes = [] ( size_t bytes ) { return QString::number( bytes / 1048576.0, 'f', 1 ) + " MiB"; };
+
+		std::cout << "Memory usage: " << mebibytes( budget.usage( util::MemoryBudget::Pool::eHost ) ).toStdString() << " (main memory), "
+			<< mebibytes( budget.usage( util::MemoryBudget::Pool::eDevice ) ).toStdString() << " (graphics memory), "
+			<< mebibytes( budget.evictedBytes() ).toStdString() << " evicted so far" << std::endl;
+		for( const auto& [category, usage] : budget.breakdown() )
+		{
+			std::cout << "  " << to_string( category ) << ": " << mebibytes( usage.bytes ).toStdString() << " in " << usage.entries << " entries ("
+				<< mebibytes( usage.pinnedBytes ).toStdString() << " pinned, " << mebibytes( usage.evictableBytes ).toStdString() << " evictable)" << std::endl;
+		}
 	}
 
 private:
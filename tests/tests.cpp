@@ -0,0 +1,144 @@
+#include "compression.hpp"
+#include "statistics.hpp"
+
+#include <cstring>
+#include <iostream>
+
+// Tests of the compression methods and the vectorized statistics against their documented error bounds and scalar references (run using ctest, every test
+// is selected by its name as argument). Violations throw a std::runtime_error.
+
+// Pseudo-random numbers in [0, 1) (xorshift, so the test data is the same on every platform)
+static float random_float( uint64_t& state )
+{
+	state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+	return static_cast<float>( state >> 40 ) / 16777216.0f;
+}
+
+// Round-trip test data through every method and check the decoded values against the documented error bounds (see compression::Quantization).
+// Half-precision values are also compared to the scalar conversion, which checks the SIMD decoding.
+static void check_compression()
+{
+	// Smooth values with an offset (compressible), noise (incompressible) and member-interleaved values that vary little over the members
+	auto state = uint64_t( 0x9E3779B97F4A7C15 );
+	constexpr auto VoxelCount = size_t( 1031 ), MemberCount = size_t( 7 ), Count = VoxelCount * MemberCount;
+	auto smooth = std::vector<float>( Count ), noise = std::vector<float>( Count ), members = std::vector<float>( Count );
+	for( size_t i = 0; i < Count; ++i )
+	{
+		smooth[i] = 100.0f + 50.0f * std::sin( i * 0.01f );
+		noise[i] = ( random_float( state ) - 0.5f ) * std::ldexp( 1.0f, static_cast<int32_t>( random_float( state ) * 40.0f ) - 30 );
+		members[i] = std::sin( ( i / MemberCount ) * 0.05f ) + 0.01f * random_float( state );
+	}
+
+	const auto check = [] ( const char* name, const std::vector<uint8_t>& block, compression::Method method, const std::vector<float>& values, auto bound )
+	{
+		if( static_cast<compression::Method>( block.front() ) != method ) throw std::runtime_error( std::string( "check_compression() -> Unexpected method of " ) + name + "." );
+		auto decoded = std::vector<float>( values.size() );
+		compression::decompress( block.data(), block.size(), decoded.data(), decoded.size() );
+		for( size_t i = 0; i < values.size(); ++i ) if( !( std::abs( decoded[i] - values[i] ) <= bound( values[i], decoded[i] ) ) )
+			throw std::runtime_error( std::string( "check_compression() -> Error of " ) + name + " exceeds its bound at value " + std::to_string( i ) + "." );
+	};
+	const auto exact = [] ( float value, float decoded ) { return std::memcmp( &value, &decoded, sizeof( float ) ) ? -1.0f : 0.0f; };
+	const auto scaled = [] ( const std::vector<float>& values, double levels )
+	{
+		const auto [minimum, maximum] = std::minmax_element( values.begin(), values.end() );
+		const auto bound = static_cast<float>( ( static_cast<double>( *maximum ) - *minimum ) / ( 2.0 * levels ) );
+		const auto rounding = 2.0f * std::numeric_limits<float>::epsilon() * std::max( std::abs( *minimum ), std::abs( *maximum ) );
+		return [bound, rounding] ( float, float ) { return bound + rounding; };
+	};
+
+	check( "eStored", compression::compress( noise.data(), Count ), compression::Method::eStored, noise, exact );
+	check( "eShuffledLZ", compression::compress( smooth.data(), Count ), compression::Method::eShuffledLZ, smooth, exact );
+	for( const auto& values : { smooth, noise } )
+	{
+		check( "eHalf", compression::compress( values.data(), Count, compression::Quantization::eHalf ), compression::Method::eHalf, values, [] ( float value, float decoded )
+		{
+			if( decoded != util::half_to_float( util::float_to_half( value ) ) ) return -1.0f;
+			return std::max( std::abs( value ) * std::ldexp( 1.0f, -11 ), std::ldexp( 1.0f, -25 ) );
+		} );
+		check( "eScaled16", compression::compress( values.data(), Count, compression::Quantization::eScaled16 ), compression::Method::eScaled16, values, scaled( values, 65535.0 ) );
+		check( "eScaled8", compression::compress( values.data(), Count, compression::Quantization::eScaled8 ), compression::Method::eScaled8, values, scaled( values, 255.0 ) );
+	}
+
+	// Odd counts decode the remaining values from a padded copy
+	const auto odd = std::vector<float>( smooth.begin(), smooth.begin() + simd::Width + 3 );
+	check( "eScaled8", compression::compress( odd.data(), odd.size(), compression::Quantization::eScaled8 ), compression::Method::eScaled8, odd, scaled( odd, 255.0 ) );
+	check( "eResiduals", compression::compress_residuals( members.data(), VoxelCount, MemberCount, 0.0f ), compression::Method::eResiduals, members, exact );
+
+	// Bounded residuals, also with tolerances below the rounding of the decoded values (which are stored losslessly)
+	auto offset = members;
+	for( auto& value : offset ) value += 1000.0f;
+	for( const auto& [values, tolerance] : { std::pair( &members, 1e-3f ), std::pair( &members, 1e-8f ), std::pair( &offset, 1e-3f ), std::pair( &offset, 3e-5f ) } )
+		check( "bounded eResiduals", compression::compress_residuals( values->data(), VoxelCount, MemberCount, tolerance ), compression::Method::eResiduals, *values, [tolerance] ( float, float ) { return tolerance; } );
+}
+
+// Compare the vectorized Anderson-Darling p-values (sorting networks for specialized and generated member counts) to the scalar version
+static void check_anderson_darling()
+{
+	// Maximum absolute difference of the p-values, as documented for statistics::anderson_darling
+	constexpr auto Bound = 2e-5f;
+
+	auto state = uint64_t( 0x2545F4914F6CDD1D );
+	for( const auto memberCount : { 16, 20, 25, 32, 40, 50, 64, 100, 128, 200, 256 } )
+	{
+		// Normal, uniform and skewed members with different means and scales (p-values from almost zero to one) and constant voxels
+		constexpr auto VoxelCount = 1029;
+		auto values = std::vector<float>( static_cast<size_t>( VoxelCount ) * memberCount );
+		auto means = std::vector<float>( VoxelCount ), stddevs = std::vector<float>( VoxelCount );
+		for( int32_t i = 0; i < VoxelCount; ++i )
+		{
+			const auto offset = ( random_float( state ) - 0.5f ) * 100.0f;
+			const auto scale = std::ldexp( 1.0f, static_cast<int32_t>( random_float( state ) * 20.0f ) - 10 );
+			const auto member = values.data() + static_cast<size_t>( i ) * memberCount;
+			for( int32_t j = 0; j < memberCount; ++j )
+			{
+				const auto u = std::max( random_float( state ), 1e-7f ), v = random_float( state );
+				auto value = 0.0f;
+				if( i % 4 == 0 ) value = std::sqrt( -2.0f * std::log( u ) ) * std::cos( 6.28318531f * v );
+				else if( i % 4 == 1 ) value = u;
+				else if( i % 4 == 2 ) value = -std::log( u ) + 0.1f * v;
+				member[j] = i % 97 == 3 ? offset : offset + scale * value;
+			}
+
+			auto sum = 0.0, squares = 0.0;
+			for( int32_t j = 0; j < memberCount; ++j ) sum += member[j];
+			means[i] = static_cast<float>( sum / memberCount );
+			for( int32_t j = 0; j < memberCount; ++j ) squares += ( member[j] - means[i] ) * static_cast<double>( member[j] - means[i] );
+			stddevs[i] = static_cast<float>( std::sqrt( squares / memberCount ) );
+			if( i % 97 == 3 ) stddevs[i] = 0.0f;
+		}
+
+		auto results = std::vector<float>( VoxelCount );
+		statistics::anderson_darling( values.data(), VoxelCount, memberCount, means.data(), stddevs.data(), results.data() );
+
+		auto sorted = std::vector<float>();
+		for( int32_t i = 0; i < VoxelCount; ++i )
+		{
+			const auto expected = statistics::anderson_darling_scalar( values.data() + static_cast<size_t>( i ) * memberCount, memberCount, means[i], stddevs[i], sorted );
+			if( !( std::abs( results[i] - expected ) <= Bound ) )
+				throw std::runtime_error( "check_anderson_darling() -> P-value of voxel " + std::to_string( i ) + " with " + std::to_string( memberCount ) + " members differs from the scalar version by " + std::to_string( std::abs( results[i] - expected ) ) + "." );
+		}
+	}
+}
+
+int main( int argc, char** argv )
+{
+	const auto tests = std::vector<std::pair<std::string, void( * )()>> { { "compression", check_compression }, { "anderson_darling", check_anderson_darling } };
+	try
+	{
+		// Run the tests given as arguments (all tests if none are given)
+		auto count = 0;
+		for( const auto& [name, test] : tests ) if( argc < 2 || std::find( argv + 1, argv + argc, name ) != argv + argc )
+		{
+			test();
+			std::cout << "Test '" << name << "' passed." << std::endl;
+			++count;
+		}
+		if( count < std::max( 1, argc - 1 ) ) throw std::invalid_argument( "Unknown test, expected 'compression' or 'anderson_darling'." );
+		return EXIT_SUCCESS;
+
+	} catch( const std::exception& e )
+	{
+		std::cerr << "[Error]: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
\ No newline at end of file